@@ -0,0 +1,22 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+// Micro-benchmarks behind `pkgtool bench <name>`, argv starts after the benchmark name.
+
+/// Throughput of every crypto primitive on every backend compiled in, and a check that all
+/// backends produce the same bytes as the reference one.
+int RunCryptoBench(int argc, char* argv[]);
+
+/// Producer throughput of the shared MPSC queue against per-thread log rings, from 1 to 64
+/// logging threads.
+int RunLogBench(int argc, char* argv[]);
+
+/// Files created per second on a tree of small files, per-file IOFile and create_directories
+/// against FileWriter, with and without batching.
+int RunWriteBench(int argc, char* argv[]);
+
+/// Throughput and page cache left behind when copying a large file through the extraction
+/// read and write path, buffered against --io=direct.
+int RunIoBench(int argc, char* argv[]);
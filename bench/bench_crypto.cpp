@@ -0,0 +1,187 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cryptopp/osrng.h>
+#include <cryptopp/rsa.h>
+
+#include "bench/bench.h"
+#include "core/crypto/crypto.h"
+#include "core/crypto/crypto_backend.h"
+
+namespace {
+
+struct Inputs {
+    std::array<u8, 16> key;
+    std::array<u8, 16> tweak_key;
+    std::array<u8, 16> iv;
+    std::array<u8, 32> hmac_key;
+    std::vector<u8> data;
+    std::array<u8, 256> rsa_dk3;  // RSA ciphertexts of `rsa_plain`
+    std::array<u8, 256> rsa_fake;
+    std::array<u8, 32> rsa_plain;
+};
+
+// Encrypts with the public half of the keyset so the result can be decrypted by the backends.
+void EncryptRSA(const CryptoPP::RSA::PrivateKey& key, std::span<const u8, 32> plain,
+                std::span<u8, 256> out) {
+    CryptoPP::AutoSeededRandomPool rng;
+    CryptoPP::RSAES_PKCS1v15_Encryptor encryptor{CryptoPP::RSA::PublicKey(key)};
+    encryptor.Encrypt(rng, plain.data(), plain.size(), out.data());
+}
+
+Inputs MakeInputs(size_t size) {
+    std::mt19937_64 rng{0x5eed};
+    const auto fill = [&](std::span<u8> out) {
+        for (auto& byte : out) {
+            byte = static_cast<u8>(rng());
+        }
+    };
+    Inputs inputs;
+    fill(inputs.key);
+    fill(inputs.tweak_key);
+    fill(inputs.iv);
+    fill(inputs.hmac_key);
+    fill(inputs.rsa_plain);
+    inputs.data.resize(size);
+    fill(inputs.data);
+    Crypto crypto;
+    EncryptRSA(crypto.key_pkg_derived_key3_keyset_init(), inputs.rsa_plain, inputs.rsa_dk3);
+    EncryptRSA(crypto.FakeKeyset_keyset_init(), inputs.rsa_plain, inputs.rsa_fake);
+    return inputs;
+}
+
+struct Primitive {
+    std::string_view name;
+    u64 bytes_per_run; // 0 reports operations per second instead of throughput
+    int runs;
+    // Runs the primitive once and returns its output for the equivalence check.
+    std::function<std::vector<u8>(CryptoBackend&, const Inputs&)> run;
+};
+
+std::vector<Primitive> GetPrimitives(const Inputs& inputs) {
+    const u64 size = inputs.data.size();
+    return {
+        {"aes-128-xts", size, 3,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(in.data.size());
+             b.AesXtsDecrypt(in.key, in.tweak_key, in.data, out, 0x10);
+             return out;
+         }},
+        {"aes-128-cbc dec", size, 3,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(in.data.size());
+             b.AesCbcDecrypt(in.key, in.iv, in.data, out);
+             return out;
+         }},
+        {"aes-128-cbc enc", size, 3,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(in.data.size());
+             b.AesCbcEncrypt(in.key, in.iv, in.data, out);
+             return out;
+         }},
+        {"sha256", size, 3,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(32);
+             b.Sha256(in.data, std::span<u8, 32>(out.data(), 32));
+             return out;
+         }},
+        // The shapes Crypto actually uses: 64 byte ivkey hash and 20 byte PFS key derivation.
+        {"sha256 64B", 0, 200000,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(32);
+             b.Sha256(std::span(in.data).first(64), std::span<u8, 32>(out.data(), 32));
+             return out;
+         }},
+        {"hmac-sha256 20B", 0, 200000,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(32);
+             b.HmacSha256(in.hmac_key, std::span(in.data).first(20),
+                          std::span<u8, 32>(out.data(), 32));
+             return out;
+         }},
+        {"rsa-2048 dk3", 0, 200,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(32);
+             b.RsaDecrypt(true, in.rsa_dk3, std::span<u8, 32>(out.data(), 32));
+             return out;
+         }},
+        {"rsa-2048 fake", 0, 200,
+         [](CryptoBackend& b, const Inputs& in) {
+             std::vector<u8> out(32);
+             b.RsaDecrypt(false, in.rsa_fake, std::span<u8, 32>(out.data(), 32));
+             return out;
+         }},
+    };
+}
+
+} // Anonymous namespace
+
+// pkgtool bench crypto [--size=<MiB>] [--backend=<nome>]
+int RunCryptoBench(int argc, char* argv[]) {
+    size_t size_mb = 64;
+    std::string_view only_backend;
+    for (int i = 0; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--size=")) {
+            size_mb = std::max(1, std::atoi(argv[i] + 7));
+        } else if (arg.starts_with("--backend=")) {
+            only_backend = arg.substr(10);
+        }
+    }
+
+    const Inputs inputs = MakeInputs(size_mb << 20);
+    const auto primitives = GetPrimitives(inputs);
+    const auto backends = GetCryptoBackends();
+    CryptoBackend& reference = *backends.front();
+
+    bool all_equal = true;
+    std::cout << std::left << std::setw(18) << "primitiva" << std::setw(10) << "backend"
+              << std::right << std::setw(14) << "velocita'" << "  uguale" << std::endl;
+    for (const Primitive& primitive : primitives) {
+        const auto expected = primitive.run(reference, inputs);
+        for (CryptoBackend* backend : backends) {
+            if (!only_backend.empty() && backend->GetName() != only_backend) {
+                continue;
+            }
+            // One untimed run warms up caches and thread-local state.
+            const bool equal = primitive.run(*backend, inputs) == expected;
+            all_equal = all_equal && equal;
+
+            const auto start = std::chrono::steady_clock::now();
+            for (int r = 0; r < primitive.runs; r++) {
+                primitive.run(*backend, inputs);
+            }
+            const double seconds =
+                std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            std::ostringstream speed;
+            speed << std::fixed << std::setprecision(1);
+            if (primitive.bytes_per_run != 0) {
+                speed << primitive.bytes_per_run * primitive.runs / seconds / (1 << 20) << " MiB/s";
+            } else {
+                speed << primitive.runs / seconds << " op/s";
+            }
+            std::cout << std::left << std::setw(18) << primitive.name << std::setw(10)
+                      << backend->GetName() << std::right << std::setw(14) << speed.str() << "  "
+                      << (equal ? "si" : "NO") << std::endl;
+        }
+    }
+    if (!all_equal) {
+        std::cerr << "I backend producono risultati diversi dal riferimento ("
+                  << reference.GetName() << ")" << std::endl;
+        return 1;
+    }
+    return 0;
+}
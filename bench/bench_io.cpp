@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string_view>
+#include <vector>
+
+#include "bench/bench.h"
+#include "common/buffer_pool.h"
+#include "common/file_writer.h"
+#include "common/io_file.h"
+#include "common/memory_usage.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+constexpr size_t ChunkSize = 1_MB;
+
+// Starts every run with nothing of `path` in the page cache, where the system allows it.
+void EvictFromCache(const std::filesystem::path& path) {
+#if !defined(_WIN32) && !defined(__APPLE__)
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#endif
+}
+
+bool MakeSource(const std::filesystem::path& path, u64 size) {
+    Common::FS::FileWriter writer;
+    auto out = writer.Create(path);
+    std::vector<u8> chunk(ChunkSize);
+    for (size_t i = 0; i < chunk.size(); i++) {
+        chunk[i] = static_cast<u8>(i * 131 + 7);
+    }
+    for (u64 done = 0; done < size && out.IsOpen(); done += ChunkSize) {
+        out.Write(std::span<const u8>(chunk).first(std::min<u64>(ChunkSize, size - done)));
+    }
+    return out.Close();
+}
+
+// Copies the source the way extraction moves data: aligned positional reads from one shared
+// handle, written through the FileWriter.
+double RunCopy(const std::filesystem::path& source, const std::filesystem::path& dest,
+               bool direct) {
+    Common::FS::IOFile in(source, Common::FS::FileAccessMode::Read);
+    if (direct && !in.OpenDirect()) {
+        std::cerr << "Lettura diretta non disponibile su questo file system" << std::endl;
+    }
+    Common::FS::FileWriter writer;
+    writer.SetUncached(direct);
+    Common::BufferPool pool(ChunkSize, 0, Common::FS::IOFile::DirectAlignment);
+    const auto buffer = pool.Acquire();
+
+    const auto start = std::chrono::steady_clock::now();
+    auto out = writer.Create(dest);
+    for (u64 offset = 0;; offset += ChunkSize) {
+        const size_t read = in.ReadAt(offset, buffer.span());
+        if (read == 0) {
+            break;
+        }
+        out.Write(buffer.span().first(read));
+    }
+    out.Close();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // Anonymous namespace
+
+// pkgtool bench io [--size=<MiB>] [--dir=<cartella>]
+int RunIoBench(int argc, char* argv[]) {
+    u64 size_mb = 1024;
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "pkgtool_bench_io";
+    for (int i = 0; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--size=")) {
+            size_mb = std::max(1, std::atoi(argv[i] + 7));
+        } else if (arg.starts_with("--dir=")) {
+            dir = arg.substr(6);
+        }
+    }
+
+    std::filesystem::create_directories(dir);
+    const auto source = dir / "source.bin";
+    const auto dest = dir / "copy.bin";
+    if (!MakeSource(source, size_mb * 1_MB)) {
+        std::cerr << "Impossibile creare " << source.string() << std::endl;
+        return 1;
+    }
+
+    std::cout << std::left << std::setw(10) << "modo" << std::right << std::setw(10) << "MiB/s"
+              << std::setw(20) << "cache sorgente MiB" << std::setw(20) << "cache output MiB"
+              << std::endl;
+    for (const bool direct : {false, true}) {
+        EvictFromCache(source);
+        std::filesystem::remove(dest);
+        const double seconds = RunCopy(source, dest, direct);
+        std::cout << std::left << std::setw(10) << (direct ? "direct" : "buffered") << std::right
+                  << std::fixed << std::setprecision(0) << std::setw(10) << size_mb / seconds
+                  << std::setw(20) << Common::GetPageCacheSize(source) / 1_MB << std::setw(20)
+                  << Common::GetPageCacheSize(dest) / 1_MB << std::endl;
+    }
+    std::filesystem::remove_all(dir);
+    return 0;
+}
@@ -0,0 +1,147 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bench/bench.h"
+#include "common/bounded_threadsafe_queue.h"
+#include "common/logging/log_entry.h"
+#include "common/logging/log_ring.h"
+
+namespace {
+
+using Common::Log::Class;
+using Common::Log::Entry;
+using Common::Log::Level;
+using Common::Log::LogRing;
+using Common::Log::RingRecord;
+
+// About the size of a typical formatted log line.
+constexpr std::string_view Message = "Decrypting PFS block 123456, 65536 bytes";
+
+// The previous async design: every thread pushes a full Entry through one locked queue.
+double RunSharedQueue(size_t threads, size_t messages) {
+    Common::MPSCQueue<Entry> queue;
+    std::atomic<bool> go{false};
+    std::vector<std::jthread> producers;
+    for (size_t t = 0; t < threads; t++) {
+        producers.emplace_back([&] {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < messages; i++) {
+                queue.EmplaceWait(Entry{
+                    .log_class = Class::Log,
+                    .log_level = Level::Info,
+                    .filename = __FILE__,
+                    .line_num = __LINE__,
+                    .function = __func__,
+                    .message = std::string(Message),
+                });
+            }
+        });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    Entry entry;
+    for (size_t i = 0; i < threads * messages; i++) {
+        queue.PopWait(entry);
+    }
+    producers.clear();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// The current design: one ring per thread, the consumer visits them round robin.
+double RunThreadRings(size_t threads, size_t messages) {
+    std::vector<std::unique_ptr<LogRing>> rings;
+    for (size_t t = 0; t < threads; t++) {
+        rings.push_back(std::make_unique<LogRing>());
+    }
+    std::atomic<bool> go{false};
+    std::vector<std::jthread> producers;
+    for (size_t t = 0; t < threads; t++) {
+        producers.emplace_back([&, ring = rings[t].get()] {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            const std::span text(reinterpret_cast<const u8*>(Message.data()), Message.size());
+            for (size_t i = 0; i < messages; i++) {
+                ring->Push(
+                    RingRecord{
+                        .filename = __FILE__,
+                        .function = __func__,
+                        .line_num = __LINE__,
+                        .log_class = Class::Log,
+                        .log_level = Level::Info,
+                    },
+                    text);
+            }
+        });
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    size_t remaining = threads * messages;
+    RingRecord record;
+    std::span<const u8> payload;
+    while (remaining != 0) {
+        size_t popped = 0;
+        for (const auto& ring : rings) {
+            const u64 limit = ring->Head();
+            while (ring->Front(limit, record, payload)) {
+                ring->Pop(record);
+                popped++;
+            }
+        }
+        remaining -= popped;
+        if (popped == 0) {
+            std::this_thread::yield();
+        }
+    }
+    producers.clear();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // Anonymous namespace
+
+// pkgtool bench log [--messages=<n>] [--max-threads=<n>]
+int RunLogBench(int argc, char* argv[]) {
+    size_t messages = 200000;
+    size_t max_threads = 64;
+    for (int i = 0; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--messages=")) {
+            messages = std::max(1, std::atoi(argv[i] + 11));
+        } else if (arg.starts_with("--max-threads=")) {
+            max_threads = std::max(1, std::atoi(argv[i] + 14));
+        }
+    }
+
+    std::cout << std::left << std::setw(8) << "thread" << std::setw(16) << "coda" << std::right
+              << std::setw(16) << "messaggi/s" << std::setw(12) << "ns/msg" << std::endl;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        // Same total work for every thread count.
+        const size_t per_thread = std::max<size_t>(1, messages / threads);
+        const size_t total = per_thread * threads;
+        const auto report = [&](std::string_view name, double seconds) {
+            std::cout << std::left << std::setw(8) << threads << std::setw(16) << name
+                      << std::right << std::fixed << std::setprecision(0) << std::setw(16)
+                      << total / seconds << std::setprecision(1) << std::setw(12)
+                      << seconds * 1e9 / total << std::endl;
+        };
+        report("mpsc condivisa", RunSharedQueue(threads, per_thread));
+        report("ring per thread", RunThreadRings(threads, per_thread));
+    }
+    return 0;
+}
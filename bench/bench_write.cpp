@@ -0,0 +1,116 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "bench/bench.h"
+#include "common/file_writer.h"
+#include "common/io_file.h"
+#include "common/parallel_for.h"
+
+namespace {
+
+// About the shape of a small-file-heavy game tree: a few levels of folders with a couple of
+// hundred files each.
+constexpr size_t FilesPerDir = 200;
+constexpr size_t DirsPerLevel = 32;
+
+std::vector<std::filesystem::path> MakeTree(const std::filesystem::path& root, size_t files) {
+    std::vector<std::filesystem::path> paths;
+    paths.reserve(files);
+    for (size_t i = 0; i < files; i++) {
+        const size_t dir = i / FilesPerDir;
+        paths.push_back(root / std::to_string(dir / DirsPerLevel) / std::to_string(dir) /
+                        ("file_" + std::to_string(i) + ".bin"));
+    }
+    return paths;
+}
+
+template <typename Func>
+double Time(size_t count, size_t threads, Func&& func) {
+    const auto start = std::chrono::steady_clock::now();
+    Common::ParallelFor(count, func, threads);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// What extraction used to do for every file.
+double RunIOFile(const std::vector<std::filesystem::path>& paths, std::span<const u8> data,
+                 size_t threads) {
+    return Time(paths.size(), threads, [&](size_t i) {
+        std::filesystem::create_directories(paths[i].parent_path());
+        Common::FS::IOFile out(paths[i], Common::FS::FileAccessMode::Write);
+        out.WriteRaw<u8>(data.data(), data.size());
+    });
+}
+
+double RunWriter(const std::vector<std::filesystem::path>& paths, std::span<const u8> data,
+                 size_t threads) {
+    Common::FS::FileWriter writer;
+    return Time(paths.size(), threads, [&](size_t i) { writer.WriteFile(paths[i], data); });
+}
+
+double RunBatch(const std::vector<std::filesystem::path>& paths, std::span<const u8> data,
+                size_t threads) {
+    Common::FS::FileWriter writer;
+    const size_t workers = Common::GetWorkerCount(paths.size(), threads);
+    std::atomic<size_t> next{0};
+    return Time(workers, workers, [&](size_t) {
+        Common::FS::FileWriter::Batch batch{writer};
+        for (size_t i = next++; i < paths.size(); i = next++) {
+            batch.Add(paths[i], data);
+        }
+    });
+}
+
+} // Anonymous namespace
+
+// pkgtool bench write [--files=<n>] [--size=<byte>] [--max-threads=<n>] [--dir=<cartella>]
+int RunWriteBench(int argc, char* argv[]) {
+    size_t files = 200000;
+    size_t size = 4096;
+    size_t max_threads = 8;
+    std::filesystem::path dir = std::filesystem::temp_directory_path() / "pkgtool_bench_write";
+    for (int i = 0; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--files=")) {
+            files = std::max(1, std::atoi(argv[i] + 8));
+        } else if (arg.starts_with("--size=")) {
+            size = std::max(0, std::atoi(argv[i] + 7));
+        } else if (arg.starts_with("--max-threads=")) {
+            max_threads = std::max(1, std::atoi(argv[i] + 14));
+        } else if (arg.starts_with("--dir=")) {
+            dir = arg.substr(6);
+        }
+    }
+
+    const std::vector<u8> data(size, 0xA5);
+    const auto paths = MakeTree(dir, files);
+    std::cout << files << " file da " << size << " byte in " << dir.string() << std::endl;
+    std::cout << std::left << std::setw(8) << "thread" << std::setw(20) << "scrittura"
+              << std::right << std::setw(14) << "file/s" << std::setw(12) << "us/file"
+              << std::endl;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        const auto report = [&](std::string_view name, double seconds) {
+            std::cout << std::left << std::setw(8) << threads << std::setw(20) << name
+                      << std::right << std::fixed << std::setprecision(0) << std::setw(14)
+                      << files / seconds << std::setprecision(2) << std::setw(12)
+                      << seconds * 1e6 / files << std::endl;
+            // Every run starts from an empty tree, the removal is not timed.
+            std::filesystem::remove_all(dir);
+        };
+        std::filesystem::remove_all(dir);
+        report("IOFile", RunIOFile(paths, data, threads));
+        report("FileWriter", RunWriter(paths, data, threads));
+        report("FileWriter::Batch", RunBatch(paths, data, threads));
+    }
+    return 0;
+}
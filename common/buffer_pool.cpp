@@ -0,0 +1,138 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "common/buffer_pool.h"
+
+namespace Common {
+
+BufferPool::Buffer::Buffer(Buffer&& other) noexcept
+    : pool{std::exchange(other.pool, nullptr)}, storage{std::move(other.storage)} {}
+
+BufferPool::Buffer& BufferPool::Buffer::operator=(Buffer&& other) noexcept {
+    if (this != &other) {
+        if (pool) {
+            pool->Release(std::move(storage));
+        }
+        pool = std::exchange(other.pool, nullptr);
+        storage = std::move(other.storage);
+    }
+    return *this;
+}
+
+BufferPool::Buffer::~Buffer() {
+    if (pool) {
+        pool->Release(std::move(storage));
+    }
+}
+
+BufferPool::Reservation::Reservation(Reservation&& other) noexcept
+    : pool{std::exchange(other.pool, nullptr)}, bytes{std::exchange(other.bytes, 0)} {}
+
+BufferPool::Reservation& BufferPool::Reservation::operator=(Reservation&& other) noexcept {
+    if (this != &other) {
+        if (pool) {
+            pool->Unreserve(bytes);
+        }
+        pool = std::exchange(other.pool, nullptr);
+        bytes = std::exchange(other.bytes, 0);
+    }
+    return *this;
+}
+
+BufferPool::Reservation::~Reservation() {
+    if (pool) {
+        pool->Unreserve(bytes);
+    }
+}
+
+BufferPool::BufferPool(size_t buffer_size_, u64 max_bytes_, size_t alignment_)
+    : buffer_size{buffer_size_}, max_bytes{max_bytes_}, alignment{alignment_} {}
+
+BufferPool::~BufferPool() = default;
+
+bool BufferPool::Fits(u64 bytes) const {
+    return max_bytes == 0 || in_use + bytes <= max_bytes;
+}
+
+BufferPool::Buffer BufferPool::Acquire() {
+    std::unique_lock lock{mutex};
+    // A budget smaller than one buffer still lets a single buffer through, otherwise nothing
+    // could ever make progress.
+    cv.wait(lock, [&] { return Fits(buffer_size) || in_use == 0; });
+    return TakeBuffer(lock);
+}
+
+BufferPool::Buffer BufferPool::TryAcquire() {
+    std::unique_lock lock{mutex};
+    if (!Fits(buffer_size)) {
+        return {};
+    }
+    return TakeBuffer(lock);
+}
+
+BufferPool::Buffer BufferPool::TakeBuffer(std::unique_lock<std::mutex>& lock) {
+    in_use += buffer_size;
+    if (!free_list.empty()) {
+        auto storage = std::move(free_list.back());
+        free_list.pop_back();
+        return Buffer{this, std::move(storage)};
+    }
+    peak = std::max(peak, in_use + free_list.size() * buffer_size);
+    lock.unlock();
+    // Over-allocated so data() can be moved up to the next aligned address.
+    return Buffer{this, std::make_unique_for_overwrite<u8[]>(buffer_size + alignment - 1)};
+}
+
+BufferPool::Reservation BufferPool::Reserve(u64 bytes) {
+    std::unique_lock lock{mutex};
+    // Always leave room for one buffer, whoever holds the reservation may still need it.
+    if (max_bytes != 0 && bytes + buffer_size > max_bytes) {
+        return {};
+    }
+    // Cached free buffers count against the budget too, drop them if they are in the way.
+    const auto fits = [&] {
+        while (!Fits(bytes + free_list.size() * buffer_size) && !free_list.empty()) {
+            free_list.pop_back();
+        }
+        return Fits(bytes + free_list.size() * buffer_size);
+    };
+    cv.wait(lock, fits);
+    in_use += bytes;
+    peak = std::max(peak, in_use + free_list.size() * buffer_size);
+    return Reservation{this, bytes};
+}
+
+void BufferPool::Release(std::unique_ptr<u8[]> storage) {
+    {
+        std::scoped_lock lock{mutex};
+        in_use -= buffer_size;
+        free_list.push_back(std::move(storage));
+    }
+    cv.notify_all();
+}
+
+void BufferPool::Unreserve(u64 bytes) {
+    {
+        std::scoped_lock lock{mutex};
+        in_use -= bytes;
+    }
+    cv.notify_all();
+}
+
+size_t BufferPool::GetMaxBuffers() const {
+    if (max_bytes == 0) {
+        return std::numeric_limits<size_t>::max();
+    }
+    return std::max<size_t>(1, max_bytes / buffer_size);
+}
+
+u64 BufferPool::GetPeakUsage() const {
+    std::scoped_lock lock{mutex};
+    return peak;
+}
+
+} // namespace Common
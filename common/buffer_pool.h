@@ -0,0 +1,128 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+#include "common/types.h"
+
+namespace Common {
+
+/**
+ * Hands out fixed-size buffers under a global memory budget.
+ *
+ * Released buffers are kept on a free list and reused, so steady-state work does not touch the
+ * allocator. Large one-off allocations that are not block sized can be accounted against the
+ * same budget with Reserve. When the budget is exhausted, Acquire and Reserve block until
+ * memory is given back, which turns memory pressure into less parallelism instead of an OOM.
+ */
+class BufferPool {
+public:
+    class Buffer {
+    public:
+        Buffer() = default;
+        Buffer(Buffer&& other) noexcept;
+        Buffer& operator=(Buffer&& other) noexcept;
+        ~Buffer();
+
+        Buffer(const Buffer&) = delete;
+        Buffer& operator=(const Buffer&) = delete;
+
+        u8* data() const {
+            return pool ? pool->Align(storage.get()) : nullptr;
+        }
+        size_t size() const {
+            return pool ? pool->buffer_size : 0;
+        }
+        std::span<u8> span() const {
+            return {data(), size()};
+        }
+
+    private:
+        friend class BufferPool;
+        Buffer(BufferPool* pool, std::unique_ptr<u8[]> storage)
+            : pool{pool}, storage{std::move(storage)} {}
+
+        BufferPool* pool = nullptr;
+        std::unique_ptr<u8[]> storage;
+    };
+
+    class Reservation {
+    public:
+        Reservation() = default;
+        Reservation(Reservation&& other) noexcept;
+        Reservation& operator=(Reservation&& other) noexcept;
+        ~Reservation();
+
+        Reservation(const Reservation&) = delete;
+        Reservation& operator=(const Reservation&) = delete;
+
+        explicit operator bool() const {
+            return pool != nullptr;
+        }
+
+    private:
+        friend class BufferPool;
+        Reservation(BufferPool* pool, u64 bytes) : pool{pool}, bytes{bytes} {}
+
+        BufferPool* pool = nullptr;
+        u64 bytes = 0;
+    };
+
+    /// `max_bytes` of 0 means no budget, buffers are still recycled. Every buffer starts at a
+    /// multiple of `alignment`, a power of two.
+    explicit BufferPool(size_t buffer_size, u64 max_bytes = 0, size_t alignment = 1);
+    ~BufferPool();
+
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    /// Returns a buffer of GetBufferSize() bytes, waiting for one if the budget is used up.
+    Buffer Acquire();
+
+    /// Like Acquire, but returns an empty buffer instead of waiting when the budget is used up.
+    Buffer TryAcquire();
+
+    /// Accounts `bytes` against the budget, waiting until they fit. Returns an empty
+    /// reservation when `bytes` plus one buffer can never fit.
+    Reservation Reserve(u64 bytes);
+
+    size_t GetBufferSize() const {
+        return buffer_size;
+    }
+    u64 GetBudget() const {
+        return max_bytes;
+    }
+    /// How many buffers can be held at once, at least 1.
+    size_t GetMaxBuffers() const;
+    u64 GetPeakUsage() const;
+
+private:
+    u8* Align(u8* storage) const {
+        const uintptr_t address = reinterpret_cast<uintptr_t>(storage);
+        return storage + ((alignment - address % alignment) & (alignment - 1));
+    }
+    // Hands out a buffer once the caller made sure it fits, unlocks `lock` to allocate.
+    Buffer TakeBuffer(std::unique_lock<std::mutex>& lock);
+    void Release(std::unique_ptr<u8[]> storage);
+    void Unreserve(u64 bytes);
+    bool Fits(u64 bytes) const;
+
+    const size_t buffer_size;
+    const u64 max_bytes;
+    const size_t alignment;
+
+    mutable std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<std::unique_ptr<u8[]>> free_list;
+    u64 in_use = 0; // buffers handed out plus reservations
+    u64 peak = 0;
+};
+
+} // namespace Common
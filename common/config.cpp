@@ -26,6 +26,7 @@ static u32 screenHeight = 720;
 static s32 gpuId = -1; // Vulkan physical device index. Set to negative for auto select
 static std::string logFilter;
 static std::string logType = "async";
+static std::string logOverflow = "block";
 static std::string userName = "shadPS4";
 static std::string updateChannel;
 static std::string chooseHomeTab;
@@ -84,7 +85,7 @@ std::string emulator_language = "en";
 u32 m_language = 1; // english
 
 std::string getTrophyKey() {
-    return "";
+    return trophyKey;
 }
 
 void setTrophyKey(std::string key) {
@@ -170,6 +171,10 @@ std::string getLogType() {
     return logType;
 }
 
+std::string getLogOverflow() {
+    return logOverflow;
+}
+
 std::string getUserName() {
     return userName;
 }
@@ -386,6 +391,10 @@ void setLogType(const std::string& type) {
     logType = type;
 }
 
+void setLogOverflow(const std::string& policy) {
+    logOverflow = policy;
+}
+
 void setLogFilter(const std::string& type) {
     logFilter = type;
 }
@@ -606,6 +615,7 @@ void setDefaultValues() {
     screenHeight = 720;
     logFilter = "";
     logType = "async";
+    logOverflow = "block";
     userName = "shadPS4";
     if (Common::isRelease) {
         updateChannel = "Release";
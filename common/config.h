@@ -33,6 +33,7 @@ bool getCheckCompatibilityOnStartup();
 
 std::string getLogFilter();
 std::string getLogType();
+std::string getLogOverflow();
 std::string getUserName();
 std::string getUpdateChannel();
 std::string getChooseHomeTab();
@@ -97,6 +98,7 @@ void setSpecialPadClass(int type);
 void setIsMotionControlsEnabled(bool use);
 
 void setLogType(const std::string& type);
+void setLogOverflow(const std::string& policy); // "block" or "drop"
 void setLogFilter(const std::string& type);
 
 void setVkValidation(bool enable);
@@ -0,0 +1,149 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <array>
+#include <cstring>
+
+#include "common/arch.h"
+#include "common/endian.h"
+
+#if defined(ARCH_X86_64)
+#include <immintrin.h>
+#elif defined(ARCH_ARM64)
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang build the vector paths for their instruction set whatever the target is and
+// pick one at run time. MSVC only gets them when the build already assumes AVX.
+#if defined(ARCH_X86_64) && (defined(__GNUC__) || defined(__clang__))
+#define ENDIAN_X86_DISPATCH 1
+#define ENDIAN_TARGET(isa) __attribute__((target(isa)))
+#elif defined(ARCH_X86_64) && defined(__AVX__)
+#define ENDIAN_X86_SSSE3 1
+#define ENDIAN_TARGET(isa)
+#endif
+
+namespace Common::Detail {
+
+namespace {
+
+constexpr std::size_t LaneSize = 16;
+constexpr std::size_t MaxLanes = 256 / LaneSize;
+
+using LaneMask = std::array<u8, LaneSize>;
+
+// The shuffle of every lane of a record, with indices relative to the lane like pshufb and
+// tbl expect them.
+std::size_t MakeLaneMasks(std::span<const u8> shuffle, std::array<LaneMask, MaxLanes>& masks) {
+    const std::size_t lanes = shuffle.size() / LaneSize;
+    for (std::size_t l = 0; l < lanes; l++) {
+        for (std::size_t i = 0; i < LaneSize; i++) {
+            masks[l][i] = static_cast<u8>(shuffle[l * LaneSize + i] - l * LaneSize);
+        }
+    }
+    return lanes;
+}
+
+void ShuffleScalar(u8* records, std::size_t count, std::span<const u8> shuffle) {
+    std::array<u8, 256> raw;
+    for (std::size_t r = 0; r < count; r++, records += shuffle.size()) {
+        std::memcpy(raw.data(), records, shuffle.size());
+        for (std::size_t i = 0; i < shuffle.size(); i++) {
+            records[i] = raw[shuffle[i]];
+        }
+    }
+}
+
+#if defined(ENDIAN_X86_DISPATCH) || defined(ENDIAN_X86_SSSE3)
+ENDIAN_TARGET("ssse3")
+void ShuffleSsse3(u8* records, std::size_t count, std::span<const u8> shuffle) {
+    std::array<LaneMask, MaxLanes> lane_masks;
+    const std::size_t lanes = MakeLaneMasks(shuffle, lane_masks);
+    __m128i masks[MaxLanes];
+    for (std::size_t l = 0; l < lanes; l++) {
+        masks[l] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lane_masks[l].data()));
+    }
+    for (std::size_t r = 0; r < count; r++) {
+        for (std::size_t l = 0; l < lanes; l++, records += LaneSize) {
+            __m128i* lane = reinterpret_cast<__m128i*>(records);
+            _mm_storeu_si128(lane, _mm_shuffle_epi8(_mm_loadu_si128(lane), masks[l]));
+        }
+    }
+}
+#endif
+
+#ifdef ENDIAN_X86_DISPATCH
+ENDIAN_TARGET("avx2")
+void ShuffleAvx2(u8* records, std::size_t count, std::span<const u8> shuffle) {
+    std::array<LaneMask, MaxLanes> lane_masks;
+    const std::size_t lanes = MakeLaneMasks(shuffle, lane_masks);
+    // vpshufb shuffles both 128-bit halves on their own, so two lanes go through at once.
+    // With an odd number of lanes per record the pairs repeat every two records.
+    const std::size_t pairs = lanes % 2 == 0 ? lanes / 2 : lanes;
+    __m256i masks[MaxLanes];
+    for (std::size_t p = 0; p < pairs; p++) {
+        masks[p] = _mm256_loadu2_m128i(
+            reinterpret_cast<const __m128i*>(lane_masks[(2 * p + 1) % lanes].data()),
+            reinterpret_cast<const __m128i*>(lane_masks[(2 * p) % lanes].data()));
+    }
+    const std::size_t total_pairs = count * lanes / 2;
+    for (std::size_t i = 0, p = 0; i < total_pairs; i++, records += 2 * LaneSize) {
+        __m256i* pair = reinterpret_cast<__m256i*>(records);
+        _mm256_storeu_si256(pair, _mm256_shuffle_epi8(_mm256_loadu_si256(pair), masks[p]));
+        p = p + 1 == pairs ? 0 : p + 1;
+    }
+    if (count * lanes % 2 != 0) {
+        // The last lane of an odd count of odd-laned records.
+        __m128i* lane = reinterpret_cast<__m128i*>(records);
+        const __m128i mask =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(lane_masks[lanes - 1].data()));
+        _mm_storeu_si128(lane, _mm_shuffle_epi8(_mm_loadu_si128(lane), mask));
+    }
+}
+#endif
+
+#ifdef ARCH_ARM64
+void ShuffleNeon(u8* records, std::size_t count, std::span<const u8> shuffle) {
+    std::array<LaneMask, MaxLanes> lane_masks;
+    const std::size_t lanes = MakeLaneMasks(shuffle, lane_masks);
+    uint8x16_t masks[MaxLanes];
+    for (std::size_t l = 0; l < lanes; l++) {
+        masks[l] = vld1q_u8(lane_masks[l].data());
+    }
+    for (std::size_t r = 0; r < count; r++) {
+        for (std::size_t l = 0; l < lanes; l++, records += LaneSize) {
+            vst1q_u8(records, vqtbl1q_u8(vld1q_u8(records), masks[l]));
+        }
+    }
+}
+#endif
+
+using ShuffleFunc = void (*)(u8*, std::size_t, std::span<const u8>);
+
+ShuffleFunc SelectShuffle() {
+#if defined(ENDIAN_X86_DISPATCH)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return ShuffleAvx2;
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return ShuffleSsse3;
+    }
+    return ShuffleScalar;
+#elif defined(ENDIAN_X86_SSSE3)
+    return ShuffleSsse3;
+#elif defined(ARCH_ARM64)
+    return ShuffleNeon;
+#else
+    return ShuffleScalar;
+#endif
+}
+
+} // Anonymous namespace
+
+void ShuffleRecords(u8* records, std::size_t count, std::span<const u8> shuffle) {
+    static const ShuffleFunc func = SelectShuffle();
+    func(records, count, shuffle);
+}
+
+} // namespace Common::Detail
@@ -9,8 +9,12 @@
 
 #pragma once
 
+#include <array>
 #include <bit>
 #include <concepts>
+#include <cstring>
+#include <span>
+#include <type_traits>
 #include "common/types.h"
 
 namespace Common {
@@ -231,6 +235,122 @@ template <typename T>
 using BigEndian =
     std::conditional_t<std::endian::native == std::endian::big, NativeEndian<T>, SwappedEndian<T>>;
 
+/// A run of `N` bytes that DecodeBigEndian copies as they are (names, digests, padding).
+template <std::size_t N>
+struct RawBytes {};
+
+namespace Detail {
+
+template <typename Field>
+struct LayoutField {
+    static_assert(std::is_integral_v<Field>, "Layout fields are integers or RawBytes");
+    static constexpr std::size_t Size = sizeof(Field);
+    static constexpr bool Swap = true;
+};
+
+template <std::size_t N>
+struct LayoutField<RawBytes<N>> {
+    static constexpr std::size_t Size = N;
+    static constexpr bool Swap = false;
+};
+
+/// Applies `shuffle` to `count` records in place, 16 bytes at a time with SSSE3/AVX2 or NEON
+/// table lookups. The shuffle must be a multiple of 16 bytes and never cross a 16-byte lane.
+void ShuffleRecords(u8* records, std::size_t count, std::span<const u8> shuffle);
+
+} // namespace Detail
+
+/**
+ * The on-disk layout of a big-endian struct, member by member in declaration order: integers
+ * are byte swapped, RawBytes<N> are kept. The byte permutation is built at compile time, so
+ * decoding a table is one shuffle per 16 bytes instead of a swap per field access.
+ */
+template <typename... Fields>
+struct BigEndianLayout {
+    static constexpr std::size_t Size = (Detail::LayoutField<Fields>::Size + ...);
+    static_assert(Size <= 256, "Shuffle indices are bytes");
+
+    /// Shuffle[i] is the on-disk byte that ends up at byte i of the native struct.
+    static constexpr std::array<u8, Size> Shuffle = [] {
+        std::array<u8, Size> shuffle{};
+        std::size_t offset = 0;
+        (
+            [&] {
+                using Field = Detail::LayoutField<Fields>;
+                for (std::size_t i = 0; i < Field::Size; i++) {
+                    shuffle[offset + i] =
+                        static_cast<u8>(offset + (Field::Swap ? Field::Size - 1 - i : i));
+                }
+                offset += Field::Size;
+            }(),
+            ...);
+        return shuffle;
+    }();
+
+    /// True when no field straddles a 16-byte lane, the vector shuffles need that.
+    static constexpr bool LaneLocal = [] {
+        if (Size % 16 != 0) {
+            return false;
+        }
+        for (std::size_t i = 0; i < Size; i++) {
+            if (Shuffle[i] / 16 != i / 16) {
+                return false;
+            }
+        }
+        return true;
+    }();
+};
+
+/// Specialised next to every native struct that is stored big-endian, as
+/// `struct BigEndianLayoutOf<T> : BigEndianLayout<...> {}`.
+template <typename T>
+struct BigEndianLayoutOf;
+
+/// Turns records freshly read from disk into native ones in place. Swapping every field is
+/// its own inverse, so this also encodes native records back to their on-disk form.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+void SwapBigEndian(std::span<T> records) {
+    using Layout = BigEndianLayoutOf<std::remove_const_t<T>>;
+    static_assert(sizeof(T) == Layout::Size, "The layout has to cover the whole struct");
+    if constexpr (std::endian::native == std::endian::little) {
+        u8* bytes = reinterpret_cast<u8*>(records.data());
+        if constexpr (Layout::LaneLocal) {
+            Detail::ShuffleRecords(bytes, records.size(), Layout::Shuffle);
+        } else {
+            std::array<u8, Layout::Size> raw;
+            for (std::size_t r = 0; r < records.size(); r++, bytes += Layout::Size) {
+                std::memcpy(raw.data(), bytes, raw.size());
+                for (std::size_t i = 0; i < raw.size(); i++) {
+                    bytes[i] = raw[Layout::Shuffle[i]];
+                }
+            }
+        }
+    }
+}
+
+/// Decodes a whole big-endian table of `records.size()` entries read in one go into `records`.
+/// False, leaving `records` alone, when `src` is too short.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+bool DecodeBigEndian(std::span<const u8> src, std::span<T> records) {
+    if (src.size() < records.size_bytes()) {
+        return false;
+    }
+    std::memcpy(records.data(), src.data(), records.size_bytes());
+    SwapBigEndian(records);
+    return true;
+}
+
+/// Writes `record` back in its on-disk big-endian form.
+template <typename T>
+    requires std::is_trivially_copyable_v<T>
+std::array<u8, sizeof(T)> EncodeBigEndian(const T& record) {
+    T copy = record;
+    SwapBigEndian(std::span<T>{&copy, 1});
+    return std::bit_cast<std::array<u8, sizeof(T)>>(copy);
+}
+
 } // namespace Common
 
 using u16_be = Common::BigEndian<u16>;
@@ -0,0 +1,372 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <utility>
+
+#include "common/file_writer.h"
+#include "common/logging/log.h"
+#include "common/path_util.h"
+
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+namespace Common::FS {
+
+namespace {
+
+#ifndef _WIN32
+// Descriptors only used as openat anchors, O_PATH skips the permission check and the open.
+#ifdef O_PATH
+constexpr int DirOpenFlags = O_PATH | O_DIRECTORY | O_CLOEXEC;
+#else
+constexpr int DirOpenFlags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+#endif
+constexpr int FileOpenFlags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+constexpr mode_t FileOpenMode = 0644;
+
+// Leaves most of the descriptor limit to the files being written and to the rest of the
+// process, directories past the cap are opened by their full path.
+size_t GetMaxDirFds() {
+    rlimit limit{};
+    if (getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return 1024;
+    }
+    return std::min<size_t>(1024, limit.rlim_cur / 4);
+}
+
+// Starts writing [offset, offset + size) back without waiting for it, size 0 = to the end.
+void StartWriteback(int fd, u64 offset, u64 size) {
+#ifdef __linux__
+    sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                    SYNC_FILE_RANGE_WRITE);
+#endif
+}
+
+// Waits for [offset, offset + size) to be on disk and evicts it, only clean pages can go.
+void DropFromCache(int fd, u64 offset, u64 size) {
+#if defined(__linux__)
+    sync_file_range(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                        SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                  POSIX_FADV_DONTNEED);
+#elif defined(__APPLE__)
+    // Uncached files are opened with F_NOCACHE, nothing is left to evict.
+#else
+    fsync(fd);
+    posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(size),
+                  POSIX_FADV_DONTNEED);
+#endif
+}
+
+bool WriteAll(int fd, std::span<const u8> data) {
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t written = write(fd, data.data() + done, data.size() - done);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(written);
+    }
+    return true;
+}
+#endif
+
+} // Anonymous namespace
+
+FileWriter::FileWriter(size_t buffer_size, u64 max_bytes) : buffer_pool{buffer_size, max_bytes} {
+#ifndef _WIN32
+    max_dir_fds = GetMaxDirFds();
+#endif
+}
+
+FileWriter::~FileWriter() {
+#ifndef _WIN32
+    for (const auto& [path, fd] : dirs) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool FileWriter::OpenDirectory(const std::filesystem::path& dir, int& dir_fd) {
+    dir_fd = -1;
+    if (dir.empty()) {
+        return true;
+    }
+    {
+        std::shared_lock lock{dir_mutex};
+        if (const auto it = dirs.find(dir.native()); it != dirs.end()) {
+            dir_fd = it->second;
+            return true;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        LOG_ERROR(Common_Filesystem, "Failed to create the directory at path={}, ec_message={}",
+                  PathToUTF8String(dir), ec.message());
+        return false;
+    }
+
+    std::unique_lock lock{dir_mutex};
+    const auto [it, inserted] = dirs.try_emplace(dir.native(), -1);
+#ifndef _WIN32
+    if (inserted && num_dir_fds < max_dir_fds) {
+        it->second = open(dir.c_str(), DirOpenFlags);
+        if (it->second >= 0) {
+            num_dir_fds++;
+        }
+    }
+#endif
+    dir_fd = it->second;
+    return true;
+}
+
+bool FileWriter::CreateDirectories(const std::filesystem::path& dir) {
+    int dir_fd;
+    return OpenDirectory(dir, dir_fd);
+}
+
+#ifndef _WIN32
+int FileWriter::OpenFile(const std::filesystem::path& path) {
+    int dir_fd;
+    if (!OpenDirectory(path.parent_path(), dir_fd)) {
+        return -1;
+    }
+    int fd;
+    do {
+        fd = dir_fd >= 0 ? openat(dir_fd, path.filename().c_str(), FileOpenFlags, FileOpenMode)
+                         : open(path.c_str(), FileOpenFlags, FileOpenMode);
+    } while (fd < 0 && errno == EINTR);
+    if (fd < 0) {
+        LOG_ERROR(Common_Filesystem, "Failed to open the file at path={}, error_message={}",
+                  PathToUTF8String(path), std::strerror(errno));
+    }
+#ifdef __APPLE__
+    if (fd >= 0 && uncached) {
+        fcntl(fd, F_NOCACHE, 1);
+    }
+#endif
+    return fd;
+}
+#endif
+
+bool FileWriter::WriteFile(const std::filesystem::path& path, std::span<const u8> data) {
+#ifdef _WIN32
+    if (!CreateDirectories(path.parent_path())) {
+        return false;
+    }
+    IOFile file{path, FileAccessMode::Write};
+    if (!file.IsOpen()) {
+        return false;
+    }
+    return file.WriteSpan(data) == data.size();
+#else
+    const int fd = OpenFile(path);
+    if (fd < 0) {
+        return false;
+    }
+    const bool written = WriteAll(fd, data);
+    if (!written) {
+        LOG_ERROR(Common_Filesystem, "Failed to write the file at path={}, error_message={}",
+                  PathToUTF8String(path), std::strerror(errno));
+    } else if (uncached) {
+        DropFromCache(fd, 0, 0);
+    }
+    return close(fd) == 0 && written;
+#endif
+}
+
+FileWriter::File FileWriter::Create(const std::filesystem::path& path) {
+    File file;
+#ifdef _WIN32
+    if (!CreateDirectories(path.parent_path())) {
+        return file;
+    }
+    file.file.Open(path, FileAccessMode::Write);
+    if (!file.file.IsOpen()) {
+        return file;
+    }
+#else
+    file.fd = OpenFile(path);
+    if (file.fd < 0) {
+        return file;
+    }
+#endif
+    file.writer = this;
+    file.path = path;
+    return file;
+}
+
+FileWriter::File::~File() {
+    Close();
+}
+
+FileWriter::File::File(File&& other) noexcept {
+    *this = std::move(other);
+}
+
+FileWriter::File& FileWriter::File::operator=(File&& other) noexcept {
+    std::swap(writer, other.writer);
+    std::swap(path, other.path);
+    std::swap(buffer, other.buffer);
+    std::swap(used, other.used);
+    std::swap(failed, other.failed);
+    std::swap(written, other.written);
+    std::swap(dropped, other.dropped);
+#ifdef _WIN32
+    std::swap(file, other.file);
+#else
+    std::swap(fd, other.fd);
+#endif
+    return *this;
+}
+
+bool FileWriter::File::IsOpen() const {
+    return writer != nullptr;
+}
+
+void FileWriter::File::WriteOut(std::span<const u8> data) {
+#ifdef _WIN32
+    const bool ok = file.WriteSpan(data) == data.size();
+#else
+    const bool ok = WriteAll(fd, data);
+#endif
+    if (!ok && !failed) {
+        LOG_ERROR(Common_Filesystem, "Failed to write the file at path={}",
+                  PathToUTF8String(path));
+    }
+    failed |= !ok;
+#ifndef _WIN32
+    // Keep one buffer in flight: start writing this one back, then wait for the one before
+    // and evict it, so the cache never holds much more than two buffers of this file.
+    if (ok && writer->uncached) {
+        StartWriteback(fd, written, data.size());
+        if (written != dropped) {
+            DropFromCache(fd, dropped, written - dropped);
+            dropped = written;
+        }
+    }
+#endif
+    written += data.size();
+}
+
+bool FileWriter::File::FlushBuffer() {
+    if (used != 0) {
+        WriteOut({buffer.data(), used});
+        used = 0;
+    }
+    return !failed;
+}
+
+bool FileWriter::File::Write(std::span<const u8> data) {
+    if (!IsOpen()) {
+        return false;
+    }
+    if (!buffer.data()) {
+        buffer = writer->buffer_pool.TryAcquire();
+    }
+    if (!buffer.data()) {
+        // The budget is used up, write through without coalescing rather than wait for it.
+        WriteOut(data);
+        return !failed;
+    }
+    while (!data.empty()) {
+        // Nothing to coalesce with, hand whole buffers worth of data over directly.
+        if (used == 0 && data.size() >= buffer.size()) {
+            WriteOut(data);
+            return !failed;
+        }
+        const size_t count = std::min(data.size(), buffer.size() - used);
+        std::memcpy(buffer.data() + used, data.data(), count);
+        used += count;
+        data = data.subspan(count);
+        if (used == buffer.size()) {
+            FlushBuffer();
+        }
+    }
+    return !failed;
+}
+
+bool FileWriter::File::Close() {
+    if (!IsOpen()) {
+        return false;
+    }
+    FlushBuffer();
+    buffer = {};
+#ifdef _WIN32
+    file.Close();
+#else
+    if (writer->uncached && !failed) {
+        DropFromCache(fd, dropped, 0);
+    }
+    failed |= close(fd) != 0;
+    fd = -1;
+#endif
+    writer = nullptr;
+    return !failed;
+}
+
+FileWriter::Batch::Batch(FileWriter& writer_) : writer{writer_} {}
+
+FileWriter::Batch::~Batch() {
+    Flush();
+}
+
+bool FileWriter::Batch::WriteNow(const std::filesystem::path& path, std::span<const u8> data) {
+    if (writer.WriteFile(path, data)) {
+        return true;
+    }
+    failures.push_back(path);
+    return false;
+}
+
+bool FileWriter::Batch::Add(const std::filesystem::path& path, std::span<const u8> data) {
+    if (data.size() > writer.GetBufferSize()) {
+        return WriteNow(path, data);
+    }
+    bool ok = true;
+    if (used + data.size() > writer.GetBufferSize() || pending.size() == MaxFiles) {
+        ok = Flush();
+    }
+    if (!buffer.data()) {
+        buffer = writer.buffer_pool.TryAcquire();
+    }
+    if (!buffer.data()) {
+        // No buffer left in the budget, nothing is queued either.
+        return WriteNow(path, data) && ok;
+    }
+    if (!data.empty()) {
+        std::memcpy(buffer.data() + used, data.data(), data.size());
+    }
+    pending.push_back({path, used, data.size()});
+    used += data.size();
+    return ok;
+}
+
+bool FileWriter::Batch::Flush() {
+    bool ok = true;
+    for (const Pending& file : pending) {
+        ok &= WriteNow(file.path, {buffer.data() + file.offset, file.size});
+    }
+    pending.clear();
+    used = 0;
+    // Give the buffer back between bursts so idle batches don't hold on to pool memory.
+    buffer = {};
+    return ok;
+}
+
+} // namespace Common::FS
@@ -0,0 +1,169 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <shared_mutex>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "common/buffer_pool.h"
+#include "common/io_file.h"
+#include "common/types.h"
+
+namespace Common::FS {
+
+/**
+ * Creates lots of output files with as little per-file work as possible. Every directory is
+ * created once and remembered, on POSIX systems together with an open descriptor so files are
+ * opened with openat relative to it instead of resolving the whole path again. Data goes
+ * through reusable pool buffers and straight to the system, without stdio in between.
+ * All methods can be called from several threads at once.
+ */
+class FileWriter final {
+public:
+    static constexpr size_t DefaultBufferSize = 1_MB;
+
+    /// An output file whose writes are coalesced into one pool buffer.
+    class File {
+    public:
+        File() = default;
+        ~File();
+
+        File(const File&) = delete;
+        File& operator=(const File&) = delete;
+
+        File(File&& other) noexcept;
+        File& operator=(File&& other) noexcept;
+
+        bool IsOpen() const;
+
+        bool Write(std::span<const u8> data);
+
+        /// Writes out what is still buffered and closes the file. False if any write failed.
+        bool Close();
+
+    private:
+        friend class FileWriter;
+
+        bool FlushBuffer();
+        void WriteOut(std::span<const u8> data);
+
+        FileWriter* writer = nullptr;
+        std::filesystem::path path;
+        BufferPool::Buffer buffer;
+        size_t used = 0;
+        bool failed = false;
+        u64 written = 0; // bytes handed to the system so far
+        u64 dropped = 0; // bytes already evicted from the page cache, in uncached mode
+#ifdef _WIN32
+        IOFile file;
+#else
+        int fd = -1;
+#endif
+    };
+
+    /**
+     * Queues small files and writes them in one run once the buffer or the file count is full,
+     * so a worker creates files in bursts instead of between every inflated block. Files that
+     * don't fit the buffer are written at once. Every file that fails to be written, queued
+     * or not, is kept for TakeFailures. Meant to be owned by a single thread.
+     */
+    class Batch {
+    public:
+        static constexpr size_t MaxFiles = 256;
+
+        explicit Batch(FileWriter& writer);
+        ~Batch();
+
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+
+        /// False if the file, or a flush it caused, failed to be written. TakeFailures tells
+        /// which one.
+        bool Add(const std::filesystem::path& path, std::span<const u8> data);
+
+        /// Writes every queued file. False if any of them failed.
+        bool Flush();
+
+        /// True when every file added so far is on disk.
+        bool Empty() const {
+            return pending.empty();
+        }
+
+        /// The files that failed to be written since the last call.
+        std::vector<std::filesystem::path> TakeFailures() {
+            return std::exchange(failures, {});
+        }
+
+    private:
+        struct Pending {
+            std::filesystem::path path;
+            size_t offset;
+            size_t size;
+        };
+
+        bool WriteNow(const std::filesystem::path& path, std::span<const u8> data);
+
+        FileWriter& writer;
+        BufferPool::Buffer buffer;
+        size_t used = 0;
+        std::vector<Pending> pending;
+        std::vector<std::filesystem::path> failures;
+    };
+
+    /// `max_bytes` caps the write buffers held at once, 0 = no limit. Writers never wait for
+    /// the budget: once it is used up, files are written through without coalescing.
+    explicit FileWriter(size_t buffer_size = DefaultBufferSize, u64 max_bytes = 0);
+    ~FileWriter();
+
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+
+    /**
+     * Keeps the written data out of the page cache: every file is written back and evicted
+     * (posix_fadvise DONTNEED) once it is complete, streamed files a buffer at a time, so a
+     * huge extraction doesn't push out what other processes have cached. Small files become
+     * synchronous, expect fewer files/s. Set it before writing anything. POSIX only.
+     */
+    void SetUncached(bool enable) {
+        uncached = enable;
+    }
+
+    /// Creates `dir` and its parents unless this writer already did.
+    bool CreateDirectories(const std::filesystem::path& dir);
+
+    /// Creates or truncates `path`, parent directories included, and writes `data` to it.
+    bool WriteFile(const std::filesystem::path& path, std::span<const u8> data);
+
+    /// Creates or truncates `path`, parent directories included, for writing piece by piece.
+    /// The returned file is not open if that failed.
+    File Create(const std::filesystem::path& path);
+
+    size_t GetBufferSize() const {
+        return buffer_pool.GetBufferSize();
+    }
+
+private:
+    /// Makes sure `dir` exists. `dir_fd` receives its cached descriptor, or -1 when the file
+    /// has to be opened by its full path.
+    bool OpenDirectory(const std::filesystem::path& dir, int& dir_fd);
+
+#ifndef _WIN32
+    int OpenFile(const std::filesystem::path& path);
+#endif
+
+    BufferPool buffer_pool;
+    bool uncached = false;
+
+    std::shared_mutex dir_mutex;
+    std::unordered_map<std::filesystem::path::string_type, int> dirs; // path -> fd or -1
+    size_t num_dir_fds = 0;
+    size_t max_dir_fds = 0;
+};
+
+} // namespace Common::FS
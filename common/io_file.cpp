@@ -1,6 +1,7 @@
 // SPDX-FileCopyrightText: Copyright 2021 yuzu Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
 #include <vector>
 
 #include "common/alignment.h"
@@ -17,6 +18,9 @@
 #include <share.h>
 #include <windows.h>
 #else
+#include <climits>
+#include <fcntl.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #endif
 
@@ -134,6 +138,12 @@ namespace {
     }
 }
 
+[[nodiscard]] bool IsDirectAligned(u64 offset, std::span<const u8> data) {
+    return IsAligned(offset, IOFile::DirectAlignment) &&
+           IsAligned(data.size(), IOFile::DirectAlignment) &&
+           IsAligned(reinterpret_cast<uintptr_t>(data.data()), IOFile::DirectAlignment);
+}
+
 } // Anonymous namespace
 
 IOFile::IOFile() = default;
@@ -159,6 +169,11 @@ IOFile::IOFile(IOFile&& other) noexcept {
     std::swap(file_access_mode, other.file_access_mode);
     std::swap(file_type, other.file_type);
     std::swap(file, other.file);
+#ifdef _WIN32
+    std::swap(direct_handle, other.direct_handle);
+#else
+    std::swap(direct_fd, other.direct_fd);
+#endif
 }
 
 IOFile& IOFile::operator=(IOFile&& other) noexcept {
@@ -166,6 +181,11 @@ IOFile& IOFile::operator=(IOFile&& other) noexcept {
     std::swap(file_access_mode, other.file_access_mode);
     std::swap(file_type, other.file_type);
     std::swap(file, other.file);
+#ifdef _WIN32
+    std::swap(direct_handle, other.direct_handle);
+#else
+    std::swap(direct_fd, other.direct_fd);
+#endif
     return *this;
 }
 
@@ -217,6 +237,18 @@ void IOFile::Close() {
 
     file = nullptr;
 
+#ifdef _WIN32
+    if (direct_handle) {
+        CloseHandle(direct_handle);
+        direct_handle = nullptr;
+    }
+#else
+    if (direct_fd >= 0) {
+        close(direct_fd);
+        direct_fd = -1;
+    }
+#endif
+
 #ifdef _WIN64
     if (file_mapping && file_access_mode == FileAccessMode::ReadWrite) {
         CloseHandle(std::bit_cast<HANDLE>(file_mapping));
@@ -285,6 +317,201 @@ std::string IOFile::ReadString(size_t length) const {
     return std::string{string_buffer.data(), string_size};
 }
 
+#ifdef _WIN32
+
+namespace {
+
+HANDLE GetHandle(std::FILE* file) {
+    return reinterpret_cast<HANDLE>(_get_osfhandle(fileno(file)));
+}
+
+// Synchronous handles take the offset from the OVERLAPPED structure, the same as pread.
+size_t TransferAt(HANDLE hfile, u64 offset, void* data, size_t size, bool write) {
+    size_t done = 0;
+    while (done < size) {
+        OVERLAPPED ol{};
+        ol.Offset = static_cast<DWORD>(offset + done);
+        ol.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+        const DWORD chunk = static_cast<DWORD>(std::min<size_t>(size - done, 1U << 30));
+        DWORD transferred = 0;
+        u8* ptr = static_cast<u8*>(data) + done;
+        const BOOL ok = write ? WriteFile(hfile, ptr, chunk, &transferred, &ol)
+                              : ReadFile(hfile, ptr, chunk, &transferred, &ol);
+        if (!ok || transferred == 0) {
+            break;
+        }
+        done += transferred;
+    }
+    return done;
+}
+
+} // Anonymous namespace
+
+size_t IOFile::ReadAt(u64 offset, std::span<u8> data) const {
+    if (!IsOpen()) {
+        return 0;
+    }
+    if (direct_handle && IsDirectAligned(offset, data)) {
+        return TransferAt(direct_handle, offset, data.data(), data.size(), false);
+    }
+    return TransferAt(GetHandle(file), offset, data.data(), data.size(), false);
+}
+
+size_t IOFile::WriteAt(u64 offset, std::span<const u8> data) const {
+    if (!IsOpen()) {
+        return 0;
+    }
+    return TransferAt(GetHandle(file), offset, const_cast<u8*>(data.data()), data.size(), true);
+}
+
+size_t IOFile::ReadAtV(u64 offset, std::span<const std::span<u8>> buffers) const {
+    size_t total = 0;
+    for (const auto& buffer : buffers) {
+        const size_t read = ReadAt(offset + total, buffer);
+        total += read;
+        if (read != buffer.size()) {
+            break;
+        }
+    }
+    return total;
+}
+
+#else
+
+size_t IOFile::ReadAt(u64 offset, std::span<u8> data) const {
+    if (!IsOpen()) {
+        return 0;
+    }
+    int fd = direct_fd >= 0 && IsDirectAligned(offset, data) ? direct_fd : fileno(file);
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t read = pread(fd, data.data() + done, data.size() - done,
+                                   static_cast<off_t>(offset + done));
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        // Some file systems have stricter rules for direct I/O, fall back to the cache.
+        if (read < 0 && errno == EINVAL && fd == direct_fd) {
+            fd = fileno(file);
+            continue;
+        }
+        if (read <= 0) {
+            break;
+        }
+        done += read;
+    }
+    return done;
+}
+
+size_t IOFile::WriteAt(u64 offset, std::span<const u8> data) const {
+    if (!IsOpen()) {
+        return 0;
+    }
+    const int fd = fileno(file);
+    size_t done = 0;
+    while (done < data.size()) {
+        const ssize_t written = pwrite(fd, data.data() + done, data.size() - done,
+                                       static_cast<off_t>(offset + done));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            const auto ec = std::error_code{errno, std::generic_category()};
+            LOG_ERROR(Common_Filesystem,
+                      "Failed to write the file at path={}, offset={}, ec_message={}",
+                      PathToUTF8String(file_path), offset + done, ec.message());
+            break;
+        }
+        done += written;
+    }
+    return done;
+}
+
+size_t IOFile::ReadAtV(u64 offset, std::span<const std::span<u8>> buffers) const {
+    if (!IsOpen()) {
+        return 0;
+    }
+    const int fd = fileno(file);
+    std::vector<iovec> iov;
+    iov.reserve(buffers.size());
+    for (const auto& buffer : buffers) {
+        if (!buffer.empty()) {
+            iov.push_back({buffer.data(), buffer.size()});
+        }
+    }
+
+    // A short read leaves the remaining buffers, and maybe part of one, for the next call.
+    size_t total = 0;
+    size_t first = 0;
+    while (first < iov.size()) {
+        const int count = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+        const ssize_t read =
+            preadv(fd, iov.data() + first, count, static_cast<off_t>(offset + total));
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            break;
+        }
+        total += read;
+        size_t left = read;
+        while (first < iov.size() && left >= iov[first].iov_len) {
+            left -= iov[first++].iov_len;
+        }
+        if (left != 0) {
+            iov[first].iov_base = static_cast<u8*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    return total;
+}
+
+#endif
+
+bool IOFile::OpenDirect() {
+    if (!IsOpen() || IsDirect()) {
+        return IsDirect();
+    }
+#ifdef _WIN32
+    const HANDLE handle =
+        CreateFileW(file_path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                    OPEN_EXISTING, FILE_FLAG_NO_BUFFERING, nullptr);
+    if (handle == INVALID_HANDLE_VALUE) {
+        LOG_WARNING(Common_Filesystem, "No uncached handle for path={}, error_message={}",
+                    PathToUTF8String(file_path), Common::GetLastErrorMsg());
+        return false;
+    }
+    direct_handle = handle;
+#else
+#ifdef O_DIRECT
+    direct_fd = open(file_path.c_str(), O_RDONLY | O_DIRECT | O_CLOEXEC);
+#else
+    direct_fd = open(file_path.c_str(), O_RDONLY | O_CLOEXEC);
+#ifdef F_NOCACHE
+    if (direct_fd >= 0 && fcntl(direct_fd, F_NOCACHE, 1) != 0) {
+        close(direct_fd);
+        direct_fd = -1;
+    }
+#endif
+#endif
+    if (direct_fd < 0) {
+        const auto ec = std::error_code{errno, std::generic_category()};
+        LOG_WARNING(Common_Filesystem, "No uncached handle for path={}, ec_message={}",
+                    PathToUTF8String(file_path), ec.message());
+        return false;
+    }
+#endif
+    return true;
+}
+
+bool IOFile::IsDirect() const {
+#ifdef _WIN32
+    return direct_handle != nullptr;
+#else
+    return direct_fd >= 0;
+#endif
+}
+
 bool IOFile::Flush() const {
     if (!IsOpen()) {
         return false;
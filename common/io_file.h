@@ -203,6 +203,33 @@ public:
 
     std::string ReadString(size_t length) const;
 
+    /**
+     * Positional I/O, at `offset` without using or moving the file position, so one IOFile can
+     * be shared by several threads. It bypasses the stdio buffer, Flush first if the file was
+     * written with Write. Returns the number of bytes transferred, which is short only at the
+     * end of the file or on error.
+     */
+    size_t ReadAt(u64 offset, std::span<u8> data) const;
+    size_t WriteAt(u64 offset, std::span<const u8> data) const;
+
+    /// Reads the range starting at `offset` into `buffers` one after the other, with a single
+    /// vectored read where the system has one.
+    size_t ReadAtV(u64 offset, std::span<const std::span<u8>> buffers) const;
+
+    /// Offset, size and buffer address granularity of uncached reads. Covers the sector size
+    /// of every common drive.
+    static constexpr size_t DirectAlignment = 0x1000;
+
+    /**
+     * Opens a second handle to the file that bypasses the page cache (O_DIRECT, F_NOCACHE or
+     * FILE_FLAG_NO_BUFFERING). ReadAt then serves reads whose offset, size and buffer are
+     * aligned to DirectAlignment through it, everything else still goes through the cache.
+     * Returns false, and keeps reading through the cache, if the system refuses the handle.
+     */
+    bool OpenDirect();
+
+    bool IsDirect() const;
+
     size_t WriteString(std::span<const char> string) const {
         return WriteSpan(string);
     }
@@ -219,6 +246,11 @@ private:
 
     std::FILE* file = nullptr;
     uintptr_t file_mapping = 0;
+#ifdef _WIN32
+    void* direct_handle = nullptr;
+#else
+    int direct_fd = -1;
+#endif
 };
 
 u64 GetDirectorySize(const std::filesystem::path& path);
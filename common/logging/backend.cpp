@@ -1,9 +1,13 @@
 // SPDX-FileCopyrightText: Copyright 2014 Citra Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
 #include <chrono>
 #include <filesystem>
+#include <mutex>
+#include <optional>
 #include <thread>
+#include <vector>
 
 #include <fmt/format.h>
 
@@ -11,13 +15,16 @@
 #include <windows.h> // For OutputDebugStringW
 #endif
 
-#include "common/bounded_threadsafe_queue.h"
 #include "common/config.h"
 #include "common/debug.h"
 #include "common/io_file.h"
 #include "common/logging/backend.h"
+#include "common/logging/binary_log.h"
 #include "common/logging/log.h"
+#include "common/logging/log_args.h"
 #include "common/logging/log_entry.h"
+#include "common/logging/log_ring.h"
+#include "common/logging/rate_limiter.h"
 #include "common/logging/text_formatter.h"
 #include "common/path_util.h"
 #include "common/string_util.h"
@@ -52,6 +59,10 @@ public:
         enabled = enabled_;
     }
 
+    bool IsEnabled() const {
+        return enabled.load(std::memory_order_relaxed);
+    }
+
 private:
     std::atomic_bool enabled{true};
 };
@@ -96,6 +107,40 @@ private:
     std::size_t bytes_written = 0;
 };
 
+/**
+ * Backend that writes unformatted records to a binary file, see BinaryLogWriter
+ */
+class BinaryFileBackend {
+public:
+    explicit BinaryFileBackend(const std::filesystem::path& filename) : writer{filename} {}
+
+    void Write(const RingRecord& record, std::span<const u8> payload) {
+        if (!enabled) {
+            return;
+        }
+
+        bytes_written += writer.Write(record, payload);
+
+        // Same cap as the text log.
+        const bool write_limit_exceeded = bytes_written > 100_MB;
+        if (record.log_level >= Level::Error || write_limit_exceeded) {
+            if (write_limit_exceeded) {
+                enabled = false;
+            }
+            writer.Flush();
+        }
+    }
+
+    void Flush() {
+        writer.Flush();
+    }
+
+private:
+    BinaryLogWriter writer;
+    bool enabled = true;
+    std::size_t bytes_written = 0;
+};
+
 /**
  * Backend that writes to Visual Studio's output window
  */
@@ -118,6 +163,47 @@ public:
 
 bool initialization_in_progress_suppress_logging = true;
 
+// Set once the "binary" log type is active, read on every log call before formatting.
+std::atomic_bool deferred_logging{false};
+
+/// The Config::getLogType() string, parsed once at initialization.
+enum class LogType {
+    Sync,   ///< Written by the calling thread
+    Async,  ///< Formatted by the calling thread, written by the backend thread
+    Binary, ///< Formatted and written by the backend thread, binary log file
+};
+
+LogType ParseLogType(std::string_view type) {
+    if (type == "sync") {
+        return LogType::Sync;
+    }
+    if (type == "binary") {
+        return LogType::Binary;
+    }
+    return LogType::Async;
+}
+
+// Applies unless the filter string has its own RateLimit rule. Well above what a normal run
+// logs from one line, it only stops a warning repeated for every block of a broken package
+// from filling the log file.
+constexpr u32 DefaultRateLimitBurst = 100;
+constexpr u32 DefaultRateLimitPerSecond = 10;
+
+OverflowPolicy ParseOverflowPolicy(std::string_view policy) {
+    return policy == "drop" ? OverflowPolicy::Drop : OverflowPolicy::Block;
+}
+
+/// Owns the calling thread's ring, which is handed over to the backend thread when it exits.
+struct ThreadRing {
+    std::shared_ptr<LogRing> ring;
+
+    ~ThreadRing() {
+        if (ring) {
+            ring->closed.store(true, std::memory_order_release);
+        }
+    }
+};
+
 /**
  * Static state as a singleton.
  */
@@ -138,9 +224,11 @@ public:
         const auto& log_dir = GetUserPath(PathType::LogDir);
         std::filesystem::create_directories(log_dir);
         Filter filter;
+        filter.SetRateLimit(DefaultRateLimitBurst, DefaultRateLimitPerSecond);
         filter.ParseFilterString(Config::getLogFilter());
         instance = std::unique_ptr<Impl, decltype(&Deleter)>(new Impl(log_dir / LOG_FILE, filter),
                                                              Deleter);
+        deferred_logging = instance->log_type == LogType::Binary;
         initialization_in_progress_suppress_logging = false;
     }
 
@@ -170,6 +258,51 @@ public:
         color_console_backend.SetEnabled(enabled);
     }
 
+    bool CheckMessage(Class log_class, Level log_level) const {
+        return filter.CheckMessage(log_class, log_level);
+    }
+
+    /// The per call site limits of the filter, for messages that passed CheckMessage.
+    bool CheckSite(Class log_class, Level log_level, const char* filename,
+                   unsigned int line_num, const char* function) {
+        if (!filter.HasSiteLimits()) [[likely]] {
+            return true;
+        }
+        const RateLimiter::Site site{
+            .filename = filename,
+            .function = function,
+            .line_num = line_num,
+            .log_class = log_class,
+            .log_level = log_level,
+        };
+        u64 suppressed;
+        if (!rate_limiter.Check(filter, site, static_cast<u64>(GetTimestamp().count()),
+                                suppressed)) {
+            return false;
+        }
+        if (suppressed != 0) [[unlikely]] {
+            WriteSuppressed(site, suppressed);
+        }
+        return true;
+    }
+
+    /// Queues a message whose arguments were captured with Deferred::EncodeArgs (binary type).
+    void PushDeferred(Class log_class, Level log_level, const char* filename,
+                      unsigned int line_num, const char* function, const char* format,
+                      std::span<const u8> args) {
+        PushRecord(
+            RingRecord{
+                .timestamp_us = static_cast<u64>(GetTimestamp().count()),
+                .filename = filename,
+                .function = function,
+                .format = format,
+                .line_num = line_num,
+                .log_class = log_class,
+                .log_level = log_level,
+            },
+            args);
+    }
+
     void PushEntry(Class log_class, Level log_level, const char* filename, unsigned int line_num,
                    const char* function, std::string message) {
         // Propagate important log messages to the profiler (DISABILITATO: Tracy non disponibile)
@@ -178,12 +311,28 @@ public:
             return;
         }
 
-        using std::chrono::duration_cast;
-        using std::chrono::microseconds;
-        using std::chrono::steady_clock;
+        if (log_type != LogType::Sync) {
+            // Goes through the thread's ring like deferred messages, so it keeps its place
+            // among them.
+            static constexpr size_t MaxMessage = LogRing::Capacity / 2 - sizeof(RingRecord) - 8;
+            const std::span<const u8> text(reinterpret_cast<const u8*>(message.data()),
+                                           std::min(message.size(), MaxMessage));
+            PushRecord(
+                RingRecord{
+                    .timestamp_us = static_cast<u64>(GetTimestamp().count()),
+                    .filename = filename,
+                    .function = function,
+                    .format = nullptr,
+                    .line_num = line_num,
+                    .log_class = log_class,
+                    .log_level = log_level,
+                },
+                text);
+            return;
+        }
 
         const Entry entry = {
-            .timestamp = duration_cast<microseconds>(steady_clock::now() - time_origin),
+            .timestamp = GetTimestamp(),
             .log_class = log_class,
             .log_level = log_level,
             .filename = filename,
@@ -191,55 +340,171 @@ public:
             .function = function,
             .message = std::move(message),
         };
-        if (Config::getLogType() == "async") {
-            message_queue.EmplaceWait(entry);
-        } else {
-            ForEachBackend([&entry](auto& backend) { backend.Write(entry); });
-            std::fflush(stdout);
-        }
+        ForEachBackend([&entry](auto& backend) { backend.Write(entry); });
+        std::fflush(stdout);
     }
 
 private:
     Impl(const std::filesystem::path& file_backend_filename, const Filter& filter_)
-        : filter{filter_}, file_backend{file_backend_filename} {}
+        : filter{filter_}, log_type{ParseLogType(Config::getLogType())},
+          overflow_policy{ParseOverflowPolicy(Config::getLogOverflow())} {
+        if (log_type == LogType::Binary) {
+            binary_file_backend.emplace(
+                std::filesystem::path{file_backend_filename}.replace_extension(".bin"));
+        } else {
+            file_backend.emplace(file_backend_filename);
+        }
+    }
 
     ~Impl() = default;
 
+    std::chrono::microseconds GetTimestamp() const {
+        using std::chrono::duration_cast;
+        using std::chrono::microseconds;
+        using std::chrono::steady_clock;
+        return duration_cast<microseconds>(steady_clock::now() - time_origin);
+    }
+
+    /// The calling thread's ring, registered with the backend thread on first use.
+    LogRing& GetThreadRing() {
+        thread_local ThreadRing local;
+        if (!local.ring) [[unlikely]] {
+            local.ring = std::make_shared<LogRing>();
+            std::scoped_lock lock{rings_mutex};
+            rings.push_back(local.ring);
+        }
+        return *local.ring;
+    }
+
+    void PushRecord(const RingRecord& record, std::span<const u8> payload) {
+        GetThreadRing().Push(record, payload, overflow_policy);
+    }
+
+    void WriteRecord(const RingRecord& record, std::span<const u8> payload) {
+        if (binary_file_backend) {
+            binary_file_backend->Write(record, payload);
+        }
+        if (!color_console_backend.IsEnabled() && !file_backend) {
+            return;
+        }
+        // Formatting only happens here, on the backend thread.
+        const Entry entry = {
+            .timestamp = std::chrono::microseconds{record.timestamp_us},
+            .log_class = record.log_class,
+            .log_level = record.log_level,
+            .filename = record.filename,
+            .line_num = record.line_num,
+            .function = record.function,
+            .message = record.format
+                           ? FormatDeferredMessage(record.format, payload)
+                           : std::string(reinterpret_cast<const char*>(payload.data()),
+                                         payload.size()),
+        };
+        ForEachBackend([&entry](auto& backend) { backend.Write(entry); });
+    }
+
+    /**
+     * Writes out everything pushed to the thread rings so far, returns the number of records.
+     * Each ring is in order on its own, the rings are merged by timestamp so the output reads
+     * as one timeline.
+     */
+    size_t DrainRings() {
+        std::scoped_lock lock{rings_mutex};
+        std::vector<Cursor>& cursors = drain_cursors;
+        cursors.clear();
+        for (const auto& ring : rings) {
+            Cursor cursor{ring.get(), ring->Head()};
+            if (ring->Front(cursor.limit, cursor.record, cursor.payload)) {
+                cursors.push_back(cursor);
+            }
+        }
+
+        size_t count = 0;
+        while (!cursors.empty()) {
+            // Few rings, a linear scan beats a heap here.
+            const auto oldest = std::ranges::min_element(
+                cursors, {}, [](const Cursor& cursor) { return cursor.record.timestamp_us; });
+            WriteRecord(oldest->record, oldest->payload);
+            oldest->ring->Pop(oldest->record);
+            count++;
+            if (!oldest->ring->Front(oldest->limit, oldest->record, oldest->payload)) {
+                *oldest = cursors.back();
+                cursors.pop_back();
+            }
+        }
+
+        u64 dropped = 0;
+        for (const auto& ring : rings) {
+            dropped += ring->dropped.exchange(0, std::memory_order_relaxed);
+        }
+        if (dropped != 0) {
+            WriteDroppedSummary(dropped);
+        }
+
+        // Rings of threads that exited go away once empty. `closed` is read first so nothing
+        // pushed before the thread exited can be missed.
+        std::erase_if(rings, [](const auto& ring) {
+            return ring->closed.load(std::memory_order_acquire) && ring->Empty();
+        });
+        return count;
+    }
+
+    void WriteSuppressed(const RateLimiter::Site& site, u64 count) {
+        PushEntry(site.log_class, site.log_level, site.filename, site.line_num, site.function,
+                  fmt::format("{} more messages from here suppressed by the rate limit", count));
+    }
+
+    void WriteDroppedSummary(u64 dropped) {
+        const std::string text = fmt::format("{} log messages dropped, log buffer full", dropped);
+        WriteRecord(
+            RingRecord{
+                .timestamp_us = static_cast<u64>(GetTimestamp().count()),
+                .filename = TrimSourcePath(__FILE__),
+                .function = __func__,
+                .format = nullptr,
+                .line_num = __LINE__,
+                .log_class = Class::Log,
+                .log_level = Level::Warning,
+            },
+            std::span(reinterpret_cast<const u8*>(text.data()), text.size()));
+    }
+
     void StartBackendThread() {
+        if (log_type == LogType::Sync) {
+            return;
+        }
         backend_thread = std::jthread([this](std::stop_token stop_token) {
             Common::SetCurrentThreadName("shadPS4:Log");
-            Entry entry;
-            const auto write_logs = [this, &entry]() {
-                ForEachBackend([&entry](auto& backend) { backend.Write(entry); });
-            };
             while (!stop_token.stop_requested()) {
-                message_queue.PopWait(entry, stop_token);
-                if (entry.filename != nullptr) {
-                    write_logs();
+                if (DrainRings() == 0) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
                 }
             }
-            // Drain the logging queue. Only writes out up to MAX_LOGS_TO_WRITE to prevent a
-            // case where a system is repeatedly spamming logs even on close.
-            int max_logs_to_write = filter.IsDebug() ? std::numeric_limits<s32>::max() : 100;
-            while (max_logs_to_write-- && message_queue.TryPop(entry)) {
-                write_logs();
-            }
+            DrainRings();
         });
     }
 
     void StopBackendThread() {
+        rate_limiter.TakeSuppressed([this](const RateLimiter::Site& site, u64 count) {
+            WriteSuppressed(site, count);
+        });
         backend_thread.request_stop();
         if (backend_thread.joinable()) {
             backend_thread.join();
         }
 
         ForEachBackend([](auto& backend) { backend.Flush(); });
+        if (binary_file_backend) {
+            binary_file_backend->Flush();
+        }
     }
 
     void ForEachBackend(auto lambda) {
         // lambda(debugger_backend);
         lambda(color_console_backend);
-        lambda(file_backend);
+        if (file_backend) {
+            lambda(*file_backend);
+        }
     }
 
     static void Deleter(Impl* ptr) {
@@ -249,11 +514,24 @@ private:
     static inline std::unique_ptr<Impl, decltype(&Deleter)> instance{nullptr, Deleter};
 
     Filter filter;
+    const LogType log_type;
+    const OverflowPolicy overflow_policy;
     DebuggerBackend debugger_backend{};
     ColorConsoleBackend color_console_backend{};
-    FileBackend file_backend;
-
-    MPSCQueue<Entry> message_queue{};
+    std::optional<FileBackend> file_backend;
+    std::optional<BinaryFileBackend> binary_file_backend;
+
+    RateLimiter rate_limiter;
+    std::mutex rings_mutex;
+    std::vector<std::shared_ptr<LogRing>> rings;
+    /// DrainRings position in one ring.
+    struct Cursor {
+        LogRing* ring;
+        u64 limit; ///< Records pushed after the drain started wait for the next one
+        RingRecord record;
+        std::span<const u8> payload;
+    };
+    std::vector<Cursor> drain_cursors;
     std::chrono::steady_clock::time_point time_origin{std::chrono::steady_clock::now()};
     std::jthread backend_thread;
 };
@@ -283,10 +561,34 @@ void SetColorConsoleBackendEnabled(bool enabled) {
     Impl::Instance().SetColorConsoleBackendEnabled(enabled);
 }
 
+bool CheckLogMessage(Class log_class, Level log_level, const char* filename,
+                     unsigned int line_num, const char* function) {
+    if (initialization_in_progress_suppress_logging) {
+        return false;
+    }
+    Impl& impl = Impl::Instance();
+    return impl.CheckMessage(log_class, log_level) &&
+           impl.CheckSite(log_class, log_level, filename, line_num, function);
+}
+
+bool IsDeferredLogging() {
+    return deferred_logging.load(std::memory_order_relaxed);
+}
+
+void PushDeferredLogMessage(Class log_class, Level log_level, const char* filename,
+                            unsigned int line_num, const char* function, const char* format,
+                            std::span<const u8> args) {
+    Impl::Instance().PushDeferred(log_class, log_level, filename, line_num, function, format,
+                                  args);
+}
+
 void FmtLogMessageImpl(Class log_class, Level log_level, const char* filename,
                        unsigned int line_num, const char* function, const char* format,
                        const fmt::format_args& args) {
-    if (!initialization_in_progress_suppress_logging) [[likely]] {
+    // FmtLogMessage already applied the filter and the call site limits. Checking the level
+    // again only keeps direct callers from formatting a dropped message.
+    if (!initialization_in_progress_suppress_logging &&
+        Impl::Instance().CheckMessage(log_class, log_level)) [[likely]] {
         Impl::Instance().PushEntry(log_class, log_level, filename, line_num, function,
                                    fmt::vformat(format, args));
     }
@@ -0,0 +1,157 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <array>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+#include "common/logging/binary_log.h"
+#include "common/logging/log_args.h"
+#include "common/logging/log_entry.h"
+
+namespace Common::Log {
+
+namespace {
+
+constexpr std::array<char, 8> Magic{'S', 'P', 'K', 'G', 'L', 'O', 'G', 0x01};
+constexpr u8 StringRecord = 1;
+constexpr u8 MessageRecord = 2;
+constexpr u32 NoFormat = 0xFFFFFFFF;
+
+template <typename T>
+void Append(std::vector<u8>& out, const T& value) {
+    const auto* bytes = reinterpret_cast<const u8*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+} // Anonymous namespace
+
+BinaryLogWriter::BinaryLogWriter(const std::filesystem::path& path)
+    : file{path, FS::FileAccessMode::Write} {
+    file.WriteRaw<char>(Magic.data(), Magic.size());
+}
+
+u32 BinaryLogWriter::GetStringId(const char* str) {
+    const auto [it, inserted] = string_ids.try_emplace(str, static_cast<u32>(string_ids.size()));
+    if (inserted) {
+        const std::string_view text = str ? str : "";
+        Append(scratch, StringRecord);
+        Append(scratch, it->second);
+        Append(scratch, static_cast<u32>(text.size()));
+        scratch.insert(scratch.end(), text.begin(), text.end());
+    }
+    return it->second;
+}
+
+size_t BinaryLogWriter::Write(const RingRecord& record, std::span<const u8> payload) {
+    scratch.clear();
+    const u32 filename = GetStringId(record.filename);
+    const u32 function = GetStringId(record.function);
+    const u32 format = record.format ? GetStringId(record.format) : NoFormat;
+
+    Append(scratch, MessageRecord);
+    Append(scratch, record.timestamp_us);
+    Append(scratch, record.log_class);
+    Append(scratch, record.log_level);
+    Append(scratch, record.line_num);
+    Append(scratch, filename);
+    Append(scratch, function);
+    Append(scratch, format);
+    Append(scratch, static_cast<u32>(payload.size()));
+    scratch.insert(scratch.end(), payload.begin(), payload.end());
+    return file.WriteRaw<u8>(scratch.data(), scratch.size());
+}
+
+void BinaryLogWriter::Flush() {
+    file.Flush();
+}
+
+bool DecodeBinaryLog(const std::filesystem::path& path, const std::function<void(const Entry&)>& func,
+                     std::string& failreason) {
+    Common::FS::IOFile file(path, FS::FileAccessMode::Read);
+    if (!file.IsOpen()) {
+        failreason = "Cannot open " + path.string();
+        return false;
+    }
+    std::vector<u8> data(file.GetSize());
+    if (file.ReadSpan<u8>(data) != data.size() || data.size() < Magic.size() ||
+        std::memcmp(data.data(), Magic.data(), Magic.size()) != 0) {
+        failreason = "Not a binary log file";
+        return false;
+    }
+
+    size_t offset = Magic.size();
+    const auto read = [&](auto& value) {
+        if (sizeof(value) > data.size() - offset) {
+            return false;
+        }
+        std::memcpy(&value, data.data() + offset, sizeof(value));
+        offset += sizeof(value);
+        return true;
+    };
+    const auto read_bytes = [&](u32 size, std::span<const u8>& out) {
+        if (size > data.size() - offset) {
+            return false;
+        }
+        out = std::span<const u8>(data).subspan(offset, size);
+        offset += size;
+        return true;
+    };
+
+    // Entry keeps raw pointers to the file name, the strings live until decoding ends.
+    std::vector<std::string> strings;
+    const auto get_string = [&](u32 id) -> const std::string& {
+        static const std::string unknown = "?";
+        return id < strings.size() ? strings[id] : unknown;
+    };
+
+    while (offset < data.size()) {
+        u8 kind;
+        read(kind);
+        if (kind == StringRecord) {
+            u32 id, size;
+            std::span<const u8> text;
+            if (!read(id) || !read(size) || !read_bytes(size, text)) {
+                break;
+            }
+            if (id >= strings.size()) {
+                strings.resize(id + 1);
+            }
+            strings[id].assign(text.begin(), text.end());
+        } else if (kind == MessageRecord) {
+            u64 timestamp;
+            Class log_class;
+            Level log_level;
+            u32 line, filename, function, format, size;
+            std::span<const u8> payload;
+            if (!read(timestamp) || !read(log_class) || !read(log_level) || !read(line) ||
+                !read(filename) || !read(function) || !read(format) || !read(size) ||
+                !read_bytes(size, payload)) {
+                break;
+            }
+            func(Entry{
+                .timestamp = std::chrono::microseconds{timestamp},
+                .log_class = log_class,
+                .log_level = log_level,
+                .filename = get_string(filename).c_str(),
+                .line_num = line,
+                .function = get_string(function),
+                .message = format == NoFormat
+                               ? std::string(payload.begin(), payload.end())
+                               : FormatDeferredMessage(get_string(format), payload),
+            });
+        } else {
+            failreason = "Corrupt record in binary log";
+            return false;
+        }
+    }
+    if (offset != data.size()) {
+        // A log cut short by a crash still decodes up to its last whole record.
+        failreason = "Binary log is truncated";
+        return false;
+    }
+    return true;
+}
+
+} // namespace Common::Log
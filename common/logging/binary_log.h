@@ -0,0 +1,51 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/io_file.h"
+#include "common/logging/log_ring.h"
+
+namespace Common::Log {
+
+struct Entry;
+
+/**
+ * Compact log file written by the "binary" log type, decoded offline with DecodeBinaryLog
+ * (`pkgtool log decode <file>`). Messages are stored unformatted, the format, file and function
+ * strings are written once and then referenced by id. Layout, host byte order:
+ *
+ *   "SPKGLOG" 0x01
+ *   u8 1: string    u32 id, u32 size, bytes
+ *   u8 2: message   u64 timestamp_us, u8 class, u8 level, u32 line, u32 file id,
+ *                   u32 function id, u32 format id (NoFormat: payload is the text),
+ *                   u32 payload size, payload
+ */
+class BinaryLogWriter {
+public:
+    explicit BinaryLogWriter(const std::filesystem::path& path);
+
+    /// Returns the number of bytes written.
+    size_t Write(const RingRecord& record, std::span<const u8> payload);
+    void Flush();
+
+private:
+    u32 GetStringId(const char* str);
+
+    Common::FS::IOFile file;
+    std::unordered_map<const char*, u32> string_ids;
+    std::vector<u8> scratch;
+};
+
+/// Calls `func` with every message of a binary log, in file order.
+bool DecodeBinaryLog(const std::filesystem::path& path, const std::function<void(const Entry&)>& func,
+                     std::string& failreason);
+
+} // namespace Common::Log
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <algorithm>
+#include <charconv>
 
 #include "common/assert.h"
 #include "common/logging/filter.h"
@@ -30,6 +31,37 @@ Class GetClassByName(const It begin, const It end) {
     return Class::Count;
 }
 
+bool ParseNumber(std::string_view text, u32& value) {
+    const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+    return ec == std::errc{} && ptr == text.data() + text.size();
+}
+
+bool IsLimitRule(std::string_view name) {
+    return name == "RateLimit" || name == "Sample";
+}
+
+// `RateLimit:<burst>/<per_second>` or `Sample:<n>`.
+bool ParseLimitRule(Filter& instance, std::string_view name, std::string_view value) {
+    if (name == "Sample") {
+        u32 n;
+        if (!ParseNumber(value, n)) {
+            LOG_ERROR(Log, "Invalid sample rate in filter: {}", value);
+            return false;
+        }
+        instance.SetSampleRate(n);
+        return true;
+    }
+    const size_t slash = value.find('/');
+    u32 burst, per_second;
+    if (slash == value.npos || !ParseNumber(value.substr(0, slash), burst) ||
+        !ParseNumber(value.substr(slash + 1), per_second)) {
+        LOG_ERROR(Log, "Invalid rate limit in filter, expected <burst>/<per_second>: {}", value);
+        return false;
+    }
+    instance.SetRateLimit(burst, per_second);
+    return true;
+}
+
 template <typename Iterator>
 bool ParseFilterRule(Filter& instance, Iterator begin, Iterator end) {
     auto level_separator = std::find(begin, end, ':');
@@ -39,6 +71,11 @@ bool ParseFilterRule(Filter& instance, Iterator begin, Iterator end) {
         return false;
     }
 
+    const std::string_view name(begin, level_separator);
+    if (IsLimitRule(name)) {
+        return ParseLimitRule(instance, name, std::string_view(level_separator + 1, end));
+    }
+
     const Level level = GetLevelByName(level_separator + 1, end);
     if (level == Level::Count) {
         LOG_ERROR(Log, "Unknown log level in filter: {}", std::string_view(begin, end));
@@ -211,6 +248,15 @@ void Filter::ParseFilterString(std::string_view filter_view) {
     }
 }
 
+void Filter::SetRateLimit(u32 burst, u32 per_second) {
+    rate_limit_burst = burst;
+    rate_limit_per_second = per_second;
+}
+
+void Filter::SetSampleRate(u32 n) {
+    sample_rate = n;
+}
+
 bool Filter::CheckMessage(Class log_class, Level level) const {
     return static_cast<u8>(level) >=
            static_cast<u8>(class_levels[static_cast<std::size_t>(log_class)]);
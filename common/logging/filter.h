@@ -50,6 +50,10 @@ public:
      *  - `*:Info` -- Resets the level of all classes to Info.
      *  - `Service:Info` -- Sets the level of Service to Info.
      *  - `Service.FS:Trace` -- Sets the level of the Service.FS class to Trace.
+     *
+     * Two more rules set the per call site limits:
+     *  - `RateLimit:<burst>/<per_second>` -- See SetRateLimit, `RateLimit:0/0` turns it off.
+     *  - `Sample:<n>` -- See SetSampleRate.
      */
     void ParseFilterString(std::string_view filter_view);
 
@@ -59,8 +63,38 @@ public:
     /// Returns true if any logging classes are set to debug
     bool IsDebug() const;
 
+    /**
+     * Limits each call site (file and line) to `burst` messages at once, refilled at
+     * `per_second` messages per second. What goes over is counted and reported as a single
+     * "suppressed" message once the site is allowed to log again. A `burst` of 0 turns it off.
+     */
+    void SetRateLimit(u32 burst, u32 per_second);
+
+    /// Keeps only one Trace or Debug message in `n` from each call site, 0 or 1 keeps them all.
+    void SetSampleRate(u32 n);
+
+    u32 GetRateLimitBurst() const {
+        return rate_limit_burst;
+    }
+
+    u32 GetRateLimitPerSecond() const {
+        return rate_limit_per_second;
+    }
+
+    u32 GetSampleRate() const {
+        return sample_rate;
+    }
+
+    /// True if messages that pass CheckMessage still go through the per call site limits.
+    bool HasSiteLimits() const {
+        return rate_limit_burst != 0 || sample_rate > 1;
+    }
+
 private:
     std::array<Level, static_cast<std::size_t>(Class::Count)> class_levels;
+    u32 rate_limit_burst = 0;
+    u32 rate_limit_per_second = 0;
+    u32 sample_rate = 0;
 };
 
 } // namespace Common::Log
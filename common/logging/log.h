@@ -5,9 +5,11 @@
 
 #include <algorithm>
 #include <array>
+#include <span>
 #include <string_view>
 
 #include "common/logging/formatter.h"
+#include "common/logging/log_args.h"
 #include "common/logging/types.h"
 
 namespace Common::Log {
@@ -27,9 +29,37 @@ void FmtLogMessageImpl(Class log_class, Level log_level, const char* filename,
                        unsigned int line_num, const char* function, const char* format,
                        const fmt::format_args& args);
 
+/// False when the logger is not initialized yet, the filter drops the message, or its call site
+/// is over the rate limit or sampled out.
+bool CheckLogMessage(Class log_class, Level log_level, const char* filename,
+                     unsigned int line_num, const char* function);
+
+/// True with the "binary" log type, messages are then formatted by the backend thread.
+bool IsDeferredLogging();
+
+/// Queues a message with arguments encoded by Deferred::EncodeArgs. `format` must outlive the
+/// logger, which string literals do.
+void PushDeferredLogMessage(Class log_class, Level log_level, const char* filename,
+                            unsigned int line_num, const char* function, const char* format,
+                            std::span<const u8> args);
+
 template <typename... Args>
 void FmtLogMessage(Class log_class, Level log_level, const char* filename, unsigned int line_num,
                    const char* function, const char* format, const Args&... args) {
+    if (!CheckLogMessage(log_class, log_level, filename, line_num, function)) {
+        return;
+    }
+    if constexpr ((Deferred::IsDeferrable<Args> && ...)) {
+        if (IsDeferredLogging()) {
+            std::array<u8, Deferred::MaxArgsSize> buffer;
+            size_t size;
+            if (Deferred::EncodeArgs(buffer, size, args...)) [[likely]] {
+                PushDeferredLogMessage(log_class, log_level, filename, line_num, function, format,
+                                       std::span(buffer).first(size));
+                return;
+            }
+        }
+    }
     FmtLogMessageImpl(log_class, log_level, filename, line_num, function, format,
                       fmt::make_format_args(args...));
 }
@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <fmt/args.h>
+
+#include "common/logging/log_args.h"
+
+namespace Common::Log {
+
+namespace {
+
+class ArgReader {
+public:
+    explicit ArgReader(std::span<const u8> data_) : data{data_} {}
+
+    bool Empty() const {
+        return offset == data.size();
+    }
+
+    template <typename T>
+    bool Read(T& value) {
+        if (sizeof(T) > data.size() - offset) {
+            return false;
+        }
+        std::memcpy(&value, data.data() + offset, sizeof(T));
+        offset += sizeof(T);
+        return true;
+    }
+
+    bool ReadString(std::string_view& value) {
+        u32 size;
+        if (!Read(size) || size > data.size() - offset) {
+            return false;
+        }
+        value = {reinterpret_cast<const char*>(data.data() + offset), size};
+        offset += size;
+        return true;
+    }
+
+private:
+    std::span<const u8> data;
+    size_t offset = 0;
+};
+
+template <typename T>
+bool PushArg(ArgReader& reader, fmt::dynamic_format_arg_store<fmt::format_context>& store) {
+    T value;
+    if (!reader.Read(value)) {
+        return false;
+    }
+    store.push_back(value);
+    return true;
+}
+
+bool PushArgs(std::span<const u8> args, fmt::dynamic_format_arg_store<fmt::format_context>& store) {
+    using Deferred::ArgType;
+    ArgReader reader{args};
+    while (!reader.Empty()) {
+        ArgType type;
+        if (!reader.Read(type)) {
+            return false;
+        }
+        bool ok = false;
+        switch (type) {
+        case ArgType::Bool: {
+            u8 value;
+            if ((ok = reader.Read(value))) {
+                store.push_back(value != 0);
+            }
+            break;
+        }
+        case ArgType::Char:
+            ok = PushArg<char>(reader, store);
+            break;
+        case ArgType::Int:
+            ok = PushArg<s32>(reader, store);
+            break;
+        case ArgType::UInt:
+            ok = PushArg<u32>(reader, store);
+            break;
+        case ArgType::LongLong:
+            ok = PushArg<s64>(reader, store);
+            break;
+        case ArgType::ULongLong:
+            ok = PushArg<u64>(reader, store);
+            break;
+        case ArgType::Float:
+            ok = PushArg<float>(reader, store);
+            break;
+        case ArgType::Double:
+            ok = PushArg<double>(reader, store);
+            break;
+        case ArgType::Pointer: {
+            u64 value;
+            if ((ok = reader.Read(value))) {
+                store.push_back(reinterpret_cast<const void*>(value));
+            }
+            break;
+        }
+        case ArgType::String: {
+            std::string_view value;
+            if ((ok = reader.ReadString(value))) {
+                store.push_back(value);
+            }
+            break;
+        }
+        }
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // Anonymous namespace
+
+std::string FormatDeferredMessage(std::string_view format, std::span<const u8> args) {
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    if (!PushArgs(args, store)) {
+        return std::string{format};
+    }
+    try {
+        return fmt::vformat(format, store);
+    } catch (const fmt::format_error&) {
+        return std::string{format};
+    }
+}
+
+} // namespace Common::Log
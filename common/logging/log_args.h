@@ -0,0 +1,153 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <cstring>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "common/logging/formatter.h"
+#include "common/types.h"
+
+/**
+ * Deferred formatting of log arguments. Instead of formatting on the logging thread, the
+ * arguments are copied as a compact tagged byte stream next to the format string pointer and
+ * the backend thread (or the offline decoder) rebuilds the message with FormatDeferredMessage.
+ *
+ * Only types whose formatting does not depend on anything but their value can be deferred:
+ * arithmetic types, void pointers and strings (copied). Any other argument makes the whole
+ * message fall back to formatting on the calling thread.
+ */
+namespace Common::Log::Deferred {
+
+enum class ArgType : u8 {
+    Bool,
+    Char,
+    Int,
+    UInt,
+    LongLong,
+    ULongLong,
+    Float,
+    Double,
+    Pointer,
+    String, ///< u32 length followed by the bytes
+};
+
+/// Encoded arguments above this size are formatted on the calling thread instead.
+constexpr size_t MaxArgsSize = 1024;
+
+template <typename T>
+constexpr bool IsStringArg =
+    std::is_same_v<T, const char*> || std::is_same_v<T, char*> ||
+    std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view> ||
+    std::is_same_v<T, fmt::UTF<std::string_view>> ||
+    (std::is_array_v<T> && std::is_same_v<std::remove_cv_t<std::remove_extent_t<T>>, char>);
+
+template <typename T>
+constexpr bool IsIntegerArg = std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                              !std::is_same_v<T, char> && !std::is_same_v<T, wchar_t> &&
+                              !std::is_same_v<T, char8_t> && !std::is_same_v<T, char16_t> &&
+                              !std::is_same_v<T, char32_t>;
+
+template <typename T>
+constexpr bool IsDeferrable =
+    IsStringArg<T> || IsIntegerArg<T> || std::is_same_v<T, bool> || std::is_same_v<T, char> ||
+    std::is_same_v<T, float> || std::is_same_v<T, double> || std::is_same_v<T, const void*> ||
+    std::is_same_v<T, void*>;
+
+template <typename T>
+std::string_view AsStringView(const T& value) {
+    if constexpr (std::is_same_v<T, fmt::UTF<std::string_view>>) {
+        return value.data;
+    } else if constexpr (std::is_pointer_v<T> || std::is_array_v<T>) {
+        const char* str = value;
+        return str ? std::string_view{str} : std::string_view{"(null)"};
+    } else {
+        return std::string_view{value};
+    }
+}
+
+class ArgWriter {
+public:
+    explicit ArgWriter(std::span<u8> buffer_) : buffer{buffer_} {}
+
+    template <typename T>
+    void Write(const T& value) {
+        if constexpr (IsStringArg<T>) {
+            const std::string_view str = AsStringView(value);
+            Put(ArgType::String, static_cast<u32>(str.size()));
+            PutBytes(str.data(), str.size());
+        } else if constexpr (std::is_same_v<T, bool>) {
+            Put(ArgType::Bool, static_cast<u8>(value));
+        } else if constexpr (std::is_same_v<T, char>) {
+            Put(ArgType::Char, value);
+        } else if constexpr (std::is_same_v<T, float>) {
+            Put(ArgType::Float, value);
+        } else if constexpr (std::is_same_v<T, double>) {
+            Put(ArgType::Double, value);
+        } else if constexpr (std::is_pointer_v<T>) {
+            Put(ArgType::Pointer, reinterpret_cast<u64>(value));
+        } else if constexpr (sizeof(T) <= sizeof(u32)) {
+            // fmt promotes the small integer types the same way.
+            if constexpr (std::is_signed_v<T>) {
+                Put(ArgType::Int, static_cast<s32>(value));
+            } else {
+                Put(ArgType::UInt, static_cast<u32>(value));
+            }
+        } else if constexpr (std::is_signed_v<T>) {
+            Put(ArgType::LongLong, static_cast<s64>(value));
+        } else {
+            Put(ArgType::ULongLong, static_cast<u64>(value));
+        }
+    }
+
+    size_t Size() const {
+        return size;
+    }
+
+    bool Overflowed() const {
+        return overflow;
+    }
+
+private:
+    template <typename T>
+    void Put(ArgType type, const T& value) {
+        PutBytes(&type, sizeof(type));
+        PutBytes(&value, sizeof(value));
+    }
+
+    void PutBytes(const void* data, size_t count) {
+        if (overflow || count > buffer.size() - size) {
+            overflow = true;
+            return;
+        }
+        std::memcpy(buffer.data() + size, data, count);
+        size += count;
+    }
+
+    std::span<u8> buffer;
+    size_t size = 0;
+    bool overflow = false;
+};
+
+/// Encodes `args` into `buffer`, false if they did not fit.
+template <typename... Args>
+bool EncodeArgs(std::span<u8> buffer, size_t& size, const Args&... args) {
+    ArgWriter writer{buffer};
+    (writer.Write(args), ...);
+    size = writer.Size();
+    return !writer.Overflowed();
+}
+
+} // namespace Common::Log::Deferred
+
+namespace Common::Log {
+
+/// Formats a message captured with Deferred::EncodeArgs. Malformed input never throws, the
+/// format string is returned as is.
+std::string FormatDeferredMessage(std::string_view format, std::span<const u8> args);
+
+} // namespace Common::Log
@@ -0,0 +1,129 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <thread>
+
+#include "common/alignment.h"
+#include "common/logging/types.h"
+
+namespace Common::Log {
+
+/// Header of a record in a LogRing, followed by `payload_size` bytes. With a null `format` the
+/// payload is the already formatted message, otherwise the Deferred-encoded arguments.
+struct RingRecord {
+    u32 size; ///< Whole record including padding, a multiple of 8.
+    u32 skip; ///< Non-zero for the filler written before wrapping around.
+    u64 timestamp_us;
+    const char* filename;
+    const char* function;
+    const char* format;
+    u32 line_num;
+    u32 payload_size;
+    Class log_class;
+    Level log_level;
+};
+
+/// What a producer does when its ring is full.
+enum class OverflowPolicy : u8 {
+    Block, ///< Yield until the backend thread made room, nothing is lost.
+    Drop,  ///< Drop the message and count it, logging never waits.
+};
+
+/**
+ * Single producer, single consumer ring of variable sized records. Each logging thread owns one
+ * so pushing a record is a couple of memcpy and one release store, with no lock and no
+ * allocation. Records never straddle the end of the buffer: when one does not fit, a filler
+ * record takes the rest of the buffer and the record starts again at offset 0.
+ */
+class LogRing {
+public:
+    static constexpr size_t Capacity = 256 * 1024;
+
+    /// False if the record was dropped: it can never fit, or the ring is full with
+    /// OverflowPolicy::Drop.
+    bool Push(const RingRecord& header, std::span<const u8> payload,
+              OverflowPolicy policy = OverflowPolicy::Block) {
+        const size_t size = Common::AlignUp(sizeof(RingRecord) + payload.size(), 8);
+        if (size > Capacity / 2) {
+            return false;
+        }
+        u64 h = head.load(std::memory_order_relaxed);
+        size_t offset = h % Capacity;
+        const size_t to_end = Capacity - offset;
+        const size_t needed = size <= to_end ? size : to_end + size;
+        while (Capacity - (h - tail.load(std::memory_order_acquire)) < needed) {
+            if (policy == OverflowPolicy::Drop) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            std::this_thread::yield();
+        }
+        if (size > to_end) {
+            // Only size and skip of the filler are ever read.
+            const u32 filler[2] = {static_cast<u32>(to_end), 1};
+            std::memcpy(buffer.get() + offset, filler, sizeof(filler));
+            h += to_end;
+            offset = 0;
+        }
+        RingRecord record = header;
+        record.size = static_cast<u32>(size);
+        record.skip = 0;
+        record.payload_size = static_cast<u32>(payload.size());
+        std::memcpy(buffer.get() + offset, &record, sizeof(record));
+        if (!payload.empty()) {
+            std::memcpy(buffer.get() + offset + sizeof(record), payload.data(), payload.size());
+        }
+        head.store(h + size, std::memory_order_release);
+        return true;
+    }
+
+    /// Position after the last record pushed so far, the `limit` of Front.
+    u64 Head() const {
+        return head.load(std::memory_order_acquire);
+    }
+
+    /// Reads the oldest record pushed before `limit` without consuming it, false if there is
+    /// none. The payload stays valid until Pop.
+    bool Front(u64 limit, RingRecord& record, std::span<const u8>& payload) {
+        u64 t = tail.load(std::memory_order_relaxed);
+        while (t < limit) {
+            const u8* data = buffer.get() + t % Capacity;
+            std::memcpy(&record, data, sizeof(u32) * 2);
+            if (record.skip == 0) {
+                std::memcpy(&record, data, sizeof(record));
+                payload = std::span<const u8>(data + sizeof(record), record.payload_size);
+                return true;
+            }
+            t += record.size;
+            tail.store(t, std::memory_order_release);
+        }
+        return false;
+    }
+
+    /// Consumes the record returned by the last Front.
+    void Pop(const RingRecord& record) {
+        tail.store(tail.load(std::memory_order_relaxed) + record.size, std::memory_order_release);
+    }
+
+    bool Empty() const {
+        return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+    }
+
+    /// Set when the owning thread exits, the ring is dropped once drained.
+    std::atomic<bool> closed{false};
+    /// Messages lost to OverflowPolicy::Drop, reset by the consumer when it reports them.
+    std::atomic<u64> dropped{0};
+
+private:
+    std::unique_ptr<u8[]> buffer{new u8[Capacity]};
+    alignas(64) std::atomic<u64> head{0};
+    alignas(64) std::atomic<u64> tail{0};
+};
+
+} // namespace Common::Log
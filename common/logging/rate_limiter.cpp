@@ -0,0 +1,101 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+
+#include "common/logging/filter.h"
+#include "common/logging/rate_limiter.h"
+
+namespace Common::Log {
+
+namespace {
+
+u64 SiteKey(const char* filename, u32 line_num) {
+    // splitmix64 finalizer, file name pointers share their low bits.
+    u64 x = reinterpret_cast<u64>(filename) ^ (u64{line_num} << 40);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    x ^= x >> 31;
+    return x | 1; // 0 marks a free slot
+}
+
+} // Anonymous namespace
+
+RateLimiter::Slot* RateLimiter::FindSlot(const Site& site) {
+    const u64 key = SiteKey(site.filename, site.line_num);
+    const auto matches = [&](const Slot& slot) {
+        return slot.site.filename == site.filename && slot.site.line_num == site.line_num;
+    };
+    for (size_t i = 0; i < MaxProbes; i++) {
+        Slot& slot = slots[(key + i) % NumSlots];
+        const u64 slot_key = slot.key.load(std::memory_order_acquire);
+        if (slot_key == key && matches(slot)) {
+            return &slot;
+        }
+        if (slot_key != 0) {
+            continue;
+        }
+        // First message from this site, claim the slot unless another thread just did.
+        std::scoped_lock lock{claim_mutex};
+        const u64 claimed = slot.key.load(std::memory_order_relaxed);
+        if (claimed == 0) {
+            slot.site = site;
+            slot.key.store(key, std::memory_order_release);
+            return &slot;
+        }
+        if (claimed == key && matches(slot)) {
+            return &slot;
+        }
+    }
+    return nullptr; // Too many sites in this part of the table, this one is not limited.
+}
+
+bool RateLimiter::Check(const Filter& filter, const Site& site, u64 now_us, u64& suppressed) {
+    suppressed = 0;
+    Slot* slot = FindSlot(site);
+    if (!slot) {
+        return true;
+    }
+
+    const u32 sample_rate = filter.GetSampleRate();
+    if (sample_rate > 1 && site.log_level <= Level::Debug &&
+        slot->sampled.fetch_add(1, std::memory_order_relaxed) % sample_rate != 0) {
+        return false;
+    }
+
+    const u32 burst = filter.GetRateLimitBurst();
+    if (burst != 0) {
+        const u64 interval = 1'000'000 / std::max(filter.GetRateLimitPerSecond(), 1U);
+        const u64 tolerance = interval * (burst - 1);
+        u64 tat = slot->tat.load(std::memory_order_relaxed);
+        u64 start;
+        do {
+            start = std::max(tat, now_us);
+            if (start - now_us > tolerance) {
+                slot->suppressed.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+        } while (!slot->tat.compare_exchange_weak(tat, start + interval,
+                                                  std::memory_order_relaxed));
+    }
+
+    // Plain load first, the exchange only happens right after a flood.
+    if (slot->suppressed.load(std::memory_order_relaxed) != 0) {
+        suppressed = slot->suppressed.exchange(0, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void RateLimiter::TakeSuppressed(
+    const std::function<void(const Site& site, u64 suppressed)>& func) {
+    for (Slot& slot : slots) {
+        if (slot.key.load(std::memory_order_acquire) == 0) {
+            continue;
+        }
+        if (const u64 count = slot.suppressed.exchange(0, std::memory_order_relaxed)) {
+            func(slot.site, count);
+        }
+    }
+}
+
+} // namespace Common::Log
@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <functional>
+#include <mutex>
+
+#include "common/logging/types.h"
+
+namespace Common::Log {
+
+class Filter;
+
+/**
+ * State of the per call site limits of Filter (SetRateLimit, SetSampleRate). Sites are kept in
+ * a fixed open addressing table keyed on the filename pointer and line, so checking a message
+ * is a hash, a load and, when rate limited, one compare-exchange. Only the first message of a
+ * site takes a lock, to claim its slot.
+ */
+class RateLimiter {
+public:
+    /// Where a message comes from and where its "suppressed" summary is reported.
+    struct Site {
+        const char* filename;
+        const char* function;
+        u32 line_num;
+        Class log_class;
+        Level log_level;
+    };
+
+    /**
+     * Returns true if the message may be logged. `now_us` is any monotonic clock in
+     * microseconds. On success `suppressed` is the number of messages the rate limit dropped at
+     * this site since the last one that passed, for the caller to report.
+     */
+    bool Check(const Filter& filter, const Site& site, u64 now_us, u64& suppressed);
+
+    /// Hands out the suppressed counts not reported yet, for the summary written at shutdown.
+    void TakeSuppressed(const std::function<void(const Site& site, u64 suppressed)>& func);
+
+private:
+    static constexpr size_t NumSlots = 1024;
+    static constexpr size_t MaxProbes = 16;
+
+    struct alignas(64) Slot {
+        std::atomic<u64> key{0}; ///< Published last, 0 while the slot is free
+        Site site{};
+        /// Token bucket kept as its theoretical arrival time (GCRA): the bucket is full when
+        /// `tat <= now`, and each message moves it one refill interval further.
+        std::atomic<u64> tat{0};
+        std::atomic<u64> sampled{0};
+        std::atomic<u64> suppressed{0};
+    };
+
+    Slot* FindSlot(const Site& site);
+
+    std::array<Slot, NumSlots> slots;
+    std::mutex claim_mutex;
+};
+
+} // namespace Common::Log
@@ -0,0 +1,293 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <utility>
+
+#include "common/error.h"
+#include "common/logging/log.h"
+#include "common/mapped_file.h"
+#include "common/path_util.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Common::FS {
+
+namespace {
+
+// Mapping offsets must be multiples of this.
+u64 GetMapGranularity() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwAllocationGranularity;
+#else
+    return static_cast<u64>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+u64 GetPageSize() {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwPageSize;
+#else
+    return static_cast<u64>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+std::string LastError() {
+#ifdef _WIN32
+    return Common::GetLastErrorMsg();
+#else
+    return std::error_code{errno, std::generic_category()}.message();
+#endif
+}
+
+} // Anonymous namespace
+
+MappedFile::MappedFile() = default;
+
+MappedFile::MappedFile(const std::filesystem::path& path, MapMode mode_, u64 offset_,
+                       u64 size_) {
+    Map(path, mode_, offset_, size_);
+}
+
+MappedFile::~MappedFile() {
+    Unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    std::swap(file_path, other.file_path);
+    std::swap(mode, other.mode);
+    std::swap(is_open, other.is_open);
+    std::swap(file_size, other.file_size);
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    std::swap(offset, other.offset);
+    std::swap(base, other.base);
+    std::swap(base_size, other.base_size);
+#ifdef _WIN32
+    std::swap(file_handle, other.file_handle);
+    std::swap(mapping_handle, other.mapping_handle);
+#else
+    std::swap(fd, other.fd);
+#endif
+    return *this;
+}
+
+bool MappedFile::Map(const std::filesystem::path& path, MapMode mode_, u64 offset_, u64 size_) {
+    Unmap();
+    file_path = path;
+    mode = mode_;
+
+#ifdef _WIN32
+    const DWORD access =
+        mode == MapMode::ReadWrite ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ;
+    const HANDLE file = CreateFileW(path.c_str(), access, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        LOG_ERROR(Common_Filesystem, "Failed to open the file at path={}, error_message={}",
+                  PathToUTF8String(path), LastError());
+        return false;
+    }
+    file_handle = file;
+    LARGE_INTEGER file_size_li;
+    GetFileSizeEx(file, &file_size_li);
+    file_size = static_cast<u64>(file_size_li.QuadPart);
+
+    // A mapping object can't be created for an empty file, an empty window needs none.
+    if (file_size != 0) {
+        const DWORD protect = mode == MapMode::ReadOnly    ? PAGE_READONLY
+                              : mode == MapMode::ReadWrite ? PAGE_READWRITE
+                                                           : PAGE_WRITECOPY;
+        mapping_handle = CreateFileMappingW(file, nullptr, protect, 0, 0, nullptr);
+        if (!mapping_handle) {
+            LOG_ERROR(Common_Filesystem, "Failed to map the file at path={}, error_message={}",
+                      PathToUTF8String(path), LastError());
+            CloseFile();
+            return false;
+        }
+    }
+#else
+    fd = open(path.c_str(), mode == MapMode::ReadWrite ? O_RDWR : O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        LOG_ERROR(Common_Filesystem, "Failed to open the file at path={}, error_message={}",
+                  PathToUTF8String(path), LastError());
+        CloseFile();
+        return false;
+    }
+    file_size = static_cast<u64>(st.st_size);
+#endif
+
+    is_open = true;
+    if (!MapWindow(offset_, size_)) {
+        Unmap();
+        return false;
+    }
+    return true;
+}
+
+bool MappedFile::Remap(u64 offset_, u64 size_) {
+    if (!is_open) {
+        return false;
+    }
+    UnmapWindow();
+    return MapWindow(offset_, size_);
+}
+
+bool MappedFile::MapWindow(u64 offset_, u64 size_) {
+    if (offset_ > file_size) {
+        LOG_ERROR(Common_Filesystem, "Mapping past the end of the file at path={}, offset={}",
+                  PathToUTF8String(file_path), offset_);
+        return false;
+    }
+    offset = offset_;
+    size = std::min(size_, file_size - offset_);
+    if (size == 0) {
+        return true;
+    }
+
+    const u64 base_offset = offset - offset % GetMapGranularity();
+    base_size = offset + size - base_offset;
+
+#ifdef _WIN32
+    const DWORD access = mode == MapMode::ReadOnly    ? FILE_MAP_READ
+                         : mode == MapMode::ReadWrite ? FILE_MAP_WRITE
+                                                      : FILE_MAP_COPY;
+    base = MapViewOfFile(mapping_handle, access, static_cast<DWORD>(base_offset >> 32),
+                         static_cast<DWORD>(base_offset), static_cast<SIZE_T>(base_size));
+#else
+    const int prot = mode == MapMode::ReadOnly ? PROT_READ : PROT_READ | PROT_WRITE;
+    const int flags = mode == MapMode::Private ? MAP_PRIVATE : MAP_SHARED;
+    base = mmap(nullptr, base_size, prot, flags, fd, static_cast<off_t>(base_offset));
+    if (base == MAP_FAILED) {
+        base = nullptr;
+    }
+#endif
+    if (!base) {
+        LOG_ERROR(Common_Filesystem,
+                  "Failed to map the file at path={}, offset={}, size={}, error_message={}",
+                  PathToUTF8String(file_path), offset, size, LastError());
+        base_size = 0;
+        size = 0;
+        return false;
+    }
+    data = static_cast<u8*>(base) + (offset - base_offset);
+    return true;
+}
+
+void MappedFile::UnmapWindow() {
+    if (base) {
+#ifdef _WIN32
+        UnmapViewOfFile(base);
+#else
+        munmap(base, base_size);
+#endif
+    }
+    base = nullptr;
+    base_size = 0;
+    data = nullptr;
+    size = 0;
+    offset = 0;
+}
+
+void MappedFile::CloseFile() {
+#ifdef _WIN32
+    if (mapping_handle) {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle) {
+        CloseHandle(file_handle);
+    }
+    mapping_handle = nullptr;
+    file_handle = nullptr;
+#else
+    if (fd >= 0) {
+        close(fd);
+    }
+    fd = -1;
+#endif
+}
+
+void MappedFile::Unmap() {
+    UnmapWindow();
+    CloseFile();
+    is_open = false;
+    file_size = 0;
+}
+
+void MappedFile::Advise(MapHint hint, u64 offset_, u64 size_) const {
+    if (!data || offset_ >= size) {
+        return;
+    }
+    size_ = std::min(size_, size - offset_);
+    // Hints work on whole pages.
+    const u64 page_size = GetPageSize();
+    u8* start = data + offset_;
+    const u64 misalign = reinterpret_cast<uintptr_t>(start) % page_size;
+    start -= misalign;
+    size_ += misalign;
+
+#ifdef _WIN32
+    if (hint == MapHint::WillNeed) {
+        WIN32_MEMORY_RANGE_ENTRY range{start, static_cast<SIZE_T>(size_)};
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    int advice = MADV_NORMAL;
+    switch (hint) {
+    case MapHint::Normal:
+        advice = MADV_NORMAL;
+        break;
+    case MapHint::Sequential:
+        advice = MADV_SEQUENTIAL;
+        break;
+    case MapHint::Random:
+        advice = MADV_RANDOM;
+        break;
+    case MapHint::WillNeed:
+        advice = MADV_WILLNEED;
+        break;
+    case MapHint::HugePage:
+#ifdef MADV_HUGEPAGE
+        advice = MADV_HUGEPAGE;
+        break;
+#else
+        return;
+#endif
+    }
+    madvise(start, size_, advice);
+#endif
+}
+
+bool MappedFile::Flush() const {
+    if (!data || mode != MapMode::ReadWrite) {
+        return true;
+    }
+#ifdef _WIN32
+    const bool result = FlushViewOfFile(base, static_cast<SIZE_T>(base_size)) != 0;
+#else
+    const bool result = msync(base, base_size, MS_SYNC) == 0;
+#endif
+    if (!result) {
+        LOG_ERROR(Common_Filesystem, "Failed to flush the mapping of path={}, error_message={}",
+                  PathToUTF8String(file_path), LastError());
+    }
+    return result;
+}
+
+} // namespace Common::FS
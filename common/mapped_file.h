@@ -0,0 +1,119 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <limits>
+#include <span>
+
+#include "common/types.h"
+
+namespace Common::FS {
+
+enum class MapMode {
+    ReadOnly,  // Pages can only be read.
+    ReadWrite, // Writes go to the file.
+    Private,   // Writable, writes stay in this process (copy on write), the file is untouched.
+};
+
+enum class MapHint {
+    Normal,     // Default read-ahead.
+    Sequential, // Read front to back, aggressive read-ahead and pages dropped behind.
+    Random,     // Scattered small reads, no read-ahead.
+    WillNeed,   // Start reading the range in now (prefetch).
+    HugePage,   // Back the range with huge pages where the system allows it.
+};
+
+/**
+ * A memory-mapped window of a file. Maps the whole file by default, or any range of it so huge
+ * files can be walked a window at a time. The offset does not have to be aligned, the mapping
+ * is rounded out internally and Span() starts exactly at the requested byte.
+ */
+class MappedFile final {
+public:
+    static constexpr u64 WholeFile = std::numeric_limits<u64>::max();
+
+    MappedFile();
+    explicit MappedFile(const std::filesystem::path& path, MapMode mode = MapMode::ReadOnly,
+                        u64 offset = 0, u64 size = WholeFile);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /// Maps [offset, offset + size) of `path`, clamped to the end of the file. False (and
+    /// logged) when the file can't be opened or mapped, or `offset` is past its end.
+    bool Map(const std::filesystem::path& path, MapMode mode = MapMode::ReadOnly, u64 offset = 0,
+             u64 size = WholeFile);
+
+    /// Moves the window to another range of the same file, keeping the file open.
+    bool Remap(u64 offset, u64 size = WholeFile);
+
+    void Unmap();
+
+    bool IsMapped() const {
+        return is_open;
+    }
+
+    std::span<const u8> Span() const {
+        return {data, size};
+    }
+
+    /// Empty with MapMode::ReadOnly.
+    std::span<u8> WritableSpan() const {
+        return mode == MapMode::ReadOnly ? std::span<u8>{} : std::span<u8>{data, size};
+    }
+
+    const u8* Data() const {
+        return data;
+    }
+
+    u64 Size() const {
+        return size;
+    }
+
+    /// File offset of Span()[0].
+    u64 Offset() const {
+        return offset;
+    }
+
+    u64 GetFileSize() const {
+        return file_size;
+    }
+
+    /// Hints the kernel about how [offset, offset + size) of the window is going to be used.
+    /// Offsets are relative to Span(). Hints are advisory, unsupported ones are ignored.
+    void Advise(MapHint hint, u64 offset = 0, u64 size = WholeFile) const;
+
+    /// Writes dirty pages of a MapMode::ReadWrite window back to the file.
+    bool Flush() const;
+
+private:
+    bool MapWindow(u64 offset, u64 size);
+    void UnmapWindow();
+    void CloseFile();
+
+    std::filesystem::path file_path;
+    MapMode mode{};
+    bool is_open = false;
+    u64 file_size = 0;
+
+    u8* data = nullptr; // Span() start, inside the mapping
+    u64 size = 0;
+    u64 offset = 0;
+    void* base = nullptr; // Start of the mapping, aligned down to the allocation granularity
+    u64 base_size = 0;
+
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+} // namespace Common::FS
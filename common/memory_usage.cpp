@@ -0,0 +1,77 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include "common/memory_usage.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Common {
+
+u64 GetPeakResidentSetSize() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<u64>(usage.ru_maxrss); // bytes
+#else
+    return static_cast<u64>(usage.ru_maxrss) * 1024; // KiB
+#endif
+#endif
+}
+
+u64 GetPageCacheSize(const std::filesystem::path& path) {
+#ifdef _WIN32
+    return 0;
+#else
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return 0;
+    }
+    // Mapping the file doesn't fault anything in, mincore then reports the cached pages.
+    const size_t size = static_cast<size_t>(st.st_size);
+    void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return 0;
+    }
+    const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#ifdef __APPLE__
+    std::vector<char> pages((size + page_size - 1) / page_size);
+#else
+    std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+#endif
+    u64 cached = 0;
+    if (mincore(data, size, pages.data()) == 0) {
+        for (const auto page : pages) {
+            cached += (page & 1) ? page_size : 0;
+        }
+    }
+    munmap(data, size);
+    return cached;
+#endif
+}
+
+} // namespace Common
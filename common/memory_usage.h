@@ -0,0 +1,19 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+
+#include "common/types.h"
+
+namespace Common {
+
+/// Returns the peak resident set size of the process in bytes, 0 when it is not available.
+u64 GetPeakResidentSetSize();
+
+/// Returns how many bytes of the file at `path` are in the page cache, 0 when it is not
+/// available.
+u64 GetPageCacheSize(const std::filesystem::path& path);
+
+} // namespace Common
@@ -0,0 +1,57 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace Common {
+
+/// Returns how many threads should work on `count` independent items, capped by `max_threads`
+/// (0 means no cap other than the hardware concurrency).
+inline std::size_t GetWorkerCount(std::size_t count, std::size_t max_threads = 0) {
+    std::size_t threads = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    if (max_threads != 0) {
+        threads = std::min(threads, max_threads);
+    }
+    return std::max<std::size_t>(1, std::min(threads, count));
+}
+
+/**
+ * Calls `func(index)` for every index in [0, count) using up to `max_threads` threads.
+ * Indices are handed out one at a time so a few expensive items don't stall a whole batch.
+ * The calling thread takes part in the work and the call returns once every item is done.
+ */
+template <typename Func>
+void ParallelFor(std::size_t count, Func&& func, std::size_t max_threads = 0) {
+    if (count == 0) {
+        return;
+    }
+    const std::size_t num_threads = GetWorkerCount(count, max_threads);
+    if (num_threads == 1) {
+        for (std::size_t i = 0; i < count; ++i) {
+            func(i);
+        }
+        return;
+    }
+
+    std::atomic<std::size_t> next{0};
+    const auto worker = [&] {
+        for (std::size_t i = next++; i < count; i = next++) {
+            func(i);
+        }
+    };
+
+    std::vector<std::jthread> threads;
+    threads.reserve(num_threads - 1);
+    for (std::size_t t = 1; t < num_threads; ++t) {
+        threads.emplace_back(worker);
+    }
+    worker();
+}
+
+} // namespace Common
@@ -41,6 +41,56 @@ std::string_view U8stringToString(std::u8string_view u8str) {
     return std::string_view{reinterpret_cast<const char*>(u8str.data()), u8str.size()};
 }
 
+std::string EscapeJsonString(std::string_view str) {
+    std::string output;
+    output.reserve(str.size());
+    for (const char c : str) {
+        switch (c) {
+        case '"':
+            output += "\\\"";
+            break;
+        case '\\':
+            output += "\\\\";
+            break;
+        case '\n':
+            output += "\\n";
+            break;
+        case '\r':
+            output += "\\r";
+            break;
+        case '\t':
+            output += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                static constexpr char hex[] = "0123456789abcdef";
+                output += "\\u00";
+                output += hex[(c >> 4) & 0xF];
+                output += hex[c & 0xF];
+            } else {
+                output += c;
+            }
+            break;
+        }
+    }
+    return output;
+}
+
+std::string EscapeCsvField(std::string_view str) {
+    if (str.find_first_of(",\"\r\n") == std::string_view::npos) {
+        return std::string{str};
+    }
+    std::string output{"\""};
+    for (const char c : str) {
+        if (c == '"') {
+            output += '"';
+        }
+        output += c;
+    }
+    output += '"';
+    return output;
+}
+
 #ifdef _WIN32
 static std::wstring CPToUTF16(u32 code_page, std::string_view input) {
     const auto size =
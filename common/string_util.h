@@ -18,6 +18,12 @@ std::vector<std::string> SplitString(const std::string& str, char delimiter);
 
 std::string_view U8stringToString(std::u8string_view u8str);
 
+/// Escapes a string so it can be embedded between double quotes in a JSON document
+[[nodiscard]] std::string EscapeJsonString(std::string_view str);
+
+/// Quotes a CSV field if it contains separators, quotes or line breaks
+[[nodiscard]] std::string EscapeCsvField(std::string_view str);
+
 #ifdef _WIN32
 [[nodiscard]] std::string UTF16ToUTF8(std::wstring_view input);
 [[nodiscard]] std::wstring UTF8ToUTF16W(std::string_view str);
@@ -1,8 +1,12 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
 #include <array>
+#include <cstring>
 
+#include "common/parallel_for.h"
+#include "core/crypto/crypto_backend.h"
 #include "crypto.h"
 
 CryptoPP::RSA::PrivateKey Crypto::key_pkg_derived_key3_keyset_init() {
@@ -69,147 +73,80 @@ CryptoPP::RSA::PrivateKey Crypto::DebugRifKeyset_init() {
     return privateKey;
 }
 
+// The primitives themselves live in the selected CryptoBackend, this class only lays out the
+// PKG specific inputs.
+
 void Crypto::RSA2048Decrypt(std::span<CryptoPP::byte, 32> dec_key,
                             std::span<const CryptoPP::byte, 256> ciphertext,
                             bool is_dk3) { // RSAES_PKCS1v15_
-    // Create an RSA decryptor
-    CryptoPP::RSA::PrivateKey privateKey;
-    if (is_dk3) {
-        privateKey = key_pkg_derived_key3_keyset_init();
-    } else {
-        privateKey = FakeKeyset_keyset_init();
-    }
-
-    CryptoPP::RSAES_PKCS1v15_Decryptor rsaDecryptor(privateKey);
-
-    // Allocate memory for the decrypted data
-    std::array<CryptoPP::byte, 256> decrypted;
-
-    // Perform the decryption
-    CryptoPP::AutoSeededRandomPool rng;
-    CryptoPP::DecodingResult result =
-        rsaDecryptor.Decrypt(rng, ciphertext.data(), decrypted.size(), decrypted.data());
-    std::copy(decrypted.begin(), decrypted.begin() + dec_key.size(), dec_key.begin());
+    GetCryptoBackend().RsaDecrypt(is_dk3, ciphertext, dec_key);
+}
+
+void Crypto::RSA2048DecryptBatch(std::span<const std::array<CryptoPP::byte, 256>> ciphertexts,
+                                 std::span<std::array<CryptoPP::byte, 32>> dec_keys, bool is_dk3,
+                                 size_t max_threads) {
+    const size_t count = std::min(ciphertexts.size(), dec_keys.size());
+    Common::ParallelFor(
+        count, [&](size_t i) { RSA2048Decrypt(dec_keys[i], ciphertexts[i], is_dk3); },
+        max_threads);
 }
 
 void Crypto::ivKeyHASH256(std::span<const CryptoPP::byte, 64> cipher_input,
                           std::span<CryptoPP::byte, 32> ivkey_result) {
-    CryptoPP::SHA256 sha256;
-    std::array<CryptoPP::byte, CryptoPP::SHA256::DIGESTSIZE> hashResult;
-    auto array_sink = new CryptoPP::ArraySink(hashResult.data(), CryptoPP::SHA256::DIGESTSIZE);
-    auto filter = new CryptoPP::HashFilter(sha256, array_sink);
-    CryptoPP::ArraySource r(cipher_input.data(), cipher_input.size(), true, filter);
-    std::copy(hashResult.begin(), hashResult.begin() + ivkey_result.size(), ivkey_result.begin());
+    GetCryptoBackend().Sha256(cipher_input, ivkey_result);
 }
 
 void Crypto::aesCbcCfb128Decrypt(std::span<const CryptoPP::byte, 32> ivkey,
                                  std::span<const CryptoPP::byte, 256> ciphertext,
                                  std::span<CryptoPP::byte, 256> decrypted) {
-    std::array<CryptoPP::byte, CryptoPP::AES::DEFAULT_KEYLENGTH> key;
-    std::array<CryptoPP::byte, CryptoPP::AES::DEFAULT_KEYLENGTH> iv;
-
-    std::copy(ivkey.begin() + 16, ivkey.begin() + 16 + key.size(), key.begin());
-    std::copy(ivkey.begin(), ivkey.begin() + iv.size(), iv.begin());
-
-    CryptoPP::AES::Decryption aesDecryption(key.data(), CryptoPP::AES::DEFAULT_KEYLENGTH);
-    CryptoPP::CBC_Mode_ExternalCipher::Decryption cbcDecryption(aesDecryption, iv.data());
-
-    for (size_t i = 0; i < decrypted.size(); i += CryptoPP::AES::BLOCKSIZE) {
-        cbcDecryption.ProcessData(decrypted.data() + i, ciphertext.data() + i,
-                                  CryptoPP::AES::BLOCKSIZE);
-    }
+    // The first half of ivkey is the IV, the second half the key.
+    GetCryptoBackend().AesCbcDecrypt(ivkey.subspan<16, 16>(), ivkey.subspan<0, 16>(), ciphertext,
+                                     decrypted);
 }
 
 void Crypto::aesCbcCfb128DecryptEntry(std::span<const CryptoPP::byte, 32> ivkey,
                                       std::span<CryptoPP::byte> ciphertext,
                                       std::span<CryptoPP::byte> decrypted) {
-    std::array<CryptoPP::byte, CryptoPP::AES::DEFAULT_KEYLENGTH> key;
-    std::array<CryptoPP::byte, CryptoPP::AES::DEFAULT_KEYLENGTH> iv;
-
-    std::copy(ivkey.begin() + 16, ivkey.begin() + 16 + key.size(), key.begin());
-    std::copy(ivkey.begin(), ivkey.begin() + iv.size(), iv.begin());
-
-    CryptoPP::AES::Decryption aesDecryption(key.data(), CryptoPP::AES::DEFAULT_KEYLENGTH);
-    CryptoPP::CBC_Mode_ExternalCipher::Decryption cbcDecryption(aesDecryption, iv.data());
-
-    for (size_t i = 0; i < decrypted.size(); i += CryptoPP::AES::BLOCKSIZE) {
-        cbcDecryption.ProcessData(decrypted.data() + i, ciphertext.data() + i,
-                                  CryptoPP::AES::BLOCKSIZE);
-    }
+    // Trailing bytes that do not fill a block are left alone.
+    const size_t size = std::min(ciphertext.size(), decrypted.size()) & ~size_t{15};
+    GetCryptoBackend().AesCbcDecrypt(ivkey.subspan<16, 16>(), ivkey.subspan<0, 16>(),
+                                     ciphertext.first(size), decrypted.first(size));
 }
 
 void Crypto::decryptEFSM(std::span<CryptoPP::byte, 16> trophyKey,
                          std::span<CryptoPP::byte, 16> NPcommID,
                          std::span<CryptoPP::byte, 16> efsmIv, std::span<CryptoPP::byte> ciphertext,
                          std::span<CryptoPP::byte> decrypted) {
+    CryptoBackend& backend = GetCryptoBackend();
 
     // step 1: Encrypt NPcommID
-    CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption encrypt;
-
-    std::vector<CryptoPP::byte> trophyIv(16, 0);
-    std::vector<CryptoPP::byte> trpKey(16);
-
-    encrypt.SetKeyWithIV(trophyKey.data(), trophyKey.size(), trophyIv.data());
-    encrypt.ProcessData(trpKey.data(), NPcommID.data(), 16);
+    static constexpr std::array<CryptoPP::byte, 16> trophyIv{};
+    std::array<CryptoPP::byte, 16> trpKey;
+    backend.AesCbcEncrypt(trophyKey, trophyIv, NPcommID, trpKey);
 
     // step 2: decrypt efsm.
-    CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decrypt;
-    decrypt.SetKeyWithIV(trpKey.data(), trpKey.size(), efsmIv.data());
-
-    for (size_t i = 0; i < decrypted.size(); i += CryptoPP::AES::BLOCKSIZE) {
-        decrypt.ProcessData(decrypted.data() + i, ciphertext.data() + i, CryptoPP::AES::BLOCKSIZE);
-    }
+    const size_t size = std::min(ciphertext.size(), decrypted.size()) & ~size_t{15};
+    backend.AesCbcDecrypt(trpKey, efsmIv, ciphertext.first(size), decrypted.first(size));
 }
 
 void Crypto::PfsGenCryptoKey(std::span<const CryptoPP::byte, 32> ekpfs,
                              std::span<const CryptoPP::byte, 16> seed,
                              std::span<CryptoPP::byte, 16> dataKey,
                              std::span<CryptoPP::byte, 16> tweakKey) {
-    CryptoPP::HMAC<CryptoPP::SHA256> hmac(ekpfs.data(), ekpfs.size());
-
-    CryptoPP::SecByteBlock d(20); // Use Crypto++ SecByteBlock for better memory management
-
-    // Copy the bytes of 'index' to the 'd' array
-    uint32_t index = 1;
-    std::memcpy(d, &index, sizeof(uint32_t));
-
-    // Copy the bytes of 'seed' to the 'd' array starting from index 4
-    std::memcpy(d + sizeof(uint32_t), seed.data(), seed.size());
-
-    // Allocate memory for 'u64' using new
-    std::vector<CryptoPP::byte> data_tweak_key(hmac.DigestSize());
-
-    // Calculate the HMAC
-    hmac.CalculateDigest(data_tweak_key.data(), d, d.size());
-    std::copy(data_tweak_key.begin(), data_tweak_key.begin() + dataKey.size(), tweakKey.begin());
-    std::copy(data_tweak_key.begin() + tweakKey.size(),
-              data_tweak_key.begin() + tweakKey.size() + dataKey.size(), dataKey.begin());
+    // HMAC-SHA256(ekpfs, index || seed) with index = 1.
+    std::array<CryptoPP::byte, 20> d;
+    const u32 index = 1;
+    std::memcpy(d.data(), &index, sizeof(u32));
+    std::memcpy(d.data() + sizeof(u32), seed.data(), seed.size());
+
+    std::array<CryptoPP::byte, 32> data_tweak_key;
+    GetCryptoBackend().HmacSha256(ekpfs, d, data_tweak_key);
+    std::copy_n(data_tweak_key.begin(), tweakKey.size(), tweakKey.begin());
+    std::copy_n(data_tweak_key.begin() + tweakKey.size(), dataKey.size(), dataKey.begin());
 }
 
 void Crypto::decryptPFS(std::span<const CryptoPP::byte, 16> dataKey,
                         std::span<const CryptoPP::byte, 16> tweakKey, std::span<const u8> src_image,
                         std::span<CryptoPP::byte> dst_image, u64 sector) {
-    // Start at 0x10000 to keep the header when decrypting the whole pfs_image.
-    for (int i = 0; i < src_image.size(); i += 0x1000) {
-        const u64 current_sector = sector + (i / 0x1000);
-        CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption encrypt(tweakKey.data(), tweakKey.size());
-        CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption decrypt(dataKey.data(), dataKey.size());
-
-        std::array<CryptoPP::byte, 16> tweak{};
-        std::array<CryptoPP::byte, 16> encryptedTweak;
-        std::array<CryptoPP::byte, 16> xorBuffer;
-        std::memcpy(tweak.data(), &current_sector, sizeof(u64));
-
-        // Encrypt the tweak for each sector.
-        encrypt.ProcessData(encryptedTweak.data(), tweak.data(), 16);
-
-        for (int plaintextOffset = 0; plaintextOffset < 0x1000; plaintextOffset += 16) {
-            xtsXorBlock(xorBuffer.data(), src_image.data() + i + plaintextOffset,
-                        encryptedTweak.data());                          // x, c, t
-            decrypt.ProcessData(xorBuffer.data(), xorBuffer.data(), 16); // x, x
-            xtsXorBlock(dst_image.data() + i + plaintextOffset, xorBuffer.data(),
-                        encryptedTweak.data()); //(p)  c, x , t
-            xtsMult(encryptedTweak);
-        }
-    }
+    GetCryptoBackend().AesXtsDecrypt(dataKey, tweakKey, src_image, dst_image, sector);
 }
@@ -3,6 +3,7 @@
 
 #pragma once
 
+#include <array>
 #include <span>
 #include <cryptopp/aes.h>
 #include <cryptopp/filters.h>
@@ -24,6 +25,10 @@ public:
     void RSA2048Decrypt(std::span<CryptoPP::byte, 32> dk3,
                         std::span<const CryptoPP::byte, 256> ciphertext,
                         bool is_dk3); // RSAES_PKCS1v15_
+    // Decrypts many DK3 (is_dk3) or EKPFS blobs at once, spread over up to max_threads threads.
+    void RSA2048DecryptBatch(std::span<const std::array<CryptoPP::byte, 256>> ciphertexts,
+                             std::span<std::array<CryptoPP::byte, 32>> dec_keys, bool is_dk3,
+                             size_t max_threads = 0);
     void ivKeyHASH256(std::span<const CryptoPP::byte, 64> cipher_input,
                       std::span<CryptoPP::byte, 32> ivkey_result);
     void aesCbcCfb128Decrypt(std::span<const CryptoPP::byte, 32> ivkey,
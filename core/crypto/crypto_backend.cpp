@@ -0,0 +1,47 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <atomic>
+
+#include "core/crypto/crypto_backend.h"
+
+namespace {
+
+CryptoBackend* GetDefaultBackend() {
+#ifdef ENABLE_OPENSSL
+    return &GetOpenSSLBackend();
+#else
+    return &GetCryptoPPBackend();
+#endif
+}
+
+std::atomic<CryptoBackend*> current_backend{nullptr};
+
+} // Anonymous namespace
+
+CryptoBackend& GetCryptoBackend() {
+    CryptoBackend* backend = current_backend.load(std::memory_order_acquire);
+    if (!backend) {
+        backend = GetDefaultBackend();
+        current_backend.store(backend, std::memory_order_release);
+    }
+    return *backend;
+}
+
+bool SetCryptoBackend(std::string_view name) {
+    for (CryptoBackend* backend : GetCryptoBackends()) {
+        if (backend->GetName() == name) {
+            current_backend.store(backend, std::memory_order_release);
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<CryptoBackend*> GetCryptoBackends() {
+    std::vector<CryptoBackend*> backends{&GetCryptoPPBackend()};
+#ifdef ENABLE_OPENSSL
+    backends.push_back(&GetOpenSSLBackend());
+#endif
+    return backends;
+}
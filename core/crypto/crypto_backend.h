@@ -0,0 +1,58 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <span>
+#include <string_view>
+#include <vector>
+#include "common/types.h"
+
+/**
+ * The primitives behind Crypto. Every backend produces the same bytes for the same input, they
+ * only differ in speed; `pkgtool bench crypto` checks both.
+ *
+ * Implementations must be safe to call from several threads at once.
+ */
+class CryptoBackend {
+public:
+    virtual ~CryptoBackend() = default;
+
+    virtual std::string_view GetName() const = 0;
+
+    virtual void Sha256(std::span<const u8> data, std::span<u8, 32> digest) = 0;
+    virtual void HmacSha256(std::span<const u8> key, std::span<const u8> data,
+                            std::span<u8, 32> digest) = 0;
+
+    /// AES-128-CBC without padding, `src` is a multiple of 16 bytes and may alias `dst`.
+    virtual void AesCbcEncrypt(std::span<const u8, 16> key, std::span<const u8, 16> iv,
+                               std::span<const u8> src, std::span<u8> dst) = 0;
+    virtual void AesCbcDecrypt(std::span<const u8, 16> key, std::span<const u8, 16> iv,
+                               std::span<const u8> src, std::span<u8> dst) = 0;
+
+    /// AES-128-XTS over 0x1000 byte sectors, the first one being `sector`. The tweak of a sector
+    /// is its number as a little-endian 128 bit value. `src` may alias `dst`, a trailing partial
+    /// sector is left untouched. Sectors are independent, so implementations are expected to
+    /// decrypt several of them interleaved; callers should pass whole runs rather than looping.
+    virtual void AesXtsDecrypt(std::span<const u8, 16> data_key, std::span<const u8, 16> tweak_key,
+                               std::span<const u8> src, std::span<u8> dst, u64 sector) = 0;
+
+    /// RSAES-PKCS1-v1_5 with the PKG derived key 3 keyset (is_dk3) or the fake keyset, the first
+    /// 32 bytes of the message end up in `out`.
+    virtual void RsaDecrypt(bool is_dk3, std::span<const u8, 256> ciphertext,
+                            std::span<u8, 32> out) = 0;
+};
+
+/// Backend used by Crypto. Defaults to the fastest one compiled in.
+CryptoBackend& GetCryptoBackend();
+
+/// Switches the backend used from now on, false if `name` is not compiled in.
+bool SetCryptoBackend(std::string_view name);
+
+/// Every backend compiled in, the reference (Crypto++) first.
+std::vector<CryptoBackend*> GetCryptoBackends();
+
+CryptoBackend& GetCryptoPPBackend();
+#ifdef ENABLE_OPENSSL
+CryptoBackend& GetOpenSSLBackend();
+#endif
@@ -0,0 +1,161 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cryptopp/aes.h>
+#include <cryptopp/hmac.h>
+#include <cryptopp/modes.h>
+#include <cryptopp/osrng.h>
+#include <cryptopp/rsa.h>
+#include <cryptopp/sha.h>
+
+#include "core/crypto/crypto.h"
+#include "core/crypto/crypto_backend.h"
+
+namespace {
+
+// Building the keys from the big-endian tables is the expensive part of a decryption, so each
+// keyset is converted once per process. The decryptor uses the CRT parameters of the key.
+const CryptoPP::RSA::PrivateKey& GetCachedKey(bool is_dk3) {
+    static const CryptoPP::RSA::PrivateKey dk3_key = Crypto{}.key_pkg_derived_key3_keyset_init();
+    static const CryptoPP::RSA::PrivateKey fake_key = Crypto{}.FakeKeyset_keyset_init();
+    return is_dk3 ? dk3_key : fake_key;
+}
+
+// Decryptors and the blinding RNG are not safe to share between threads, each thread seeds its
+// own pool once and keeps it around.
+struct RSAThreadState {
+    CryptoPP::AutoSeededRandomPool rng;
+    CryptoPP::RSAES_PKCS1v15_Decryptor dk3{GetCachedKey(true)};
+    CryptoPP::RSAES_PKCS1v15_Decryptor fake{GetCachedKey(false)};
+};
+
+RSAThreadState& GetRSAThreadState() {
+    thread_local RSAThreadState state;
+    return state;
+}
+
+constexpr size_t XtsSectorSize = 0x1000;
+constexpr size_t XtsBlocksPerSector = XtsSectorSize / 16;
+
+// Number of sectors decrypted together. The tweak stream of a batch (64 KiB) stays in L2 and the
+// AES calls get long runs of independent blocks, which Crypto++ pipelines (AES-NI/ARMv8 AES).
+constexpr size_t XtsBatchSectors = 16;
+
+struct XtsTweak {
+    u64 lo;
+    u64 hi;
+};
+
+// Multiplies the tweak by x in GF(2^128), little-endian as XTS wants it.
+XtsTweak MultiplyTweak(XtsTweak tweak) {
+    const u64 carry = tweak.hi >> 63;
+    tweak.hi = (tweak.hi << 1) | (tweak.lo >> 63);
+    tweak.lo = (tweak.lo << 1) ^ (carry * 0x87);
+    return tweak;
+}
+
+void XorTweaks(u8* dst, const u8* src, const XtsTweak* tweaks, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        u64 block[2];
+        std::memcpy(block, src + i * 16, 16);
+        block[0] ^= tweaks[i].lo;
+        block[1] ^= tweaks[i].hi;
+        std::memcpy(dst + i * 16, block, 16);
+    }
+}
+
+/**
+ * Decrypts `count` (up to XtsBatchSectors) consecutive sectors starting at `sector`. Instead of
+ * walking one sector 16 bytes at a time, the initial tweaks of every sector are encrypted in a
+ * single call, expanded into the full tweak stream, and the whole batch goes through the block
+ * cipher at once: dst = D(src ^ T) ^ T.
+ */
+void DecryptXtsBatch(CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption& tweak_cipher,
+                     CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption& data_cipher, const u8* src,
+                     u8* dst, u64 sector, size_t count) {
+    thread_local std::array<XtsTweak, XtsBatchSectors * XtsBlocksPerSector> tweaks;
+
+    std::array<XtsTweak, XtsBatchSectors> initial{};
+    for (size_t i = 0; i < count; i++) {
+        initial[i].lo = sector + i;
+    }
+    auto* initial_bytes = reinterpret_cast<u8*>(initial.data());
+    tweak_cipher.ProcessData(initial_bytes, initial_bytes, count * 16);
+
+    for (size_t i = 0; i < count; i++) {
+        XtsTweak* stream = tweaks.data() + i * XtsBlocksPerSector;
+        stream[0] = initial[i];
+        for (size_t j = 1; j < XtsBlocksPerSector; j++) {
+            stream[j] = MultiplyTweak(stream[j - 1]);
+        }
+    }
+
+    const size_t blocks = count * XtsBlocksPerSector;
+    XorTweaks(dst, src, tweaks.data(), blocks);
+    data_cipher.ProcessData(dst, dst, blocks * 16);
+    XorTweaks(dst, dst, tweaks.data(), blocks);
+}
+
+class CryptoPPBackend final : public CryptoBackend {
+public:
+    std::string_view GetName() const override {
+        return "cryptopp";
+    }
+
+    void Sha256(std::span<const u8> data, std::span<u8, 32> digest) override {
+        CryptoPP::SHA256().CalculateDigest(digest.data(), data.data(), data.size());
+    }
+
+    void HmacSha256(std::span<const u8> key, std::span<const u8> data,
+                    std::span<u8, 32> digest) override {
+        CryptoPP::HMAC<CryptoPP::SHA256> hmac(key.data(), key.size());
+        hmac.CalculateDigest(digest.data(), data.data(), data.size());
+    }
+
+    void AesCbcEncrypt(std::span<const u8, 16> key, std::span<const u8, 16> iv,
+                       std::span<const u8> src, std::span<u8> dst) override {
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption encrypt;
+        encrypt.SetKeyWithIV(key.data(), key.size(), iv.data());
+        encrypt.ProcessData(dst.data(), src.data(), src.size());
+    }
+
+    void AesCbcDecrypt(std::span<const u8, 16> key, std::span<const u8, 16> iv,
+                       std::span<const u8> src, std::span<u8> dst) override {
+        CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption decrypt;
+        decrypt.SetKeyWithIV(key.data(), key.size(), iv.data());
+        decrypt.ProcessData(dst.data(), src.data(), src.size());
+    }
+
+    void AesXtsDecrypt(std::span<const u8, 16> data_key, std::span<const u8, 16> tweak_key,
+                       std::span<const u8> src, std::span<u8> dst, u64 sector) override {
+        // The key schedules are set up once for the whole range, not once per sector.
+        CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption encrypt(tweak_key.data(), tweak_key.size());
+        CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption decrypt(data_key.data(), data_key.size());
+
+        const size_t sectors = src.size() / XtsSectorSize;
+        for (size_t i = 0; i < sectors; i += XtsBatchSectors) {
+            const size_t count = std::min(XtsBatchSectors, sectors - i);
+            DecryptXtsBatch(encrypt, decrypt, src.data() + i * XtsSectorSize,
+                            dst.data() + i * XtsSectorSize, sector + i, count);
+        }
+    }
+
+    void RsaDecrypt(bool is_dk3, std::span<const u8, 256> ciphertext,
+                    std::span<u8, 32> out) override {
+        RSAThreadState& state = GetRSAThreadState();
+        const auto& decryptor = is_dk3 ? state.dk3 : state.fake;
+        std::array<u8, 256> decrypted{};
+        decryptor.Decrypt(state.rng, ciphertext.data(), ciphertext.size(), decrypted.data());
+        std::copy_n(decrypted.begin(), out.size(), out.begin());
+    }
+};
+
+} // Anonymous namespace
+
+CryptoBackend& GetCryptoPPBackend() {
+    static CryptoPPBackend backend;
+    return backend;
+}
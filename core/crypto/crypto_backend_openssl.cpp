@@ -0,0 +1,207 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <vector>
+#include <openssl/bn.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/param_build.h>
+#include <openssl/rsa.h>
+
+#include "core/crypto/crypto_backend.h"
+#include "core/crypto/keys.h"
+
+namespace {
+
+constexpr size_t XtsSectorSize = 0x1000;
+
+struct CipherContext {
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    ~CipherContext() {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+};
+
+// Contexts keep their allocations between calls, one per thread since they are not shareable.
+EVP_CIPHER_CTX* GetCipherContext() {
+    thread_local CipherContext context;
+    return context.ctx;
+}
+
+template <typename Keyset>
+EVP_PKEY* BuildRSAKey() {
+    OSSL_PARAM_BLD* builder = OSSL_PARAM_BLD_new();
+    std::vector<BIGNUM*> numbers;
+    const auto push = [&](const char* name, const u8* data, size_t size) {
+        BIGNUM* number = BN_bin2bn(data, static_cast<int>(size), nullptr);
+        numbers.push_back(number);
+        OSSL_PARAM_BLD_push_BN(builder, name, number);
+    };
+    push(OSSL_PKEY_PARAM_RSA_N, Keyset::Modulus, sizeof(Keyset::Modulus));
+    push(OSSL_PKEY_PARAM_RSA_E, Keyset::PublicExponent, sizeof(Keyset::PublicExponent));
+    push(OSSL_PKEY_PARAM_RSA_D, Keyset::PrivateExponent, sizeof(Keyset::PrivateExponent));
+    push(OSSL_PKEY_PARAM_RSA_FACTOR1, Keyset::Prime1, sizeof(Keyset::Prime1));
+    push(OSSL_PKEY_PARAM_RSA_FACTOR2, Keyset::Prime2, sizeof(Keyset::Prime2));
+    push(OSSL_PKEY_PARAM_RSA_EXPONENT1, Keyset::Exponent1, sizeof(Keyset::Exponent1));
+    push(OSSL_PKEY_PARAM_RSA_EXPONENT2, Keyset::Exponent2, sizeof(Keyset::Exponent2));
+    push(OSSL_PKEY_PARAM_RSA_COEFFICIENT1, Keyset::Coefficient, sizeof(Keyset::Coefficient));
+
+    OSSL_PARAM* params = OSSL_PARAM_BLD_to_param(builder);
+    EVP_PKEY_CTX* ctx = EVP_PKEY_CTX_new_from_name(nullptr, "RSA", nullptr);
+    EVP_PKEY* key = nullptr;
+    if (!params || !ctx || EVP_PKEY_fromdata_init(ctx) <= 0 ||
+        EVP_PKEY_fromdata(ctx, &key, EVP_PKEY_KEYPAIR, params) <= 0) {
+        key = nullptr;
+    }
+    EVP_PKEY_CTX_free(ctx);
+    OSSL_PARAM_free(params);
+    OSSL_PARAM_BLD_free(builder);
+    for (BIGNUM* number : numbers) {
+        BN_clear_free(number);
+    }
+    return key;
+}
+
+struct RSAContext {
+    EVP_PKEY_CTX* ctx = nullptr;
+
+    explicit RSAContext(EVP_PKEY* key) {
+        if (!key) {
+            return;
+        }
+        ctx = EVP_PKEY_CTX_new(key, nullptr);
+        if (ctx && (EVP_PKEY_decrypt_init(ctx) <= 0 ||
+                    EVP_PKEY_CTX_set_rsa_padding(ctx, RSA_PKCS1_PADDING) <= 0)) {
+            EVP_PKEY_CTX_free(ctx);
+            ctx = nullptr;
+        }
+    }
+    ~RSAContext() {
+        EVP_PKEY_CTX_free(ctx);
+    }
+};
+
+EVP_PKEY_CTX* GetRSAContext(bool is_dk3) {
+    // Same reasoning as the Crypto++ backend: keys are built once, contexts once per thread.
+    static EVP_PKEY* const dk3_key = BuildRSAKey<PkgDerivedKey3Keyset>();
+    static EVP_PKEY* const fake_key = BuildRSAKey<FakeKeyset>();
+    thread_local RSAContext dk3{dk3_key};
+    thread_local RSAContext fake{fake_key};
+    return is_dk3 ? dk3.ctx : fake.ctx;
+}
+
+/**
+ * Uses OpenSSL's EVP layer, whose AES (AES-NI/VAES), XTS and SHA-256 paths are hand-tuned
+ * assembly. Whenever OpenSSL refuses an input (e.g. XTS with identical data and tweak keys) the
+ * call is handed to the Crypto++ backend so the result never differs.
+ */
+class OpenSSLBackend final : public CryptoBackend {
+public:
+    std::string_view GetName() const override {
+        return "openssl";
+    }
+
+    void Sha256(std::span<const u8> data, std::span<u8, 32> digest) override {
+        if (EVP_Digest(data.data(), data.size(), digest.data(), nullptr, EVP_sha256(), nullptr) !=
+            1) {
+            GetCryptoPPBackend().Sha256(data, digest);
+        }
+    }
+
+    void HmacSha256(std::span<const u8> key, std::span<const u8> data,
+                    std::span<u8, 32> digest) override {
+        unsigned int size = 0;
+        if (!HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()), data.data(), data.size(),
+                  digest.data(), &size)) {
+            GetCryptoPPBackend().HmacSha256(key, data, digest);
+        }
+    }
+
+    void AesCbcEncrypt(std::span<const u8, 16> key, std::span<const u8, 16> iv,
+                       std::span<const u8> src, std::span<u8> dst) override {
+        if (!RunCbc(true, key, iv, src, dst)) {
+            GetCryptoPPBackend().AesCbcEncrypt(key, iv, src, dst);
+        }
+    }
+
+    void AesCbcDecrypt(std::span<const u8, 16> key, std::span<const u8, 16> iv,
+                       std::span<const u8> src, std::span<u8> dst) override {
+        if (!RunCbc(false, key, iv, src, dst)) {
+            GetCryptoPPBackend().AesCbcDecrypt(key, iv, src, dst);
+        }
+    }
+
+    void AesXtsDecrypt(std::span<const u8, 16> data_key, std::span<const u8, 16> tweak_key,
+                       std::span<const u8> src, std::span<u8> dst, u64 sector) override {
+        EVP_CIPHER_CTX* ctx = GetCipherContext();
+        std::array<u8, 32> key;
+        std::memcpy(key.data(), data_key.data(), 16);
+        std::memcpy(key.data() + 16, tweak_key.data(), 16);
+        if (EVP_DecryptInit_ex(ctx, EVP_aes_128_xts(), nullptr, key.data(), nullptr) != 1) {
+            GetCryptoPPBackend().AesXtsDecrypt(data_key, tweak_key, src, dst, sector);
+            return;
+        }
+        // Whole sectors only, a trailing partial one is left untouched.
+        const size_t sectors = src.size() / XtsSectorSize;
+        for (size_t s = 0; s < sectors; s++) {
+            const size_t i = s * XtsSectorSize;
+            std::array<u8, 16> tweak{};
+            const u64 current_sector = sector + s;
+            std::memcpy(tweak.data(), &current_sector, sizeof(u64));
+            int size = 0;
+            // Only the tweak changes between sectors, the key schedule stays.
+            if (EVP_DecryptInit_ex(ctx, nullptr, nullptr, nullptr, tweak.data()) != 1 ||
+                EVP_DecryptUpdate(ctx, dst.data() + i, &size, src.data() + i,
+                                  static_cast<int>(XtsSectorSize)) != 1) {
+                GetCryptoPPBackend().AesXtsDecrypt(data_key, tweak_key, src.subspan(i),
+                                                   dst.subspan(i), current_sector);
+                return;
+            }
+        }
+    }
+
+    void RsaDecrypt(bool is_dk3, std::span<const u8, 256> ciphertext,
+                    std::span<u8, 32> out) override {
+        EVP_PKEY_CTX* ctx = GetRSAContext(is_dk3);
+        std::array<u8, 256> decrypted{};
+        size_t size = decrypted.size();
+        if (!ctx || EVP_PKEY_decrypt(ctx, decrypted.data(), &size, ciphertext.data(),
+                                     ciphertext.size()) != 1) {
+            GetCryptoPPBackend().RsaDecrypt(is_dk3, ciphertext, out);
+            return;
+        }
+        std::copy_n(decrypted.begin(), out.size(), out.begin());
+    }
+
+private:
+    static bool RunCbc(bool encrypt, std::span<const u8, 16> key, std::span<const u8, 16> iv,
+                       std::span<const u8> src, std::span<u8> dst) {
+        EVP_CIPHER_CTX* ctx = GetCipherContext();
+        if (EVP_CipherInit_ex(ctx, EVP_aes_128_cbc(), nullptr, key.data(), iv.data(),
+                              encrypt ? 1 : 0) != 1 ||
+            EVP_CIPHER_CTX_set_padding(ctx, 0) != 1) {
+            return false;
+        }
+        // EVP takes int lengths, CBC carries the chaining value over between chunks.
+        static constexpr size_t Chunk = 1 << 30;
+        for (size_t i = 0; i < src.size(); i += Chunk) {
+            const int size = static_cast<int>(std::min(Chunk, src.size() - i));
+            int written = 0;
+            if (EVP_CipherUpdate(ctx, dst.data() + i, &written, src.data() + i, size) != 1) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // Anonymous namespace
+
+CryptoBackend& GetOpenSSLBackend() {
+    static OpenSSLBackend backend;
+    return backend;
+}
@@ -0,0 +1,139 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <cryptopp/sha.h>
+#ifdef ENABLE_XXHASH
+#include <xxhash.h>
+#endif
+
+#include "common/assert.h"
+#include "core/crypto/stream_hasher.h"
+
+namespace {
+
+constexpr u8 LeafPrefix = 0x00;
+constexpr u8 NodePrefix = 0x01;
+
+size_t DigestSize(HashAlgorithm algorithm) {
+    return algorithm == HashAlgorithm::SHA256 ? 32 : 16;
+}
+
+std::string ToHex(std::span<const u8> digest) {
+    static constexpr char Digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(digest.size() * 2);
+    for (const u8 byte : digest) {
+        hex.push_back(Digits[byte >> 4]);
+        hex.push_back(Digits[byte & 0xF]);
+    }
+    return hex;
+}
+
+} // Anonymous namespace
+
+std::optional<HashAlgorithm> ParseHashAlgorithm(std::string_view name) {
+    if (name == "sha256") {
+        return HashAlgorithm::SHA256;
+    }
+    if (name == "xxh3" || name == "xxh128") {
+        return HashAlgorithm::XXH3_128;
+    }
+    return std::nullopt;
+}
+
+std::string_view GetHashAlgorithmName(HashAlgorithm algorithm) {
+    return algorithm == HashAlgorithm::SHA256 ? "sha256" : "xxh128";
+}
+
+bool IsHashAlgorithmAvailable(HashAlgorithm algorithm) {
+#ifdef ENABLE_XXHASH
+    return true;
+#else
+    return algorithm == HashAlgorithm::SHA256;
+#endif
+}
+
+// One incremental context of either algorithm.
+struct StreamHasher::State {
+    explicit State(HashAlgorithm algorithm_) : algorithm{algorithm_} {
+#ifdef ENABLE_XXHASH
+        if (algorithm == HashAlgorithm::XXH3_128) {
+            xxh = XXH3_createState();
+            XXH3_128bits_reset(xxh);
+        }
+#endif
+    }
+    ~State() {
+#ifdef ENABLE_XXHASH
+        if (xxh) {
+            XXH3_freeState(xxh);
+        }
+#endif
+    }
+
+    void Update(const u8* data, size_t size) {
+#ifdef ENABLE_XXHASH
+        if (xxh) {
+            XXH3_128bits_update(xxh, data, size);
+            return;
+        }
+#endif
+        sha.Update(data, size);
+    }
+
+    // Writes DigestSize(algorithm) bytes and resets the context.
+    void Final(u8* out) {
+#ifdef ENABLE_XXHASH
+        if (xxh) {
+            XXH128_canonicalFromHash(reinterpret_cast<XXH128_canonical_t*>(out),
+                                     XXH3_128bits_digest(xxh));
+            XXH3_128bits_reset(xxh);
+            return;
+        }
+#endif
+        sha.Final(out);
+    }
+
+    HashAlgorithm algorithm;
+    CryptoPP::SHA256 sha;
+#ifdef ENABLE_XXHASH
+    XXH3_state_t* xxh = nullptr;
+#endif
+};
+
+StreamHasher::StreamHasher(HashAlgorithm algorithm_, bool tree_, size_t num_blocks)
+    : algorithm{algorithm_}, tree{tree_}, state{std::make_unique<State>(algorithm_)} {
+    ASSERT_MSG(IsHashAlgorithmAvailable(algorithm), "Hash algorithm not built in");
+    if (tree) {
+        leaves.resize(num_blocks);
+    }
+}
+
+StreamHasher::~StreamHasher() = default;
+
+void StreamHasher::Update(size_t block_index, std::span<const u8> data) {
+    if (!tree) {
+        ASSERT_MSG(block_index == next_block, "Flat hashing needs blocks in order");
+        next_block++;
+        state->Update(data.data(), data.size());
+        return;
+    }
+    // Leaves are independent, a private context keeps concurrent updates apart.
+    State leaf_state{algorithm};
+    leaf_state.Update(&LeafPrefix, 1);
+    leaf_state.Update(data.data(), data.size());
+    leaf_state.Final(leaves[block_index].data());
+}
+
+std::string StreamHasher::Finish() {
+    std::array<u8, 32> digest{};
+    const size_t size = DigestSize(algorithm);
+    if (tree) {
+        state->Update(&NodePrefix, 1);
+        for (const auto& leaf : leaves) {
+            state->Update(leaf.data(), size);
+        }
+    }
+    state->Final(digest.data());
+    return ToHex(std::span<const u8>(digest.data(), size));
+}
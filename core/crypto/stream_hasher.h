@@ -0,0 +1,52 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/types.h"
+
+enum class HashAlgorithm {
+    SHA256,
+    XXH3_128, // only when built with xxHash
+};
+
+std::optional<HashAlgorithm> ParseHashAlgorithm(std::string_view name);
+std::string_view GetHashAlgorithmName(HashAlgorithm algorithm);
+bool IsHashAlgorithmAvailable(HashAlgorithm algorithm);
+
+/**
+ * Hashes a file while it is being produced block by block.
+ *
+ * In flat mode blocks must arrive in order and the result is the plain digest of the file
+ * contents, the same value sha256sum would print. In tree mode every block is hashed on its own
+ * and may arrive in any order, the result is H(0x01 || leaf_0 || ... || leaf_n-1) with
+ * leaf_i = H(0x00 || block_i).
+ */
+class StreamHasher {
+public:
+    StreamHasher(HashAlgorithm algorithm, bool tree, size_t num_blocks);
+    ~StreamHasher();
+
+    StreamHasher(const StreamHasher&) = delete;
+    StreamHasher& operator=(const StreamHasher&) = delete;
+
+    void Update(size_t block_index, std::span<const u8> data);
+    /// Returns the lowercase hex digest.
+    std::string Finish();
+
+private:
+    struct State;
+
+    HashAlgorithm algorithm;
+    bool tree;
+    size_t next_block = 0;
+    std::vector<std::array<u8, 32>> leaves;
+    std::unique_ptr<State> state;
+};
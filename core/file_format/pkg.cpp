@@ -2,21 +2,30 @@
 // SPDX-License-Identifier: GPL-2.0-or-later
 
 #include <zlib.h>
+#include <algorithm>
 #include <span>
+#include "common/alignment.h"
+#include "common/file_writer.h"
 #include "common/io_file.h"
 #include "common/logging/formatter.h"
+#include "common/logging/log.h"
+#include "common/mapped_file.h"
+#include "common/parallel_for.h"
+#include "common/path_util.h"
 #include "core/file_format/pkg.h"
 #include "core/file_format/pkg_type.h"
+#include "core/file_format/playgo_chunk.h"
 #include <iostream>
-#include "simple_log.h"
 #include <thread>
 #include <atomic>
 #include <mutex>
 #include <iomanip>
+#include <limits>
 #include <sstream>
+#include <utility>
 #include <chrono>
 
-static void DecompressPFSC(char* compressed_data, size_t compressed_size, char* decompressed_data, size_t decompressed_size) {
+static bool DecompressPFSC(char* compressed_data, size_t compressed_size, char* decompressed_data, size_t decompressed_size) {
     z_stream decompressStream;
     decompressStream.zalloc = Z_NULL;
     decompressStream.zfree = Z_NULL;
@@ -24,6 +33,7 @@ static void DecompressPFSC(char* compressed_data, size_t compressed_size, char*
 
     if (inflateInit(&decompressStream) != Z_OK) {
         // std::cerr << "Error initializing zlib for deflation." << std::endl;
+        return false;
     }
 
     decompressStream.avail_in = static_cast<uInt>(compressed_size);
@@ -31,11 +41,11 @@ static void DecompressPFSC(char* compressed_data, size_t compressed_size, char*
     decompressStream.avail_out = static_cast<uInt>(decompressed_size);
     decompressStream.next_out = reinterpret_cast<unsigned char*>(decompressed_data);
 
-    if (inflate(&decompressStream, Z_FINISH)) {
-    }
+    const int ret = inflate(&decompressStream, Z_FINISH);
     if (inflateEnd(&decompressStream) != Z_OK) {
         // std::cerr << "Error ending zlib inflate" << std::endl;
     }
+    return ret == Z_STREAM_END;
 }
 
 u32 GetPFSCOffset(const u8* pfs_image, size_t size) {
@@ -49,22 +59,115 @@ u32 GetPFSCOffset(const u8* pfs_image, size_t size) {
     return -1;
 }
 
-PKG::PKG() = default;
+namespace {
+
+// A PFSC block is read with up to 0x1000 bytes of leading data to stay XTS sector aligned.
+constexpr size_t PFSCReadSize = 0x11000;
+constexpr size_t PFSCBlockSize = 0x10000;
+constexpr size_t BlockScratchSize = PFSCReadSize * 2 + PFSCBlockSize;
+
+// Extraction workers, each holding one block buffer plus a file and a batch buffer of the
+// FileWriter at most.
+constexpr size_t MaxExtractWorkers = 8;
+// A budget leaves this share to the FileWriter, the rest goes to the block buffers.
+constexpr u64 WriterBudgetDivisor = 4;
+// Output buffers are shrunk down to one inflated block to fit a tight budget.
+constexpr size_t MinWriterBufferSize = PFSCBlockSize;
+
+// DK3 inside ENTRY_KEYS: seed digest, 7 digests, then the fourth of the 7 keys.
+constexpr size_t Key3Offset = 32 + 7 * 32 + 3 * 256;
+
+std::unique_ptr<Common::FS::FileWriter> MakeFileWriter(u64 budget) {
+    const u64 writer_budget = budget / WriterBudgetDivisor;
+    size_t buffer_size = Common::FS::FileWriter::DefaultBufferSize;
+    if (writer_budget != 0) {
+        buffer_size = static_cast<size_t>(std::clamp<u64>(writer_budget / (2 * MaxExtractWorkers),
+                                                          MinWriterBufferSize, buffer_size));
+    }
+    return std::make_unique<Common::FS::FileWriter>(buffer_size, writer_budget);
+}
+
+struct BlockScratch {
+    std::span<u8> pfsc;
+    std::span<u8> decrypted;
+    std::span<char> decompressed;
+};
+
+BlockScratch SplitBlockScratch(std::span<u8> buffer) {
+    return {buffer.subspan(0, PFSCReadSize), buffer.subspan(PFSCReadSize, PFSCReadSize),
+            std::span<char>(reinterpret_cast<char*>(buffer.data() + PFSCReadSize * 2),
+                            PFSCBlockSize)};
+}
+
+} // Anonymous namespace
+
+// Block buffers are aligned for uncached reads, the PFSC read buffer comes first in them.
+PKG::PKG()
+    : bufferPool{std::make_unique<Common::BufferPool>(BlockScratchSize, 0,
+                                                      Common::FS::IOFile::DirectAlignment)} {}
 
 PKG::~PKG() = default;
 
+void PKG::EnableHashManifest(HashAlgorithm algorithm, bool tree) {
+    manifestAlgorithm = algorithm;
+    manifestTree = tree;
+    manifest.clear();
+}
+
+bool PKG::WriteHashManifest(const std::filesystem::path& manifest_path,
+                            std::string& failreason) {
+    if (!manifestAlgorithm) {
+        failreason = "Hash manifest was not enabled";
+        return false;
+    }
+    std::ranges::sort(manifest, {}, &HashManifestEntry::path);
+
+    std::string text = fmt::format("# {} {}\n", GetHashAlgorithmName(*manifestAlgorithm),
+                                   manifestTree ? "tree" : "flat");
+    for (const auto& entry : manifest) {
+        text += fmt::format("{}\t{}\t{}\n", entry.hash, entry.size,
+                            fmt::UTF(entry.path.generic_u8string()));
+    }
+    Common::FS::IOFile out(manifest_path, Common::FS::FileAccessMode::Write);
+    if (out.WriteString(text) != text.size()) {
+        failreason = "Failed to write hash manifest";
+        return false;
+    }
+    return true;
+}
+
+void PKG::SetMemoryBudget(u64 max_bytes) {
+    memoryBudget = max_bytes;
+    bufferPool = std::make_unique<Common::BufferPool>(
+        BlockScratchSize, max_bytes - max_bytes / WriterBudgetDivisor,
+        Common::FS::IOFile::DirectAlignment);
+}
+
+u64 PKG::GetPoolPeakUsage() const {
+    return bufferPool->GetPeakUsage();
+}
+
 bool PKG::Open(const std::filesystem::path& filepath, std::string& failreason) {
-    simple_log("[DEBUG] Inizio PKG::Open su " + filepath.string());
-    Common::FS::IOFile file(filepath, Common::FS::FileAccessMode::Read);
-    if (!file.IsOpen()) {
-        simple_log("[ERROR] File non aperto: " + filepath.string());
+    LOG_DEBUG(Loader, "Opening {}", Common::FS::PathToUTF8String(filepath));
+    // Only the header, the entry table and param.sfo are touched, map the file and read them
+    // in place instead of seeking around.
+    const Common::FS::MappedFile file(filepath);
+    if (!file.IsMapped()) {
+        LOG_ERROR(Loader, "Failed to open {}", Common::FS::PathToUTF8String(filepath));
         return false;
     }
-    pkgSize = file.GetSize();
+    file.Advise(Common::FS::MapHint::Random);
+    const std::span<const u8> data = file.Span();
+    pkgSize = file.GetFileSize();
 
-    file.Read(pkgheader);
+    if (data.size() < sizeof(pkgheader)) {
+        failreason = "File is too small to be a PKG";
+        LOG_ERROR(Loader, "{}", failreason);
+        return false;
+    }
+    std::memcpy(&pkgheader, data.data(), sizeof(pkgheader));
     if (pkgheader.magic != 0x7F434E54) {
-        simple_log("[ERROR] Magic non valido nel PKG header");
+        LOG_ERROR(Loader, "Invalid PKG header magic");
         return false;
     }
 
@@ -77,211 +180,408 @@ bool PKG::Open(const std::filesystem::path& filepath, std::string& failreason) {
     }
 
     // Find title id it is part of pkg_content_id starting at offset 0x40
-    file.Seek(0x47); // skip first 7 characters of content_id
-    file.Read(pkgTitleID);
+    // skip first 7 characters of content_id
+    std::memcpy(pkgTitleID, pkgheader.pkg_content_id + 7, sizeof(pkgTitleID));
 
     u32 offset = pkgheader.pkg_table_entry_offset;
     u32 n_files = pkgheader.pkg_table_entry_count;
 
-    simple_log("[DEBUG] Table entry offset: " + std::to_string(offset) + ", count: " + std::to_string(n_files));
+    LOG_DEBUG(Loader, "Table entry offset: {}, count: {}", offset, n_files);
 
-    if (!file.Seek(offset)) {
+    if (u64(offset) + u64(n_files) * sizeof(PKGEntry) > data.size()) {
         failreason = "Failed to seek to PKG table entry offset";
-        simple_log("[ERROR] " + failreason);
+        LOG_ERROR(Loader, "{}", failreason);
         return false;
     }
 
-    pkgEntries.clear();
-    for (int i = 0; i < n_files; i++) {
-        PKGEntry entry{};
-        file.Read(entry.id);
-        file.Read(entry.filename_offset);
-        file.Read(entry.flags1);
-        file.Read(entry.flags2);
-        file.Read(entry.offset);
-        file.Read(entry.size);
-        file.Seek(8, Common::FS::SeekOrigin::CurrentPosition);
-        pkgEntries.push_back(entry);
+    pkgEntries.resize(n_files);
+    Common::DecodeBigEndian(data.subspan(offset), std::span{pkgEntries});
+    for (u32 i = 0; i < n_files; i++) {
+        const PKGEntry& entry = pkgEntries[i];
         // Try to figure out the name
         const auto name = GetEntryNameByType(entry.id);
-        simple_log("[DEBUG] Entry " + std::to_string(i) + ": id=" + std::to_string(entry.id) + ", name=" + std::string(name));
+        LOG_DEBUG(Loader, "Entry {}: id={}, name={}", i, entry.id, name);
         if (name == "param.sfo") {
             sfo.clear();
-            if (!file.Seek(entry.offset)) {
+            if (u64(entry.offset) + entry.size > data.size()) {
                 failreason = "Failed to seek to param.sfo offset";
-                simple_log("[ERROR] " + failreason);
+                LOG_ERROR(Loader, "{}", failreason);
                 return false;
             }
-            sfo.resize(entry.size);
-            file.ReadRaw<u8>(sfo.data(), entry.size);
+            sfo.assign(data.begin() + entry.offset, data.begin() + entry.offset + entry.size);
         }
     }
-    file.Close();
 
-    simple_log("[DEBUG] Fine PKG::Open");
+    LOG_DEBUG(Loader, "Opened {} entries", n_files);
     return true;
 }
 
 bool PKG::Extract(const std::filesystem::path& filepath, const std::filesystem::path& extract,
                   std::string& failreason) {
-    simple_log("[DEBUG] Inizio PKG::Extract su " + filepath.string() + " -> " + extract.string());
+    LOG_DEBUG(Loader, "Extracting {} to {}", Common::FS::PathToUTF8String(filepath),
+              Common::FS::PathToUTF8String(extract));
+    // The keys and the parsed image only depend on the package, not on the destination.
+    const bool reuse_image = fileSystemLoaded && pkgpath == filepath;
+    fileSystemLoaded = false;
     extract_path = extract;
     pkgpath = filepath;
-    Common::FS::IOFile file(filepath, Common::FS::FileAccessMode::Read);
+    // A fresh writer per destination, directories cached for an earlier one may be gone.
+    fileWriter = MakeFileWriter(memoryBudget);
+    fileWriter->SetUncached(directIO);
+    sharedPkgFile.Open(filepath, Common::FS::FileAccessMode::Read);
+    const Common::FS::IOFile& file = sharedPkgFile;
     if (!file.IsOpen()) {
-        simple_log("[ERROR] File non aperto in Extract: " + filepath.string());
+        LOG_ERROR(Loader, "Failed to open {} for extraction", Common::FS::PathToUTF8String(filepath));
         return false;
     }
-    pkgSize = file.GetSize();
-    file.ReadRaw<u8>(&pkgheader, sizeof(PKGHeader));
-
-    simple_log("[DEBUG] pkgheader.magic: " + std::to_string(pkgheader.magic));
-    simple_log("[DEBUG] pkgheader.pkg_size: " + std::to_string(pkgheader.pkg_size));
-    simple_log("[DEBUG] pkgheader.pkg_content_size: " + std::to_string(pkgheader.pkg_content_size));
-    simple_log("[DEBUG] pkgheader.pkg_content_offset: " + std::to_string(pkgheader.pkg_content_offset));
-    simple_log("[DEBUG] pkgheader.pkg_table_entry_offset: " + std::to_string(pkgheader.pkg_table_entry_offset));
-    simple_log("[DEBUG] pkgheader.pkg_table_entry_count: " + std::to_string(pkgheader.pkg_table_entry_count));
-    simple_log("[DEBUG] pkgheader.pfs_image_offset: " + std::to_string(pkgheader.pfs_image_offset));
-    simple_log("[DEBUG] pkgheader.pfs_cache_size: " + std::to_string(pkgheader.pfs_cache_size));
-
-    if (pkgheader.magic != 0x7F434E54) {
-        simple_log("[ERROR] Magic non valido in Extract");
+    if (directIO && !sharedPkgFile.OpenDirect()) {
+        LOG_ERROR(Loader, "Direct reads unavailable for {}, using the page cache",
+                  Common::FS::PathToUTF8String(filepath));
+    }
+    if (!ReadHeader(file, failreason)) {
+        LOG_ERROR(Loader, "{}", failreason);
         return false;
     }
 
-    if (pkgheader.pkg_size > pkgSize) {
-        failreason = "PKG file size is different";
-        simple_log("[ERROR] " + failreason);
+    LOG_DEBUG(Loader, "pkgheader.pkg_size: {}", pkgheader.pkg_size);
+    LOG_DEBUG(Loader, "pkgheader.pkg_content_size: {}", pkgheader.pkg_content_size);
+    LOG_DEBUG(Loader, "pkgheader.pkg_content_offset: {}", pkgheader.pkg_content_offset);
+    LOG_DEBUG(Loader, "pkgheader.pkg_table_entry_offset: {}", pkgheader.pkg_table_entry_offset);
+    LOG_DEBUG(Loader, "pkgheader.pkg_table_entry_count: {}", pkgheader.pkg_table_entry_count);
+    LOG_DEBUG(Loader, "pkgheader.pfs_image_offset: {}", pkgheader.pfs_image_offset);
+    LOG_DEBUG(Loader, "pkgheader.pfs_cache_size: {}", pkgheader.pfs_cache_size);
+
+    const u32 offset = pkgheader.pkg_table_entry_offset;
+    const u32 n_files = pkgheader.pkg_table_entry_count;
+    LOG_DEBUG(Loader, "Table entry offset: {}, count: {}", offset, n_files);
+
+    pkgEntries.resize(n_files);
+    if (!file.Seek(offset) || file.ReadRaw<PKGEntry>(pkgEntries.data(), n_files) != n_files) {
+        failreason = "Failed to read PKG entry table";
+        LOG_ERROR(Loader, "{}", failreason);
         return false;
     }
-    if ((pkgheader.pkg_content_size + pkgheader.pkg_content_offset) > pkgheader.pkg_size) {
-        failreason = "Content size is bigger than pkg size";
-        simple_log("[ERROR] " + failreason);
+    Common::SwapBigEndian(std::span{pkgEntries});
+
+    std::vector<std::vector<u8>> payloads;
+    if (!ReadEntryPayloads(file, payloads, failreason)) {
+        LOG_ERROR(Loader, "{}", failreason);
         return false;
     }
 
-    u32 offset = pkgheader.pkg_table_entry_offset;
-    u32 n_files = pkgheader.pkg_table_entry_count;
-    simple_log("[DEBUG] Table entry offset: " + std::to_string(offset) + ", count: " + std::to_string(n_files));
+    // Keys first, NP entries can only be decrypted once dk3 is known.
+    playgo.clear();
+    for (u32 i = 0; i < n_files; i++) {
+        if (!reuse_image) {
+            DeriveEntryKeys(pkgEntries[i], payloads[i]);
+        }
+        if (pkgEntries[i].id == 0x1001) { // playgo-chunk.dat
+            playgo = payloads[i];
+        }
+    }
 
-    std::array<u8, 64> concatenated_ivkey_dk3;
-    std::array<u8, 32> seed_digest;
-    std::array<std::array<u8, 32>, 7> digest1;
-    std::array<std::array<u8, 256>, 7> key1;
-    std::array<u8, 256> imgkeydata;
+    // Several ids can map to the same name, the last one in table order used to win when the
+    // entries were written one after the other, keep it that way.
+    std::unordered_map<std::filesystem::path, u32> outputs;
+    for (u32 i = 0; i < n_files; i++) {
+        const auto name = GetEntryNameByType(pkgEntries[i].id);
+        outputs[extract_path / "sce_sys" /
+                (name.empty() ? std::to_string(pkgEntries[i].id) : std::string(name))] = i;
+    }
+    std::vector<std::pair<std::filesystem::path, u32>> to_write(outputs.begin(), outputs.end());
 
-    if (!file.Seek(offset)) {
-        failreason = "Failed to seek to PKG table entry offset";
+    // Entries are independent from here on, write them concurrently.
+    std::atomic<bool> write_failed{false};
+    Common::ParallelFor(to_write.size(), [&](size_t i) {
+        const auto& [path, index] = to_write[i];
+        const PKGEntry& entry = pkgEntries[index];
+        std::vector<u8>& data = payloads[index];
+
+        // Decrypt Np stuff before writing it.
+        if (entry.id == 0x400 || entry.id == 0x401 || entry.id == 0x402 ||
+            entry.id == 0x403) { // somehow 0x401 is not decrypting
+            std::array<u8, 64> concatenated_ivkey_dk3_;
+            const auto raw_entry = Common::EncodeBigEndian(entry);
+            std::memcpy(concatenated_ivkey_dk3_.data(), raw_entry.data(), raw_entry.size());
+            std::memcpy(concatenated_ivkey_dk3_.data() + sizeof(entry), dk3_.data(), sizeof(dk3_));
+            std::array<u8, 32> entry_iv_key;
+            PKG::crypto.ivKeyHASH256(concatenated_ivkey_dk3_, entry_iv_key);
+            std::vector<u8> decrypted(data.size());
+            PKG::crypto.aesCbcCfb128DecryptEntry(entry_iv_key, data, decrypted);
+            data = std::move(decrypted);
+        }
+
+        if (!fileWriter->WriteFile(path, data)) {
+            write_failed = true;
+        }
+    });
+    payloads.clear();
+    if (write_failed) {
+        failreason = "Failed to write sce_sys entries";
+        LOG_ERROR(Loader, "{}", failreason);
         return false;
     }
 
-    for (int i = 0; i < n_files; i++) {
-        PKGEntry entry{};
-        file.Read(entry.id);
-        file.Read(entry.filename_offset);
-        file.Read(entry.flags1);
-        file.Read(entry.flags2);
-        file.Read(entry.offset);
-        file.Read(entry.size);
-        file.Seek(8, Common::FS::SeekOrigin::CurrentPosition);
+    if (reuse_image ? !AssignExtractPaths(failreason) : !LoadPFSImage(file, failreason)) {
+        LOG_ERROR(Loader, "{}", failreason);
+        return false;
+    }
+    fileSystemLoaded = true;
 
-        auto currentPos = file.Tell();
+    // Create the folder structure up front so the workers only have to open files.
+    for (const auto& table : fsTable) {
+        if (table.type == PFS_DIR) {
+            fileWriter->CreateDirectories(extractPaths[table.inode]);
+        }
+    }
+    LOG_DEBUG(Loader, "Parsed the PFS block table");
+    return true;
+}
 
-        // Try to figure out the name
-        const auto name = GetEntryNameByType(entry.id);
-        const auto filepath = extract_path / "sce_sys" / name;
-        std::filesystem::create_directories(filepath.parent_path());
-
-        if (name.empty()) {
-            // Just print with id
-            Common::FS::IOFile out(extract_path / "sce_sys" / std::to_string(entry.id),
-                                   Common::FS::FileAccessMode::Write);
-            if (!file.Seek(entry.offset)) {
-                failreason = "Failed to seek to PKG entry offset";
-                return false;
-            }
+bool PKG::ReadFileSystem(const std::filesystem::path& filepath, std::string& failreason) {
+    KeyEntries keys;
+    if (!ReadKeyEntries(filepath, keys, failreason)) {
+        return false;
+    }
+    PKG::crypto.RSA2048Decrypt(dk3_, keys.dk3_ciphertext, true);
+    DecryptImageKey(keys.image_key_entry, keys.image_key_data);
+    PKG::crypto.RSA2048Decrypt(ekpfsKey, imgKey, false);
 
-            std::vector<u8> data;
-            data.resize(entry.size);
-            file.ReadRaw<u8>(data.data(), entry.size);
-            out.WriteRaw<u8>(data.data(), data.size());
-            out.Close();
+    fileSystemLoaded = LoadPFSImage(sharedPkgFile, failreason);
+    return fileSystemLoaded;
+}
 
-            file.Seek(currentPos);
-            continue;
+void PKG::ReadFileSystems(std::span<PKG* const> packages,
+                          std::span<const std::filesystem::path> paths,
+                          std::span<std::string> failreasons, size_t max_threads) {
+    std::vector<KeyEntries> keys(packages.size());
+    std::vector<u8> opened(packages.size(), 0);
+    Common::ParallelFor(
+        packages.size(),
+        [&](size_t i) {
+            opened[i] = packages[i]->ReadKeyEntries(paths[i], keys[i], failreasons[i]) ? 1 : 0;
+        },
+        max_threads);
+    std::vector<size_t> pending;
+    for (size_t i = 0; i < packages.size(); i++) {
+        if (opened[i]) {
+            pending.push_back(i);
         }
+    }
 
-        if (entry.id == 0x1) {         // DIGESTS, seek;
-                                       // file.Seek(entry.offset, fsSeekSet);
-        } else if (entry.id == 0x10) { // ENTRY_KEYS, seek;
-            file.Seek(entry.offset);
-            file.Read(seed_digest);
-
-            for (int i = 0; i < 7; i++) {
-                file.Read(digest1[i]);
+    // The EKPFS ciphertext depends on DK3, so every DK3 is decrypted first.
+    Crypto crypto;
+    std::vector<std::array<u8, 256>> ciphertexts(pending.size());
+    std::vector<std::array<u8, 32>> decrypted(pending.size());
+    for (size_t k = 0; k < pending.size(); k++) {
+        ciphertexts[k] = keys[pending[k]].dk3_ciphertext;
+    }
+    crypto.RSA2048DecryptBatch(ciphertexts, decrypted, true, max_threads);
+    for (size_t k = 0; k < pending.size(); k++) {
+        PKG& pkg = *packages[pending[k]];
+        pkg.dk3_ = decrypted[k];
+        pkg.DecryptImageKey(keys[pending[k]].image_key_entry, keys[pending[k]].image_key_data);
+        ciphertexts[k] = pkg.imgKey;
+    }
+    crypto.RSA2048DecryptBatch(ciphertexts, decrypted, false, max_threads);
+
+    // The images are parsed side by side and each parse is parallel itself, the threads are
+    // split between the two levels so they never add up to more than the cap.
+    const size_t package_workers = Common::GetWorkerCount(pending.size(), max_threads);
+    const size_t parse_threads = std::max<size_t>(
+        1, Common::GetWorkerCount(std::numeric_limits<size_t>::max(), max_threads) /
+               package_workers);
+    Common::ParallelFor(
+        pending.size(),
+        [&](size_t k) {
+            PKG& pkg = *packages[pending[k]];
+            std::string& failreason = failreasons[pending[k]];
+            pkg.ekpfsKey = decrypted[k];
+            pkg.fileSystemLoaded = pkg.LoadPFSImage(pkg.sharedPkgFile, failreason, parse_threads);
+            if (!pkg.fileSystemLoaded && failreason.empty()) {
+                failreason = "Failed to read file system";
             }
+        },
+        package_workers);
+}
 
-            for (int i = 0; i < 7; i++) {
-                file.Read(key1[i]);
-            }
+bool PKG::ReadKeyEntries(const std::filesystem::path& filepath, KeyEntries& keys,
+                         std::string& failreason) {
+    fileSystemLoaded = false;
+    pkgpath = filepath;
+    extract_path.clear();
+    sharedPkgFile.Open(filepath, Common::FS::FileAccessMode::Read);
+    const Common::FS::IOFile& file = sharedPkgFile;
+    if (!file.IsOpen()) {
+        failreason = "Failed to open PKG file";
+        return false;
+    }
+    if (directIO) {
+        sharedPkgFile.OpenDirect();
+    }
+    if (!ReadHeader(file, failreason)) {
+        return false;
+    }
 
-            PKG::crypto.RSA2048Decrypt(dk3_, key1[3], true); // decrypt DK3
-        } else if (entry.id == 0x20) {                       // IMAGE_KEY, seek; IV_KEY
-            file.Seek(entry.offset);
-            file.Read(imgkeydata);
+    // Only ENTRY_KEYS and IMAGE_KEY are needed to reach the PFS image.
+    const u32 n_files = pkgheader.pkg_table_entry_count;
+    pkgEntries.resize(n_files);
+    if (!file.Seek(pkgheader.pkg_table_entry_offset) ||
+        file.ReadRaw<PKGEntry>(pkgEntries.data(), n_files) != n_files) {
+        failreason = "Failed to read PKG entry table";
+        return false;
+    }
+    Common::SwapBigEndian(std::span{pkgEntries});
+    bool has_entry_keys = false;
+    bool has_image_key = false;
+    for (const auto& entry : pkgEntries) {
+        if (entry.id == 0x10 && entry.size >= Key3Offset + keys.dk3_ciphertext.size()) {
+            has_entry_keys = file.ReadAt(entry.offset + Key3Offset, keys.dk3_ciphertext) ==
+                             keys.dk3_ciphertext.size();
+        } else if (entry.id == 0x20 && entry.size >= keys.image_key_data.size()) {
+            keys.image_key_entry = entry;
+            has_image_key =
+                file.ReadAt(entry.offset, keys.image_key_data) == keys.image_key_data.size();
+        }
+    }
+    if (!has_entry_keys || !has_image_key) {
+        failreason = "Failed to read PKG key entries";
+        return false;
+    }
+    return true;
+}
 
-            // The Concatenated iv + dk3 imagekey for HASH256
-            std::memcpy(concatenated_ivkey_dk3.data(), &entry, sizeof(entry));
-            std::memcpy(concatenated_ivkey_dk3.data() + sizeof(entry), dk3_.data(), sizeof(dk3_));
+bool PKG::ReadEntryPayloads(const Common::FS::IOFile& file,
+                            std::vector<std::vector<u8>>& payloads, std::string& failreason) {
+    // Entries close to each other are fetched with one read, a run is cut when the hole to the
+    // next entry or the run itself gets too large.
+    static constexpr u64 MaxGap = 64_KB;
+    static constexpr u64 MaxRun = 16_MB;
 
-            PKG::crypto.ivKeyHASH256(concatenated_ivkey_dk3, ivKey); // ivkey_
-            // imgkey_ to use for last step to get ekpfs
-            PKG::crypto.aesCbcCfb128Decrypt(ivKey, imgkeydata, imgKey);
-            // ekpfs key to get data and tweak keys.
-            PKG::crypto.RSA2048Decrypt(ekpfsKey, imgKey, false);
-        } else if (entry.id == 0x80) {
-            // GENERAL_DIGESTS, seek;
-            // file.Seek(entry.offset, fsSeekSet);
+    std::vector<u32> order(pkgEntries.size());
+    for (u32 i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::ranges::sort(order, {}, [&](u32 i) { return u32(pkgEntries[i].offset); });
+
+    payloads.assign(pkgEntries.size(), {});
+    std::vector<u8> run;
+    std::vector<u8> gap(MaxGap);
+    std::vector<std::span<u8>> buffers;
+    for (size_t first = 0; first < order.size();) {
+        const u64 run_start = pkgEntries[order[first]].offset;
+        u64 run_end = run_start + pkgEntries[order[first]].size;
+        size_t last = first + 1;
+        for (; last < order.size(); last++) {
+            const PKGEntry& next = pkgEntries[order[last]];
+            const u64 next_end = std::max<u64>(run_end, u64(next.offset) + next.size);
+            if (next.offset > run_end + MaxGap || next_end - run_start > MaxRun) {
+                break;
+            }
+            run_end = next_end;
         }
-
-        Common::FS::IOFile out(extract_path / "sce_sys" / name, Common::FS::FileAccessMode::Write);
-        if (!file.Seek(entry.offset)) {
-            failreason = "Failed to seek to PKG entry offset";
+        if (run_end > pkgSize) {
+            failreason = "PKG entry is out of file bounds";
             return false;
         }
 
-        std::vector<u8> data;
-        data.resize(entry.size);
-        file.ReadRaw<u8>(data.data(), entry.size);
-        out.WriteRaw<u8>(data.data(), data.size());
-        out.Close();
-
-        // Decrypt Np stuff and overwrite.
-        if (entry.id == 0x400 || entry.id == 0x401 || entry.id == 0x402 ||
-            entry.id == 0x403) { // somehow 0x401 is not decrypting
-            decNp.resize(entry.size);
-            if (!file.Seek(entry.offset)) {
-                failreason = "Failed to seek to PKG entry offset";
+        // One vectored read puts every entry straight into its payload, the holes between
+        // them go to a scratch buffer. Overlapping entries are read as one block and copied.
+        buffers.clear();
+        u64 cursor = run_start;
+        for (size_t i = first; i < last; i++) {
+            const PKGEntry& entry = pkgEntries[order[i]];
+            if (entry.offset < cursor) {
+                cursor = ~u64(0);
+                break;
+            }
+            if (entry.offset > cursor) {
+                buffers.push_back(std::span(gap).first(entry.offset - cursor));
+            }
+            payloads[order[i]].resize(entry.size);
+            buffers.push_back(payloads[order[i]]);
+            cursor = u64(entry.offset) + entry.size;
+        }
+        if (cursor == run_end) {
+            if (file.ReadAtV(run_start, buffers) != run_end - run_start) {
+                failreason = "Failed to read PKG entries";
                 return false;
             }
+            first = last;
+            continue;
+        }
 
-            std::array<u8, 64> concatenated_ivkey_dk3_;
-            std::memcpy(concatenated_ivkey_dk3_.data(), &entry, sizeof(entry));
-            std::memcpy(concatenated_ivkey_dk3_.data() + sizeof(entry), dk3_.data(), sizeof(dk3_));
-            PKG::crypto.ivKeyHASH256(concatenated_ivkey_dk3_, ivKey);
-            PKG::crypto.aesCbcCfb128DecryptEntry(
-                std::span<const CryptoPP::byte, 32>(reinterpret_cast<const CryptoPP::byte*>(ivKey.data()), 32),
-                std::span<CryptoPP::byte>(reinterpret_cast<CryptoPP::byte*>(data.data()), entry.size),
-                std::span<CryptoPP::byte>(reinterpret_cast<CryptoPP::byte*>(decNp.data()), decNp.size())
-            );
-            Common::FS::IOFile out(extract_path / "sce_sys" / name, Common::FS::FileAccessMode::Write);
-            out.WriteRaw<u8>(decNp.data(), decNp.size());
-            out.Close();
+        run.resize(run_end - run_start);
+        if (file.ReadAt(run_start, run) != run.size()) {
+            failreason = "Failed to read PKG entries";
+            return false;
         }
+        for (size_t i = first; i < last; i++) {
+            const PKGEntry& entry = pkgEntries[order[i]];
+            const u8* begin = run.data() + (entry.offset - run_start);
+            payloads[order[i]].assign(begin, begin + entry.size);
+        }
+        first = last;
+    }
+    return true;
+}
 
-        file.Seek(currentPos);
+bool PKG::ReadHeader(const Common::FS::IOFile& file, std::string& failreason) {
+    pkgSize = file.GetSize();
+    if (!file.Seek(0) || !file.Read(pkgheader)) {
+        failreason = "Failed to read PKG header";
+        return false;
+    }
+    if (pkgheader.magic != 0x7F434E54) {
+        failreason = "Invalid PKG magic";
+        return false;
+    }
+    if (pkgheader.pkg_size > pkgSize) {
+        failreason = "PKG file size is different";
+        return false;
+    }
+    if ((pkgheader.pkg_content_size + pkgheader.pkg_content_offset) > pkgheader.pkg_size) {
+        failreason = "Content size is bigger than pkg size";
+        return false;
+    }
+    // Title id is part of pkg_content_id, skip the first 7 characters.
+    std::memcpy(pkgTitleID, pkgheader.pkg_content_id + 7, sizeof(pkgTitleID));
+    return true;
+}
+
+void PKG::DeriveEntryKeys(const PKGEntry& entry, std::span<const u8> data) {
+    if (entry.id == 0x10) { // ENTRY_KEYS
+        if (data.size() < Key3Offset + 256) {
+            return;
+        }
+        PKG::crypto.RSA2048Decrypt(dk3_, data.subspan<Key3Offset, 256>(), true); // decrypt DK3
+    } else if (entry.id == 0x20) { // IMAGE_KEY; IV_KEY
+        if (data.size() < 256) {
+            return;
+        }
+        DecryptImageKey(entry, data.first<256>());
+        // ekpfs key to get data and tweak keys.
+        PKG::crypto.RSA2048Decrypt(ekpfsKey, imgKey, false);
     }
+}
 
+void PKG::DecryptImageKey(const PKGEntry& entry, std::span<const u8, 256> data) {
+    std::array<u8, 256> imgkeydata;
+    std::memcpy(imgkeydata.data(), data.data(), imgkeydata.size());
+
+    // The Concatenated iv + dk3 imagekey for HASH256
+    std::array<u8, 64> concatenated_ivkey_dk3;
+    const auto raw_entry = Common::EncodeBigEndian(entry);
+    std::memcpy(concatenated_ivkey_dk3.data(), raw_entry.data(), raw_entry.size());
+    std::memcpy(concatenated_ivkey_dk3.data() + sizeof(entry), dk3_.data(), sizeof(dk3_));
+
+    PKG::crypto.ivKeyHASH256(concatenated_ivkey_dk3, ivKey); // ivkey_
+    // imgkey_ to use for last step to get ekpfs
+    PKG::crypto.aesCbcCfb128Decrypt(ivKey, imgkeydata, imgKey);
+}
+
+bool PKG::LoadPFSImage(const Common::FS::IOFile& file, std::string& failreason,
+                       size_t max_threads) {
     // Read the seed
     std::array<u8, 16> seed;
     if (!file.Seek(pkgheader.pfs_image_offset + 0x370)) {
@@ -294,21 +594,33 @@ bool PKG::Extract(const std::filesystem::path& filepath, const std::filesystem::
     PKG::crypto.PfsGenCryptoKey(ekpfsKey, seed, dataKey, tweakKey);
     const u32 length = pkgheader.pfs_cache_size * 0x2; // Seems to be ok.
 
+    // The cached part of the image is the largest single allocation, account it against the
+    // memory budget and decrypt it in place instead of keeping three copies around.
+    const auto reservation = bufferPool->Reserve(length);
+    if (!reservation) {
+        failreason = "PFS cache does not fit in the memory budget";
+        return false;
+    }
+
     int num_blocks = 0;
-    std::vector<u8> pfsc(length);
+    std::vector<u8> pfs_image;
+    std::span<const u8> pfsc;
     if (length != 0) {
         // Read encrypted pfs_image
-        std::vector<u8> pfs_encrypted(length);
+        pfs_image.resize(length);
         file.Seek(pkgheader.pfs_image_offset);
-        file.Read(pfs_encrypted);
-        file.Close();
-        // Decrypt the pfs_image.
-        std::vector<u8> pfs_decrypted(length);
-        PKG::crypto.decryptPFS(dataKey, tweakKey, pfs_encrypted, pfs_decrypted, 0);
+        file.Read(pfs_image);
+
+        // Decrypt the pfs_image, XTS sectors are independent so this can be done in place.
+        PKG::crypto.decryptPFS(dataKey, tweakKey, pfs_image, pfs_image, 0);
 
         // Retrieve PFSC from decrypted pfs_image.
-        pfsc_offset = GetPFSCOffset(pfs_decrypted.data(), pfs_decrypted.size());
-        std::memcpy(pfsc.data(), pfs_decrypted.data() + pfsc_offset, length - pfsc_offset);
+        pfsc_offset = GetPFSCOffset(pfs_image.data(), pfs_image.size());
+        if (pfsc_offset >= length) {
+            failreason = "PFSC magic not found in PFS image";
+            return false;
+        }
+        pfsc = std::span<const u8>(pfs_image).subspan(pfsc_offset);
 
         PFSCHdr pfsChdr;
         std::memcpy(&pfsChdr, pfsc.data(), sizeof(pfsChdr));
@@ -321,144 +633,231 @@ bool PKG::Extract(const std::filesystem::path& filepath, const std::filesystem::
         }
     }
 
-    u32 ent_size = 0;
-    u32 ndinode = 0;
-    int ndinode_counter = 0;
-    bool dinode_reached = false;
-    bool uroot_reached = false;
-    std::vector<char> compressedData;
-    std::vector<char> decompressedData(0x10000);
-
-    // Get iNdoes and Dirents.
-    simple_log("[DEBUG] Inizio parsing blocchi PFS, num_blocks: " + std::to_string(num_blocks));
-    for (int i = 0; i < num_blocks; i++) {
-        const u64 sectorOffset = sectorMap[i];
-        const u64 sectorSize = sectorMap[i + 1] - sectorOffset;
-
-        compressedData.resize(sectorSize);
-        std::memcpy(compressedData.data(), pfsc.data() + sectorOffset, sectorSize);
+    if (num_blocks == 0) {
+        failreason = "PFSC image has no blocks";
+        return false;
+    }
 
-        if (sectorSize == 0x10000) // Uncompressed data
-            std::memcpy(decompressedData.data(), compressedData.data(), 0x10000);
-        else if (sectorSize < 0x10000) // Compressed data
-            DecompressPFSC(compressedData.data(), compressedData.size(), decompressedData.data(), decompressedData.size());
+    return ParseFileSystem(pfsc, failreason, max_threads);
+}
 
-        if (i == 0) {
-            std::memcpy(&ndinode, decompressedData.data() + 0x30, 4); // number of folders and files
-            simple_log("[DEBUG] ndinode (num folder/file): " + std::to_string(ndinode));
+bool PKG::ParseFileSystem(std::span<const u8> pfsc, std::string& failreason,
+                          size_t max_threads) {
+    static constexpr u64 BlockSize = 0x10000;
+    static constexpr u64 InodeSize = 0xA8;
+    static constexpr u64 InodesPerBlock = BlockSize / InodeSize;
+
+    const u64 num_blocks = sectorMap.size() - 1;
+
+    // Metadata blocks normally live in the cached part of the image, anything past it has to
+    // be fetched from the PKG like regular file data.
+    // Scratch space comes from the pool so the parallel passes below stay inside the budget.
+    const auto inflate_block = [&](u64 block, const Common::BufferPool::Buffer& buffer) {
+        const BlockScratch scratch = SplitBlockScratch(buffer.span());
+        const u64 sectorOffset = sectorMap[block];
+        const u64 sectorSize = sectorMap[block + 1] - sectorOffset;
+        if (sectorOffset + sectorSize > pfsc.size()) {
+            ReadPFSCBlock(sharedPkgFile, block, scratch.pfsc, scratch.decrypted, scratch.decompressed);
+            return scratch.decompressed;
+        }
+        char* compressed = reinterpret_cast<char*>(const_cast<u8*>(pfsc.data())) + sectorOffset;
+        if (sectorSize == BlockSize) { // Uncompressed data
+            std::memcpy(scratch.decompressed.data(), compressed, BlockSize);
+        } else if (sectorSize < BlockSize) { // Compressed data
+            DecompressPFSC(compressed, sectorSize, scratch.decompressed.data(),
+                           scratch.decompressed.size());
         }
+        return scratch.decompressed;
+    };
 
-        int occupied_blocks =
-            (ndinode * 0xA8) / 0x10000; // how many blocks(0x10000) are taken by iNodes.
-        if (((ndinode * 0xA8) % 0x10000) != 0)
-            occupied_blocks += 1;
+    // Block 0 holds the superblock of the inner image, which tells us exactly where the
+    // inode table ends and which inode is the super root.
+    PSFHeader_ header;
+    {
+        const auto buffer = bufferPool->Acquire();
+        std::memcpy(&header, inflate_block(0, buffer).data(), sizeof(header));
+    }
 
-        if (i >= 1 && i <= occupied_blocks) { // Get all iNodes, gives type, file size and location.
-            for (int p = 0; p < 0x10000; p += 0xA8) {
-                Inode node;
-                std::memcpy(&node, &decompressedData[p], sizeof(node));
-                if (node.Mode == 0) {
-                    break;
-                }
-                iNodeBuf.push_back(node);
-                simple_log("[DEBUG] iNode aggiunto: Mode=" + std::to_string(node.Mode));
-            }
+    const u64 ndinode = header.dinode_count;
+    u64 inode_blocks = header.dinode_block_count;
+    if (inode_blocks == 0) {
+        inode_blocks = (ndinode + InodesPerBlock - 1) / InodesPerBlock;
+    }
+    if (ndinode == 0 || inode_blocks >= num_blocks || ndinode > inode_blocks * InodesPerBlock) {
+        failreason = "Invalid PFS superblock";
+        return false;
+    }
+    LOG_DEBUG(Loader, "ndinode (folders and files): {}, inode blocks: {}", ndinode, inode_blocks);
+
+    // Get all iNodes, gives type, file size and location. Every block is independent.
+    iNodeBuf.assign(inode_blocks * InodesPerBlock, Inode{});
+    Common::ParallelFor(inode_blocks, [&](size_t i) {
+        const auto buffer = bufferPool->Acquire();
+        const auto block = inflate_block(1 + i, buffer);
+        for (u64 p = 0; p < InodesPerBlock; p++) {
+            std::memcpy(&iNodeBuf[i * InodesPerBlock + p], block.data() + p * InodeSize,
+                        sizeof(Inode));
         }
-
-        // let's deal with the root/uroot entries here.
-        // Sometimes it's more than 2 entries (Tomb Raider Remastered)
-        const std::string_view flat_path_table(&decompressedData[0x10], 15);
-        if (flat_path_table == "flat_path_table") {
-            uroot_reached = true;
-            simple_log("[DEBUG] flat_path_table trovato, uroot_reached=true");
-        }
-
-        if (uroot_reached) {
-            for (int i = 0; i < 0x10000; i += ent_size) {
-                Dirent dirent;
-                std::memcpy(&dirent, &decompressedData[i], sizeof(dirent));
-                ent_size = dirent.entsize;
-                simple_log("[DEBUG] Dirent uroot: ino=" + std::to_string(dirent.ino) + ", entsize=" + std::to_string(dirent.entsize));
-                if (dirent.ino != 0) {
-                    ndinode_counter++;
-                } else {
-                    // Set the the folder according to the current inode.
-                    // Can be 2 or more (rarely)
-                    auto parent_path = extract_path.parent_path();
-                    auto title_id = GetTitleID();
-
-                    if (parent_path.filename() != title_id &&
-                        !fmt::UTF(extract_path.u8string()).data.ends_with("-UPDATE")) {
-                        extractPaths[ndinode_counter] = parent_path / title_id;
-                    } else {
-                        // DLCs path has different structure
-                        extractPaths[ndinode_counter] = extract_path;
-                    }
-                    uroot_reached = false;
-                    break;
-                }
-            }
+    }, max_threads);
+    iNodeBuf.resize(ndinode);
+
+    // Every directory inode points at its own run of dirent blocks, so the directory listings
+    // can be inflated in parallel without scanning the image for them.
+    struct DirBlock {
+        u32 inode;
+        u64 block;
+        std::vector<pfs_fs_table> entries;
+    };
+    std::vector<DirBlock> dir_blocks;
+    for (u32 ino = 0; ino < iNodeBuf.size(); ino++) {
+        const Inode& node = iNodeBuf[ino];
+        if ((node.Mode & InodeMode::dir) == 0) {
+            continue;
         }
+        if (u64(node.loc) + node.Blocks > num_blocks) {
+            failreason = "Directory inode points outside of the PFSC image";
+            return false;
+        }
+        for (u32 j = 0; j < node.Blocks; j++) {
+            dir_blocks.push_back({ino, u64(node.loc) + j, {}});
+        }
+    }
 
-        const char dot = decompressedData[0x10];
-        const std::string_view dotdot(&decompressedData[0x28], 2);
-        if (dot == '.' && dotdot == "..") {
-            dinode_reached = true;
-            simple_log("[DEBUG] dinode_reached=true");
+    Common::ParallelFor(dir_blocks.size(), [&](size_t i) {
+        const auto buffer = bufferPool->Acquire();
+        const auto block = inflate_block(dir_blocks[i].block, buffer);
+        for (u64 off = 0; off + 16 <= BlockSize;) {
+            Dirent dirent;
+            std::memcpy(&dirent, block.data() + off, 16);
+            if (dirent.ino == 0 || dirent.entsize <= 0 || dirent.namelen < 0 ||
+                off + 16 + dirent.namelen > BlockSize) {
+                break;
+            }
+            auto& table = dir_blocks[i].entries.emplace_back();
+            table.name = std::string(block.data() + off + 16, dirent.namelen);
+            table.inode = dirent.ino;
+            table.type = dirent.type;
+            off += dirent.entsize;
         }
+    }, max_threads);
 
-        // Get folder and file names.
-        bool end_reached = false;
-        if (dinode_reached) {
-            for (int j = 0; j < 0x10000; j += ent_size) { // Skip the first parent and child.
-                Dirent dirent;
-                std::memcpy(&dirent, &decompressedData[j], sizeof(dirent));
+    dirTable.clear();
+    for (auto& dir_block : dir_blocks) {
+        auto& entries = dirTable[dir_block.inode];
+        entries.insert(entries.end(), std::make_move_iterator(dir_block.entries.begin()),
+                       std::make_move_iterator(dir_block.entries.end()));
+    }
 
-                // Stop here and continue the main loop
-                if (dirent.ino == 0) {
-                    simple_log("[DEBUG] Dirent.ino==0, break ciclo");
-                    break;
-                }
+    // The super root only holds flat_path_table and uroot, the latter is the real root.
+    bool uroot_found = false;
+    for (const auto& table : dirTable[static_cast<u32>(header.superroot_ino)]) {
+        if (table.name == "uroot" && table.type == PFS_DIR) {
+            urootInode = table.inode;
+            uroot_found = true;
+            break;
+        }
+    }
+    if (!uroot_found) {
+        failreason = "uroot directory not found in PFS super root";
+        return false;
+    }
+    LOG_DEBUG(Loader, "Inodes read: {}, directory blocks: {}", iNodeBuf.size(), dir_blocks.size());
+    return AssignExtractPaths(failreason);
+}
 
-                ent_size = dirent.entsize;
-                auto& table = fsTable.emplace_back();
-                table.name = std::string(dirent.name, dirent.namelen);
-                table.inode = dirent.ino;
-                table.type = dirent.type;
-                simple_log("[DEBUG] fsTable aggiunta: nome=" + table.name + ", inode=" + std::to_string(table.inode) + ", type=" + std::to_string(table.type));
+bool PKG::AssignExtractPaths(std::string& failreason) {
+    extractPaths.clear();
 
-                if (table.type == PFS_CURRENT_DIR) {
-                    current_dir = extractPaths[table.inode];
-                }
-                extractPaths[table.inode] = extract_path / (current_dir / std::filesystem::path(table.name));
-
-                if (table.type == PFS_FILE || table.type == PFS_DIR) {
-                    if (table.type == PFS_DIR) { // Create dirs.
-                        std::filesystem::create_directories(extractPaths[table.inode]);
-                    }
-                    ndinode_counter++;
-                    if ((ndinode_counter + 1) == ndinode) // 1 for the image itself (root).
-                        end_reached = true;
-                }
+    // Set the the folder according to the current inode.
+    const auto parent_path = extract_path.parent_path();
+    const auto title_id = GetTitleID();
+    if (parent_path.filename() != title_id &&
+        !fmt::UTF(extract_path.u8string()).data.ends_with("-UPDATE")) {
+        root_path = parent_path / title_id;
+    } else {
+        // DLCs path has different structure
+        root_path = extract_path;
+    }
+    extractPaths[urootInode] = root_path;
+
+    // Walk the tree from uroot, naming each inode after its parent directory.
+    fsTable.clear();
+    std::vector<bool> visited(iNodeBuf.size(), false);
+    std::vector<u32> pending{urootInode};
+    visited[urootInode] = true;
+    while (!pending.empty()) {
+        const u32 dir_ino = pending.back();
+        pending.pop_back();
+        const auto dir_path = extractPaths[dir_ino];
+        for (const auto& table : dirTable[dir_ino]) {
+            if (table.inode >= iNodeBuf.size()) {
+                failreason = "Dirent references an invalid inode";
+                return false;
             }
-            if (end_reached) {
-                simple_log("[DEBUG] end_reached=true, break ciclo blocchi");
-                break;
+            fsTable.push_back(table);
+            if (table.type != PFS_FILE && table.type != PFS_DIR) {
+                continue;
+            }
+            extractPaths[table.inode] = dir_path / std::filesystem::path(table.name);
+            if (table.type == PFS_DIR && !visited[table.inode]) {
+                visited[table.inode] = true;
+                pending.push_back(table.inode);
             }
         }
     }
-    simple_log("[DEBUG] Fine parsing blocchi PFS");
+    LOG_DEBUG(Loader, "Entries: {}", fsTable.size());
     return true;
 }
 
-void PKG::ExtractAllFilesWithProgress() {
-    const size_t num_files = fsTable.size();
-    const size_t max_threads = std::min<size_t>(8, std::thread::hardware_concurrency());
+std::vector<PKGFileInfo> PKG::GetFiles() const {
+    std::vector<PKGFileInfo> files;
+    for (const auto& table : fsTable) {
+        if (table.type != PFS_FILE) {
+            continue;
+        }
+        const auto it = extractPaths.find(table.inode);
+        if (it == extractPaths.end()) {
+            continue;
+        }
+        const Inode& node = iNodeBuf[table.inode];
+        files.push_back({it->second.lexically_relative(root_path), table.inode,
+                         static_cast<u64>(node.Size), node.loc, node.Blocks});
+    }
+    return files;
+}
+
+bool PKG::ExtractAllFilesWithProgress(std::string& failreason) {
+    std::vector<u32> indices(fsTable.size());
+    for (u32 i = 0; i < indices.size(); i++) {
+        indices[i] = i;
+    }
+    return ExtractFilesWithProgress(indices, failreason);
+}
+
+bool PKG::ExtractFilesWithProgress(std::span<const u32> indices, std::string& failreason) {
+    const size_t num_files = indices.size();
     std::atomic<size_t> files_done{0};
+    std::atomic<bool> cancelled{false};
+    std::atomic<size_t> write_errors{0};
     std::mutex print_mutex;
 
+    // Batched files fail when the batch is flushed, the batch knows which ones they were.
+    const auto report_failures = [&](Common::FS::FileWriter::Batch& batch) {
+        for (const auto& path : batch.TakeFailures()) {
+            LOG_ERROR(Loader, "Failed to write {}", Common::FS::PathToUTF8String(path));
+            write_errors++;
+        }
+    };
+
     auto print_progress = [&](size_t done) {
-        float percent = (float)done / (float)num_files * 100.0f;
+        if (progressCallback) {
+            std::lock_guard<std::mutex> lock(print_mutex);
+            if (!progressCallback(done, num_files)) {
+                cancelled = true;
+            }
+            return;
+        }
+        float percent = num_files ? (float)done / (float)num_files * 100.0f : 100.0f;
         int barWidth = 40;
         int pos = (int)(barWidth * percent / 100.0f);
         std::ostringstream oss;
@@ -471,126 +870,377 @@ void PKG::ExtractAllFilesWithProgress() {
         std::cout << "\r" << std::string(80, ' ') << "\r" << oss.str() << std::flush;
     };
 
-    auto extract_worker = [&](size_t start, size_t end) {
-        for (size_t i = start; i < end; ++i) {
-            ExtractFiles(i);
-            size_t done = ++files_done;
-            if (done % 1 == 0 || done == num_files) print_progress(done);
+    // Files are handed out one by one in list order, so a prioritised list is also extracted
+    // roughly in that order. Each worker holds one pool buffer, a tight budget means fewer of
+    // them. Small files are batched per worker and only counted once they are on disk.
+    const size_t num_workers = Common::GetWorkerCount(
+        num_files, std::min(MaxExtractWorkers, bufferPool->GetMaxBuffers()));
+    std::atomic<size_t> next{0};
+    Common::ParallelFor(
+        num_workers,
+        [&](size_t) {
+            Common::FS::FileWriter::Batch batch{*fileWriter};
+            size_t unreported = 0;
+            for (size_t i = next++; i < num_files && !cancelled; i = next++) {
+                if (!ExtractFiles(indices[i], &batch)) {
+                    write_errors++;
+                }
+                report_failures(batch);
+                unreported++;
+                if (batch.Empty()) {
+                    print_progress(files_done += std::exchange(unreported, 0));
+                }
+            }
+            batch.Flush();
+            report_failures(batch);
+            if (unreported != 0) {
+                print_progress(files_done += unreported);
+            }
+        },
+        num_workers);
+    if (cancelled) {
+        failreason.clear();
+        return false;
+    }
+    print_progress(num_files);
+    if (!progressCallback) {
+        std::cout << std::endl;
+    }
+    if (write_errors != 0) {
+        failreason = fmt::format("Failed to write {} files", write_errors.load());
+        LOG_ERROR(Loader, "{}", failreason);
+        return false;
+    }
+    return true;
+}
+
+bool PKG::VerifyFiles(u64& bad_blocks, const ProgressCallback& progress, size_t max_threads) {
+    const auto files = GetFiles();
+    std::atomic<u64> failures{0};
+    std::atomic<u64> done{0};
+    std::atomic<bool> cancelled{false};
+    std::mutex progress_mutex;
+
+    Common::ParallelFor(
+        files.size(),
+        [&](size_t i) {
+            if (cancelled) {
+                return;
+            }
+            const PKGFileInfo& file = files[i];
+            const auto buffer = bufferPool->Acquire();
+            const BlockScratch scratch = SplitBlockScratch(buffer.span());
+            for (u32 j = 0; j < file.num_blocks && !cancelled; j++) {
+                const auto stored = ReadCompressedBlock(sharedPkgFile, file.first_block + j,
+                                                        scratch.pfsc, scratch.decrypted);
+                if (!InflateBlock(stored, scratch.decompressed)) {
+                    failures++;
+                }
+            }
+            const u64 now = ++done;
+            if (progress) {
+                std::scoped_lock lock{progress_mutex};
+                if (!progress(now, files.size())) {
+                    cancelled = true;
+                }
+            }
+        },
+        max_threads ? std::min(max_threads, bufferPool->GetMaxBuffers())
+                    : bufferPool->GetMaxBuffers());
+
+    bad_blocks = failures;
+    return !cancelled;
+}
+
+bool PKG::PlanPlayGoExtraction(u64 language_mask, PlayGoExtractPlan& plan,
+                               std::string& failreason) const {
+    plan = {};
+    PlaygoFile playgo_file;
+    if (playgo.empty() || !playgo_file.Open(playgo)) {
+        failreason = "PKG has no valid playgo-chunk.dat";
+        return false;
+    }
+    const auto& chunks = playgo_file.chunks;
+
+    // Rank of each chunk in the default scenario, chunks outside of it go last.
+    const u32 unranked = static_cast<u32>(playgo_file.scenario_chunks.size());
+    std::vector<u32> chunk_rank(chunks.size(), unranked);
+    for (u32 i = 0; i < playgo_file.scenario_chunks.size(); i++) {
+        const u16 chunk_id = playgo_file.scenario_chunks[i];
+        if (chunk_id < chunks.size()) {
+            chunk_rank[chunk_id] = std::min(chunk_rank[chunk_id], i);
+        }
+    }
+    const auto wanted = [&](const PlaygoChunk& chunk) {
+        return language_mask == 0 || chunk.language_mask == 0 ||
+               (chunk.language_mask & language_mask) != 0;
+    };
+
+    // mchunk offsets are relative to the PFS image, like pfsc_offset + sectorMap[block].
+    struct Range {
+        u64 begin;
+        u64 end;
+        u16 chunk;
+    };
+    std::vector<Range> ranges;
+    for (u16 id = 0; id < chunks.size(); id++) {
+        for (const auto& mchunk : chunks[id].mchunks) {
+            if (mchunk.image_no == 0 && mchunk.size != 0) {
+                ranges.push_back({mchunk.offset, mchunk.offset + mchunk.size, id});
+            }
         }
+    }
+    std::ranges::sort(ranges, {}, &Range::begin);
+
+    struct Candidate {
+        u32 rank;
+        u32 index;
     };
+    std::vector<Candidate> candidates;
+    const u64 num_blocks = sectorMap.size() - 1;
+    for (u32 index = 0; index < fsTable.size(); index++) {
+        const auto& table = fsTable[index];
+        if (table.type != PFS_FILE) {
+            continue;
+        }
+        const Inode& node = iNodeBuf[table.inode];
+        if (node.Blocks == 0 || u64(node.loc) + node.Blocks > num_blocks) {
+            candidates.push_back({unranked + 1, index});
+            continue;
+        }
+        const u64 begin = pfsc_offset + sectorMap[node.loc];
+        const u64 end = pfsc_offset + sectorMap[node.loc + node.Blocks];
+
+        u32 rank = unranked + 1;
+        bool in_chunk = false;
+        bool in_wanted_chunk = false;
+        auto it = std::ranges::upper_bound(ranges, begin, {}, &Range::begin);
+        if (it != ranges.begin()) {
+            --it;
+        }
+        // Walk back over ranges that started earlier but still overlap the file.
+        while (it != ranges.begin() && std::prev(it)->end > begin) {
+            --it;
+        }
+        for (; it != ranges.end() && it->begin < end; ++it) {
+            if (it->end <= begin) {
+                continue;
+            }
+            in_chunk = true;
+            if (wanted(chunks[it->chunk])) {
+                in_wanted_chunk = true;
+                rank = std::min(rank, chunk_rank[it->chunk]);
+            }
+        }
+        if (in_chunk && !in_wanted_chunk) {
+            plan.skipped_files++;
+            plan.skipped_bytes += static_cast<u64>(node.Size);
+            continue;
+        }
+        if (rank < playgo_file.initial_chunk_count) {
+            plan.initial_files++;
+        }
+        candidates.push_back({rank, index});
+    }
 
-    std::vector<std::thread> threads;
-    size_t batch = (num_files + max_threads - 1) / max_threads;
-    for (size_t t = 0; t < max_threads; ++t) {
-        size_t start = t * batch;
-        size_t end = std::min(num_files, start + batch);
-        if (start < end)
-            threads.emplace_back(extract_worker, start, end);
+    std::ranges::stable_sort(candidates, {}, &Candidate::rank);
+    plan.order.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+        plan.order.push_back(candidate.index);
     }
-    for (auto& th : threads) th.join();
-    print_progress(num_files);
-    std::cout << std::endl;
+    return true;
+}
+
+std::span<const u8> PKG::ReadCompressedBlock(const Common::FS::IOFile& pkgFile, u64 block,
+                                             std::span<u8> pfsc_buf,
+                                             std::span<u8> pfs_decrypted) {
+    u64 sectorOffset = sectorMap[block]; // offset into PFSC_image and not pfs_image.
+    u64 sectorSize = sectorMap[block + 1] - sectorOffset; // indicates if data is compressed or not.
+    u64 fileOffset = (pkgheader.pfs_image_offset + pfsc_offset + sectorOffset);
+    u64 currentSector1 =
+        (pfsc_offset + sectorOffset) / 0x1000; // block size is 0x1000 for xts decryption.
+
+    u64 sectorOffsetMask = (sectorOffset + pfsc_offset) & ~u64(0xFFF);
+    u64 previousData = (sectorOffset + pfsc_offset) - sectorOffsetMask;
+
+    // Compressed blocks are often much smaller than 0x10000, only the sectors that hold the
+    // block are read and decrypted, as one run.
+    const u64 storedSize = std::min<u64>(sectorSize, 0x10000);
+    const u64 runSize = std::min<u64>(Common::AlignUp(previousData + storedSize, 0x1000),
+                                      pfsc_buf.size());
+
+    pkgFile.ReadAt(fileOffset - previousData, pfsc_buf.first(runSize));
+
+    PKG::crypto.decryptPFS(dataKey, tweakKey, pfsc_buf.first(runSize), pfs_decrypted,
+                           currentSector1);
+
+    return pfs_decrypted.subspan(previousData, storedSize);
+}
+
+bool PKG::InflateBlock(std::span<const u8> stored, std::span<char> decompressed) {
+    char* compressedData = reinterpret_cast<char*>(const_cast<u8*>(stored.data()));
+    if (stored.size() == 0x10000) { // Uncompressed data
+        std::memcpy(decompressed.data(), compressedData, 0x10000);
+        return true;
+    }
+    // Compressed data
+    return DecompressPFSC(compressedData, stored.size(), decompressed.data(), decompressed.size());
 }
 
-void PKG::ExtractFiles(const int index) {
+u64 PKG::ReadFile(const PKGFileInfo& file, u64 offset, std::span<u8> out,
+                  const Common::FS::IOFile& pkgFile) {
+    if (offset >= file.size) {
+        return 0;
+    }
+    const u64 size = std::min<u64>(out.size(), file.size - offset);
+    const auto buffer = bufferPool->Acquire();
+    const BlockScratch scratch = SplitBlockScratch(buffer.span());
+
+    u64 done = 0;
+    while (done < size) {
+        const u64 pos = offset + done;
+        const u64 block = pos / PFSCBlockSize;
+        const u64 in_block = pos % PFSCBlockSize;
+        if (block >= file.num_blocks) {
+            break;
+        }
+        ReadPFSCBlock(pkgFile, file.first_block + block, scratch.pfsc, scratch.decrypted,
+                      scratch.decompressed);
+        const u64 count = std::min<u64>(PFSCBlockSize - in_block, size - done);
+        std::memcpy(out.data() + done, scratch.decompressed.data() + in_block, count);
+        done += count;
+    }
+    return done;
+}
+
+bool PKG::ExtractFileTo(const PKGFileInfo& file, const std::filesystem::path& dest) {
+    Common::FS::IOFile out(dest, Common::FS::FileAccessMode::Write);
+    if (!out.IsOpen() || !sharedPkgFile.IsOpen()) {
+        return false;
+    }
+    const auto buffer = bufferPool->Acquire();
+    const BlockScratch scratch = SplitBlockScratch(buffer.span());
+
+    u64 remaining = file.size;
+    for (u32 j = 0; j < file.num_blocks && remaining != 0; j++) {
+        const auto stored = ReadCompressedBlock(sharedPkgFile, file.first_block + j, scratch.pfsc,
+                                                scratch.decrypted);
+        if (!InflateBlock(stored, scratch.decompressed)) {
+            return false;
+        }
+        const u64 count = std::min<u64>(remaining, PFSCBlockSize);
+        if (out.WriteRaw<char>(scratch.decompressed.data(), count) != count) {
+            return false;
+        }
+        remaining -= count;
+    }
+    return remaining == 0;
+}
+
+void PKG::ReadPFSCBlock(const Common::FS::IOFile& pkgFile, u64 block, std::span<u8> pfsc_buf,
+                        std::span<u8> pfs_decrypted, std::span<char> decompressed) {
+    InflateBlock(ReadCompressedBlock(pkgFile, block, pfsc_buf, pfs_decrypted), decompressed);
+}
+
+bool PKG::ExtractFiles(const int index, Common::FS::FileWriter::Batch* batch) {
     int inode_number = fsTable[index].inode;
     int inode_type = fsTable[index].type;
     std::string inode_name = fsTable[index].name;
-    std::cout << "[DEBUG] ExtractFiles: index=" << index << ", inode=" << inode_number << ", type=" << inode_type << ", name=" << inode_name << std::endl;
-    if (extractPaths.count(inode_number)) {
-        std::cout << "[DEBUG] Path: " << extractPaths[inode_number] << std::endl;
-    } else {
-        std::cout << "[DEBUG] Path: (not found in extractPaths)" << std::endl;
-    }
+    LOG_DEBUG(Loader, "ExtractFiles: index={}, inode={}, type={}, name={}", index, inode_number,
+              inode_type, inode_name);
     if (inode_type == PFS_FILE) {
-        // Creo la directory di destinazione solo per il file che sto per scrivere
-        try {
-            std::filesystem::create_directories(extractPaths[inode_number].parent_path());
-        } catch (const std::exception& e) {
-            simple_log(std::string("[ERROR] Creazione directory fallita: ") + e.what());
-        }
+        const std::filesystem::path& outpath = extractPaths[inode_number];
         int sector_loc = iNodeBuf[inode_number].loc;
         int nblocks = iNodeBuf[inode_number].Blocks;
         int bsize = iNodeBuf[inode_number].Size;
 
-        Common::FS::IOFile inflated;
-        inflated.Open(extractPaths[inode_number], Common::FS::FileAccessMode::Write);
-
-        Common::FS::IOFile pkgFile; // Open the file for each iteration to avoid conflict.
-        pkgFile.Open(pkgpath, Common::FS::FileAccessMode::Read);
+        // A file of at most one block is written whole, through the batch when there is one.
+        // Bigger ones stream through the writer's buffer, one write per buffer, not per block.
+        bool write_ok = true;
+        const auto write_whole = [&](std::span<const u8> data) {
+            if (batch) {
+                // Failures, of this file or of the queued ones it flushed, stay in the batch.
+                batch->Add(outpath, data);
+            } else {
+                write_ok = fileWriter->WriteFile(outpath, data);
+            }
+        };
+        Common::FS::FileWriter::File inflated;
+        if (nblocks > 1) {
+            inflated = fileWriter->Create(outpath);
+            write_ok = inflated.IsOpen();
+        } else if (nblocks == 0) {
+            write_whole({});
+        }
 
         int size_decompressed = 0;
-        std::vector<char> compressedData;
-        std::vector<char> decompressedData(0x10000);
-
-        u64 pfsc_buf_size = 0x11000; // extra 0x1000
-        std::vector<u8> pfsc(pfsc_buf_size);
-        std::vector<u8> pfs_decrypted(pfsc_buf_size);
+        // One pool buffer holds the read, decrypt and inflate buffers of this file.
+        const auto buffer = bufferPool->Acquire();
+        const BlockScratch scratch = SplitBlockScratch(buffer.span());
+        const std::span<char> decompressedData = scratch.decompressed;
+
+        // Hash the blocks while they are still in memory so the manifest needs no second pass.
+        std::optional<StreamHasher> hasher;
+        if (manifestAlgorithm) {
+            hasher.emplace(*manifestAlgorithm, manifestTree, nblocks);
+        }
 
         for (int j = 0; j < nblocks; j++) {
-            u64 sectorOffset =
-                sectorMap[sector_loc + j]; // offset into PFSC_image and not pfs_image.
-            u64 sectorSize = sectorMap[sector_loc + j + 1] -
-                             sectorOffset; // indicates if data is compressed or not.
-            u64 fileOffset = (pkgheader.pfs_image_offset + pfsc_offset + sectorOffset);
-            u64 currentSector1 =
-                (pfsc_offset + sectorOffset) / 0x1000; // block size is 0x1000 for xts decryption.
-
-            int sectorOffsetMask = (sectorOffset + pfsc_offset) & 0xFFFFF000;
-            int previousData = (sectorOffset + pfsc_offset) - sectorOffsetMask;
-
-            pkgFile.Seek(fileOffset - previousData);
-            pkgFile.Read(pfsc);
-
-            PKG::crypto.decryptPFS(dataKey, tweakKey, pfsc, pfs_decrypted, currentSector1);
-
-            compressedData.resize(sectorSize);
-            std::memcpy(compressedData.data(), pfs_decrypted.data() + previousData, sectorSize);
-
-            if (sectorSize == 0x10000) // Uncompressed data
-                std::memcpy(decompressedData.data(), compressedData.data(), 0x10000);
-            else if (sectorSize < 0x10000) // Compressed data
-                DecompressPFSC(compressedData.data(), compressedData.size(), decompressedData.data(), decompressedData.size());
+            ReadPFSCBlock(sharedPkgFile, sector_loc + j, scratch.pfsc, scratch.decrypted,
+                          decompressedData);
 
             size_decompressed += 0x10000;
 
-            if (j < nblocks - 1) {
-                inflated.WriteRaw<u8>(reinterpret_cast<const u8*>(decompressedData.data()), decompressedData.size());
-            } else {
+            u32 write_size = decompressedData.size();
+            if (j == nblocks - 1) {
                 // This is to remove the zeros at the end of the file.
-                const u32 write_size = decompressedData.size() - (size_decompressed - bsize);
-                inflated.WriteRaw<u8>(reinterpret_cast<const u8*>(decompressedData.data()), write_size);
+                write_size = decompressedData.size() - (size_decompressed - bsize);
             }
+            const std::span<const u8> data{reinterpret_cast<const u8*>(decompressedData.data()),
+                                           write_size};
+            if (nblocks == 1) {
+                write_whole(data);
+            } else if (inflated.IsOpen()) {
+                inflated.Write(data);
+            }
+            if (hasher) {
+                hasher->Update(j, data);
+            }
+        }
+        if (inflated.IsOpen()) {
+            write_ok = inflated.Close();
         }
-        pkgFile.Close();
-        inflated.Close();
+        if (!write_ok) {
+            LOG_ERROR(Loader, "Failed to write {}", Common::FS::PathToUTF8String(outpath));
+        }
+
+        if (hasher) {
+            HashManifestEntry entry{extractPaths[inode_number].lexically_relative(root_path),
+                                    static_cast<u64>(iNodeBuf[inode_number].Size),
+                                    hasher->Finish()};
+            std::scoped_lock lock{manifestMutex};
+            manifest.push_back(std::move(entry));
+        }
+        return write_ok;
     } else if (inode_name.empty()) {
         // Estrai anche le entry senza nome (unknown)
         std::ostringstream oss;
         oss << "entry_0x" << std::hex << inode_number << ".bin";
         std::filesystem::path outpath = extract_path / oss.str();
-        // Creo la directory di destinazione solo per il file che sto per scrivere
-        try {
-            std::filesystem::create_directories(outpath.parent_path());
-        } catch (const std::exception& e) {
-            simple_log(std::string("[ERROR] Creazione directory fallita: ") + e.what());
-        }
         // Cerca la PKGEntry corrispondente
         for (const auto& entry : pkgEntries) {
             if (entry.id == static_cast<u32>(inode_number)) {
-                Common::FS::IOFile pkgFile;
-                pkgFile.Open(pkgpath, Common::FS::FileAccessMode::Read);
-                pkgFile.Seek(entry.offset);
                 std::vector<u8> data(entry.size);
-                pkgFile.ReadRaw<u8>(data.data(), entry.size);
-                Common::FS::IOFile out(outpath, Common::FS::FileAccessMode::Write);
-                out.WriteRaw<u8>(data.data(), data.size());
-                out.Close();
-                pkgFile.Close();
+                data.resize(sharedPkgFile.ReadAt(entry.offset, data));
+                if (!fileWriter->WriteFile(outpath, data)) {
+                    LOG_ERROR(Loader, "Failed to write {}", Common::FS::PathToUTF8String(outpath));
+                    return false;
+                }
                 break;
             }
         }
     }
+    return true;
 }
 
 std::vector<std::string> PKG::GetFileList() const {
@@ -604,10 +1254,11 @@ std::vector<std::string> PKG::GetFileList() const {
 }
 
 std::vector<std::tuple<std::string, u32, u32>> PKG::GetAllEntries() const {
-    simple_log("[DEBUG] Chiamata GetAllEntries, fsTable size: " + std::to_string(fsTable.size()));
+    LOG_DEBUG(Loader, "GetAllEntries, fsTable size: {}", fsTable.size());
     std::vector<std::tuple<std::string, u32, u32>> entries;
     for (const auto& entry : fsTable) {
-        simple_log("[DEBUG] fsTable entry: nome=" + entry.name + ", inode=" + std::to_string(entry.inode) + ", type=" + std::to_string(entry.type));
+        LOG_DEBUG(Loader, "fsTable entry: name={}, inode={}, type={}", entry.name, entry.inode,
+                  entry.type);
         entries.emplace_back(entry.name, entry.inode, entry.type);
     }
     return entries;
@@ -5,11 +5,20 @@
 
 #include <array>
 #include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
 #include <unordered_map>
 #include <vector>
+#include "common/buffer_pool.h"
 #include "common/endian.h"
+#include "common/file_writer.h"
+#include "common/io_file.h"
 #include "core/crypto/crypto.h"
+#include "core/crypto/stream_hasher.h"
 #include "pfs.h"
 #include "trp.h"
 
@@ -86,30 +95,107 @@ enum class PKGContentFlag {
     CUMULATIVE_PATCH = 0x60000000
 };
 
+// Stored big-endian, tables are decoded with Common::DecodeBigEndian / SwapBigEndian.
 struct PKGEntry {
-    u32_be id;              // File ID, useful for files without a filename entry
-    u32_be filename_offset; // Offset into the filenames table (ID 0x200) where this file's name is
-                            // located
-    u32_be flags1;          // Flags including encrypted flag, etc
-    u32_be flags2;          // Flags including encryption key index, etc
-    u32_be offset;          // Offset into PKG to find the file
-    u32_be size;            // Size of the file
-    u64_be padding;         // blank padding
+    u32 id;              // File ID, useful for files without a filename entry
+    u32 filename_offset; // Offset into the filenames table (ID 0x200) where this file's name is
+                         // located
+    u32 flags1;          // Flags including encrypted flag, etc
+    u32 flags2;          // Flags including encryption key index, etc
+    u32 offset;          // Offset into PKG to find the file
+    u32 size;            // Size of the file
+    u64 padding;         // blank padding
 };
 static_assert(sizeof(PKGEntry) == 32);
 
+template <>
+struct Common::BigEndianLayoutOf<PKGEntry>
+    : Common::BigEndianLayout<u32, u32, u32, u32, u32, u32, u64> {};
+
+/// Extraction order computed from playgo-chunk.dat, see PKG::PlanPlayGoExtraction.
+struct PlayGoExtractPlan {
+    std::vector<u32> order; // fsTable indices, boot files first
+    size_t initial_files = 0;
+    size_t skipped_files = 0;
+    u64 skipped_bytes = 0;
+};
+
+/// One line of the hash manifest written by PKG::WriteHashManifest.
+struct HashManifestEntry {
+    std::filesystem::path path; // relative to the image root
+    u64 size;
+    std::string hash;
+};
+
+/// A regular file of the PFS image, as found by ReadFileSystem or Extract.
+struct PKGFileInfo {
+    std::filesystem::path path; // relative to the image root
+    u32 inode;
+    u64 size;
+    u32 first_block; // first PFSC block of the file
+    u32 num_blocks;
+};
+
 class PKG {
 public:
     PKG();
     ~PKG();
 
     bool Open(const std::filesystem::path& filepath, std::string& failreason);
-    void ExtractFiles(const int index);
+    // Caps the block buffers, the output buffers and the PFS cache used by Extract and
+    // ExtractFiles, 0 = no limit.
+    void SetMemoryBudget(u64 max_bytes);
+    u64 GetPoolPeakUsage() const;
+    // Reads the PKG around the page cache and evicts every extracted file once it is written,
+    // so extracting a huge package doesn't push other services' data out of the cache.
+    void SetDirectIO(bool enable) {
+        directIO = enable;
+    }
+    // Hashes every file extracted by ExtractFiles from the blocks already in memory.
+    void EnableHashManifest(HashAlgorithm algorithm, bool tree);
+    // Writes "<hash>\t<size>\t<path>" lines sorted by path.
+    bool WriteHashManifest(const std::filesystem::path& manifest_path, std::string& failreason);
+    // Writes small files through `batch` when given, otherwise straight away. False when a file
+    // written straight away failed, failures of batched files are kept by the batch.
+    bool ExtractFiles(const int index, Common::FS::FileWriter::Batch* batch = nullptr);
     bool Extract(const std::filesystem::path& filepath, const std::filesystem::path& extract,
                  std::string& failreason);
-    void ExtractAllFilesWithProgress();
+    bool ExtractAllFilesWithProgress(std::string& failreason);
+    // Replaces the console progress bar of the extraction with a callback(done, total).
+    // Returning false from the callback stops handing out files.
+    using ProgressCallback = std::function<bool(u64 done, u64 total)>;
+    void SetProgressCallback(ProgressCallback callback) {
+        progressCallback = std::move(callback);
+    }
+    // Extracts the given fsTable entries, handing them to the workers in the given order.
+    // Returns false when the progress callback cancelled the extraction, with `failreason`
+    // left empty, or when files failed to be written.
+    bool ExtractFilesWithProgress(std::span<const u32> indices, std::string& failreason);
+    /**
+     * Orders the files of the image by the PlayGo chunks holding them: files of the initial
+     * chunks of the default scenario come first so the title can boot as soon as they are out,
+     * then the rest of the scenario. Files only present in chunks whose language mask has no
+     * bit in common with `language_mask` are dropped, 0 keeps every language.
+     */
+    bool PlanPlayGoExtraction(u64 language_mask, PlayGoExtractPlan& plan,
+                              std::string& failreason) const;
+    // Derives the keys and parses the PFS image without writing anything to disk. A later
+    // Extract of the same file reuses the keys and the parsed image instead of redoing them.
+    bool ReadFileSystem(const std::filesystem::path& filepath, std::string& failreason);
+    // ReadFileSystem for many packages at once, paths[i] is read into packages[i]. The RSA
+    // steps of every package go through two Crypto::RSA2048DecryptBatch calls, all the DK3
+    // keys first and then all the EKPFS keys. No more than `max_threads` threads run at once,
+    // parsing included. failreasons[i] stays empty when package i loaded.
+    static void ReadFileSystems(std::span<PKG* const> packages,
+                                std::span<const std::filesystem::path> paths,
+                                std::span<std::string> failreasons, size_t max_threads = 0);
+    // Decrypts and inflates every block of every regular file. `bad_blocks` receives the
+    // blocks that did not inflate, returns false when `progress` cancelled the check.
+    bool VerifyFiles(u64& bad_blocks, const ProgressCallback& progress = {},
+                     size_t max_threads = 0);
 
     std::vector<u8> sfo;
+    std::vector<u8> playgo; // playgo-chunk.dat, filled by Extract
 
     u32 GetNumberOfFiles() {
         return fsTable.size();
@@ -160,7 +246,67 @@ public:
     // Restituisce la lista di tutte le entry (file e directory) con tipo
     std::vector<std::tuple<std::string, u32, u32>> GetAllEntries() const;
 
+    // Regular files of the parsed image, in directory walk order.
+    std::vector<PKGFileInfo> GetFiles() const;
+
+    // Stored size of PFSC block `block`, 0x10000 means the block is not compressed.
+    u64 GetBlockStoredSize(u64 block) const {
+        return sectorMap[block + 1] - sectorMap[block];
+    }
+    // Reads and decrypts PFSC block `block` without inflating it. Both buffers must hold
+    // 0x11000 bytes, the returned span points into `pfs_decrypted`.
+    std::span<const u8> ReadCompressedBlock(const Common::FS::IOFile& pkgFile, u64 block,
+                                            std::span<u8> pfsc_buf, std::span<u8> pfs_decrypted);
+    // Inflates a block returned by ReadCompressedBlock into 0x10000 bytes, false when the
+    // stored data is not a valid zlib stream.
+    static bool InflateBlock(std::span<const u8> stored, std::span<char> decompressed);
+    // Reads up to out.size() bytes of `file` starting at `offset`, returns the bytes read.
+    u64 ReadFile(const PKGFileInfo& file, u64 offset, std::span<u8> out,
+                 const Common::FS::IOFile& pkgFile);
+    // Writes the whole of `file` to `dest`, false when a block does not inflate or the write
+    // fails. Safe to call from several threads at once.
+    bool ExtractFileTo(const PKGFileInfo& file, const std::filesystem::path& dest);
+    const std::filesystem::path& GetPkgPath() const {
+        return pkgpath;
+    }
+    // The package opened by Extract or ReadFileSystem. Reads go through ReadAt, so every
+    // thread can use it at once.
+    const Common::FS::IOFile& GetPkgFile() const {
+        return sharedPkgFile;
+    }
+
 private:
+    // Reads and validates the PKG header, the title id is taken from the content id.
+    bool ReadHeader(const Common::FS::IOFile& file, std::string& failreason);
+    // Reads the payload of every entry of pkgEntries, coalescing reads of neighbouring entries.
+    bool ReadEntryPayloads(const Common::FS::IOFile& file, std::vector<std::vector<u8>>& payloads,
+                           std::string& failreason);
+    // Updates dk3_ (ENTRY_KEYS) or ivKey/imgKey/ekpfsKey (IMAGE_KEY) from an entry payload.
+    void DeriveEntryKeys(const PKGEntry& entry, std::span<const u8> data);
+    // Sets ivKey and imgKey from the IMAGE_KEY payload, dk3_ must be known already.
+    void DecryptImageKey(const PKGEntry& entry, std::span<const u8, 256> data);
+    // The ciphertexts ReadFileSystem needs, the RSA steps themselves are left to the caller.
+    struct KeyEntries {
+        std::array<u8, 256> dk3_ciphertext;
+        PKGEntry image_key_entry;
+        std::array<u8, 256> image_key_data;
+    };
+    // Opens `filepath` for ReadFileSystem, reads the header, the entry table and `keys`.
+    bool ReadKeyEntries(const std::filesystem::path& filepath, KeyEntries& keys,
+                        std::string& failreason);
+    // Derives the PFS keys, reads the sector map and parses the file system on up to
+    // `max_threads` threads.
+    bool LoadPFSImage(const Common::FS::IOFile& file, std::string& failreason,
+                      size_t max_threads = 0);
+    // Reads, decrypts and inflates PFSC block `block` straight from the PKG file.
+    void ReadPFSCBlock(const Common::FS::IOFile& pkgFile, u64 block, std::span<u8> pfsc_buf,
+                       std::span<u8> pfs_decrypted, std::span<char> decompressed);
+    // Builds iNodeBuf and dirTable from the inode and dirent blocks of the image.
+    bool ParseFileSystem(std::span<const u8> pfsc, std::string& failreason,
+                         size_t max_threads = 0);
+    // Builds fsTable and extractPaths by walking dirTable below extract_path.
+    bool AssignExtractPaths(std::string& failreason);
+
     Crypto crypto;
     TRP trp;
     u64 pkgSize = 0;
@@ -173,6 +319,9 @@ private:
     std::vector<Inode> iNodeBuf;
     std::vector<u64> sectorMap;
     u64 pfsc_offset;
+    std::unordered_map<u32, std::vector<pfs_fs_table>> dirTable; // dirents per directory inode
+    u32 urootInode = 0;
+    bool fileSystemLoaded = false; // keys derived and image parsed for pkgpath
 
     std::array<u8, 32> dk3_;
     std::array<u8, 32> ivKey;
@@ -180,11 +329,22 @@ private:
     std::array<u8, 32> ekpfsKey;
     std::array<u8, 16> dataKey;
     std::array<u8, 16> tweakKey;
-    std::vector<u8> decNp;
 
     std::filesystem::path pkgpath;
+    Common::FS::IOFile sharedPkgFile;
     std::filesystem::path current_dir;
     std::filesystem::path extract_path;
+    std::filesystem::path root_path;
 
     std::vector<PKGEntry> pkgEntries;
+    std::unique_ptr<Common::BufferPool> bufferPool;
+    std::unique_ptr<Common::FS::FileWriter> fileWriter; // created by Extract
+    u64 memoryBudget = 0; // shared by bufferPool and fileWriter
+    bool directIO = false;
+    ProgressCallback progressCallback;
+
+    std::optional<HashAlgorithm> manifestAlgorithm;
+    bool manifestTree = false;
+    std::mutex manifestMutex;
+    std::vector<HashManifestEntry> manifest;
 };
@@ -0,0 +1,410 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <unordered_map>
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+#include "common/io_file.h"
+#include "common/mapped_file.h"
+#include "common/parallel_for.h"
+#include "common/path_util.h"
+#include "core/file_format/pkg.h"
+#include "core/file_format/pkg_catalog.h"
+
+namespace {
+
+// Packages whose file systems are read together by PKGCatalog::Update.
+constexpr size_t FileSystemSlice = 256;
+
+struct FileIdentity {
+    u64 size = 0;
+    s64 mtime = 0;
+    u64 file_id = 0;
+};
+
+bool GetFileIdentity(const std::filesystem::path& path, FileIdentity& identity) {
+    std::error_code ec;
+    identity.size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    const auto mtime = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    identity.mtime = mtime.time_since_epoch().count();
+#ifndef _WIN32
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        identity.file_id = static_cast<u64>(st.st_ino);
+    }
+#endif
+    return true;
+}
+
+constexpr u64 AlignUp8(u64 value) {
+    return (value + 7) & ~u64(7);
+}
+
+class StringTableWriter {
+public:
+    Catalog::StringRef Add(std::string_view str) {
+        const auto [it, inserted] =
+            offsets.try_emplace(std::string(str), static_cast<u32>(data.size()));
+        if (inserted) {
+            data.insert(data.end(), str.begin(), str.end());
+        }
+        return {it->second, static_cast<u32>(str.size())};
+    }
+
+    const std::vector<char>& GetData() const {
+        return data;
+    }
+
+private:
+    std::unordered_map<std::string, u32> offsets;
+    std::vector<char> data;
+};
+
+} // Anonymous namespace
+
+bool PKGCatalog::Load(const std::filesystem::path& catalog_path, std::string& failreason) {
+    packages.clear();
+    std::error_code ec;
+    if (!std::filesystem::exists(catalog_path, ec)) {
+        return true;
+    }
+
+    // Records are decoded straight out of the mapping, nothing but the results is copied.
+    const Common::FS::MappedFile file(catalog_path);
+    if (!file.IsMapped()) {
+        failreason = "Failed to map catalog file";
+        return false;
+    }
+    const std::span<const u8> image = file.Span();
+
+    Catalog::Header header;
+    if (image.size() < sizeof(header)) {
+        failreason = "Catalog file is truncated";
+        return false;
+    }
+    std::memcpy(&header, image.data(), sizeof(header));
+    if (header.magic != Catalog::Magic || header.version != Catalog::Version) {
+        failreason = "Unsupported catalog file";
+        return false;
+    }
+
+    const auto section_fits = [&](u64 offset, u64 count, u64 record_size) {
+        return offset <= image.size() && count <= (image.size() - offset) / record_size;
+    };
+    if (!section_fits(header.package_offset, header.package_count,
+                      sizeof(Catalog::PackageRecord)) ||
+        !section_fits(header.file_offset, header.file_count, sizeof(Catalog::FileRecord)) ||
+        !section_fits(header.sfo_offset, header.sfo_count, sizeof(Catalog::SfoRecord)) ||
+        !section_fits(header.string_offset, header.string_size, 1)) {
+        failreason = "Catalog file is truncated";
+        return false;
+    }
+
+    const char* strings = reinterpret_cast<const char*>(image.data() + header.string_offset);
+    bool strings_ok = true;
+    const auto get_string = [&](Catalog::StringRef ref) {
+        if (u64(ref.offset) + ref.size > header.string_size) {
+            strings_ok = false;
+            return std::string{};
+        }
+        return std::string(strings + ref.offset, ref.size);
+    };
+
+    packages.resize(header.package_count);
+    for (u64 i = 0; i < header.package_count; i++) {
+        Catalog::PackageRecord record;
+        std::memcpy(&record, image.data() + header.package_offset + i * sizeof(record),
+                    sizeof(record));
+        // Written so that a corrupt first index can not wrap around the check.
+        if (record.first_file > header.file_count ||
+            record.file_count > header.file_count - record.first_file ||
+            record.first_sfo > header.sfo_count ||
+            record.sfo_count > header.sfo_count - record.first_sfo) {
+            failreason = "Catalog package record is out of range";
+            packages.clear();
+            return false;
+        }
+
+        CatalogPackage& package = packages[i];
+        PKGInfo& info = package.info;
+        const auto path = get_string(record.path);
+        info.path = std::filesystem::path(std::u8string(path.begin(), path.end()));
+        info.file_size = record.file_size;
+        info.content_id = get_string(record.content_id);
+        info.title_id = get_string(record.title_id);
+        info.flags = get_string(record.flags_text);
+        info.error = get_string(record.error);
+        info.content_type = record.content_type;
+        info.content_flags = record.content_flags;
+        info.drm_type = record.drm_type;
+        info.pkg_size = record.pkg_size;
+        info.content_size = record.content_size;
+        info.pfs_image_size = record.pfs_image_size;
+        info.entry_count = record.entry_count;
+        info.valid = (record.flags & Catalog::PackageValid) != 0;
+        package.mtime = record.mtime;
+        package.file_id = record.file_id;
+        package.has_files = (record.flags & Catalog::PackageHasFiles) != 0;
+
+        info.sfo.reserve(record.sfo_count);
+        for (u64 j = 0; j < record.sfo_count; j++) {
+            Catalog::SfoRecord sfo;
+            std::memcpy(&sfo,
+                        image.data() + header.sfo_offset + (record.first_sfo + j) * sizeof(sfo),
+                        sizeof(sfo));
+            info.sfo.emplace_back(get_string(sfo.key), get_string(sfo.value));
+        }
+        package.files.reserve(record.file_count);
+        for (u64 j = 0; j < record.file_count; j++) {
+            Catalog::FileRecord entry;
+            std::memcpy(&entry,
+                        image.data() + header.file_offset + (record.first_file + j) * sizeof(entry),
+                        sizeof(entry));
+            package.files.push_back({get_string(entry.path), entry.size});
+        }
+    }
+
+    if (!strings_ok) {
+        failreason = "Catalog string reference is out of range";
+        packages.clear();
+        return false;
+    }
+    return true;
+}
+
+bool PKGCatalog::Save(const std::filesystem::path& catalog_path, std::string& failreason) const {
+    StringTableWriter strings;
+    std::vector<Catalog::PackageRecord> package_records;
+    std::vector<Catalog::FileRecord> file_records;
+    std::vector<Catalog::SfoRecord> sfo_records;
+    package_records.reserve(packages.size());
+
+    for (const auto& package : packages) {
+        const PKGInfo& info = package.info;
+        Catalog::PackageRecord record{};
+        record.path = strings.Add(Common::FS::PathToUTF8String(info.path));
+        record.content_id = strings.Add(info.content_id);
+        record.title_id = strings.Add(info.title_id);
+        record.flags_text = strings.Add(info.flags);
+        record.error = strings.Add(info.error);
+        record.file_size = info.file_size;
+        record.mtime = package.mtime;
+        record.file_id = package.file_id;
+        record.pkg_size = info.pkg_size;
+        record.content_size = info.content_size;
+        record.pfs_image_size = info.pfs_image_size;
+        record.content_type = info.content_type;
+        record.content_flags = info.content_flags;
+        record.drm_type = info.drm_type;
+        record.entry_count = info.entry_count;
+        record.flags = (info.valid ? u32{Catalog::PackageValid} : 0u) |
+                       (package.has_files ? u32{Catalog::PackageHasFiles} : 0u);
+
+        record.first_sfo = sfo_records.size();
+        record.sfo_count = static_cast<u32>(info.sfo.size());
+        for (const auto& [key, value] : info.sfo) {
+            sfo_records.push_back({strings.Add(key), strings.Add(value)});
+        }
+        record.first_file = file_records.size();
+        record.file_count = static_cast<u32>(package.files.size());
+        for (const auto& entry : package.files) {
+            file_records.push_back({strings.Add(entry.path), entry.size});
+        }
+        package_records.push_back(record);
+    }
+
+    Catalog::Header header{};
+    header.magic = Catalog::Magic;
+    header.version = Catalog::Version;
+    header.package_count = package_records.size();
+    header.package_offset = sizeof(header);
+    header.file_count = file_records.size();
+    header.file_offset =
+        header.package_offset + package_records.size() * sizeof(Catalog::PackageRecord);
+    header.sfo_count = sfo_records.size();
+    header.sfo_offset = header.file_offset + file_records.size() * sizeof(Catalog::FileRecord);
+    header.string_offset =
+        AlignUp8(header.sfo_offset + sfo_records.size() * sizeof(Catalog::SfoRecord));
+    header.string_size = strings.GetData().size();
+
+    // Write to a sibling file and rename it over the old catalog so readers never see a
+    // half written index.
+    auto temp_path = catalog_path;
+    temp_path += ".tmp";
+    {
+        Common::FS::IOFile out(temp_path, Common::FS::FileAccessMode::Write);
+        if (!out.IsOpen()) {
+            failreason = "Failed to create catalog file";
+            return false;
+        }
+        static constexpr std::array<u8, 8> Padding{};
+        const u64 padding = header.string_offset - header.sfo_offset -
+                            sfo_records.size() * sizeof(Catalog::SfoRecord);
+        bool ok = out.WriteObject(header);
+        ok &= out.Write(package_records) == package_records.size();
+        ok &= out.Write(file_records) == file_records.size();
+        ok &= out.Write(sfo_records) == sfo_records.size();
+        ok &= out.WriteRaw<u8>(Padding.data(), padding) == padding;
+        ok &= out.Write(strings.GetData()) == strings.GetData().size();
+        if (!ok) {
+            failreason = "Failed to write catalog file";
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, catalog_path, ec);
+    if (ec) {
+        failreason = "Failed to replace catalog file: " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+PKGCatalog::UpdateStats PKGCatalog::Update(std::span<const std::filesystem::path> roots,
+                                           bool with_files) {
+    UpdateStats stats;
+    const auto files = FindPKGFiles(roots);
+
+    std::unordered_map<std::string, size_t> known;
+    for (size_t i = 0; i < packages.size(); i++) {
+        known.emplace(Common::FS::PathToUTF8String(packages[i].info.path), i);
+    }
+
+    // Only packages under the scanned roots are considered gone when they are not found.
+    const auto under_roots = [&](const std::filesystem::path& path) {
+        return std::ranges::any_of(roots, [&](const std::filesystem::path& root) {
+            const auto rel = path.lexically_relative(root);
+            return path == root || (!rel.empty() && *rel.begin() != "..");
+        });
+    };
+
+    std::vector<CatalogPackage> updated;
+    std::vector<bool> keep(packages.size(), false);
+    std::vector<size_t> to_scan;
+    for (const auto& path : files) {
+        FileIdentity identity;
+        GetFileIdentity(path, identity);
+        const auto it = known.find(Common::FS::PathToUTF8String(path));
+        if (it != known.end()) {
+            const CatalogPackage& old = packages[it->second];
+            keep[it->second] = true;
+            if (old.info.file_size == identity.size && old.mtime == identity.mtime &&
+                old.file_id == identity.file_id && (old.has_files || !with_files)) {
+                updated.push_back(std::move(packages[it->second]));
+                stats.unchanged++;
+                continue;
+            }
+        }
+        to_scan.push_back(updated.size());
+        auto& package = updated.emplace_back();
+        package.info.path = path;
+        package.info.file_size = identity.size;
+        package.mtime = identity.mtime;
+        package.file_id = identity.file_id;
+    }
+
+    Common::ParallelFor(to_scan.size(), [&](size_t i) {
+        CatalogPackage& package = updated[to_scan[i]];
+        std::string failreason;
+        if (!ReadPKGInfo(package.info.path, package.info, failreason)) {
+            package.info.error = std::move(failreason);
+        }
+    });
+
+    // Listing the file system needs the keys and a PKG instance per package. Packages are
+    // opened a slice at a time, the RSA steps of a slice share one batch and only one slice
+    // of parsed images is held at once.
+    std::vector<size_t> to_list;
+    if (with_files) {
+        std::ranges::copy_if(to_scan, std::back_inserter(to_list),
+                             [&](size_t index) { return updated[index].info.error.empty(); });
+    }
+    for (size_t first = 0; first < to_list.size(); first += FileSystemSlice) {
+        const size_t count = std::min(FileSystemSlice, to_list.size() - first);
+        std::vector<std::unique_ptr<PKG>> slice(count);
+        std::vector<PKG*> pkgs(count);
+        std::vector<std::filesystem::path> paths(count);
+        for (size_t k = 0; k < count; k++) {
+            slice[k] = std::make_unique<PKG>();
+            pkgs[k] = slice[k].get();
+            paths[k] = updated[to_list[first + k]].info.path;
+        }
+        std::vector<std::string> errors(count);
+        PKG::ReadFileSystems(pkgs, paths, errors);
+        for (size_t k = 0; k < count; k++) {
+            CatalogPackage& package = updated[to_list[first + k]];
+            if (!errors[k].empty()) {
+                package.info.error = std::move(errors[k]);
+                continue;
+            }
+            for (const auto& entry : slice[k]->GetFiles()) {
+                package.files.push_back({entry.path.generic_string(), entry.size});
+            }
+            package.has_files = true;
+        }
+    }
+    stats.scanned = to_scan.size();
+    for (const size_t index : to_scan) {
+        if (!updated[index].info.valid || !updated[index].info.error.empty()) {
+            stats.failed++;
+        }
+    }
+
+    // Keep packages outside of the scanned roots untouched.
+    for (size_t i = 0; i < packages.size(); i++) {
+        if (keep[i]) {
+            continue;
+        }
+        if (under_roots(packages[i].info.path)) {
+            stats.removed++;
+        } else {
+            updated.push_back(std::move(packages[i]));
+        }
+    }
+
+    std::ranges::sort(updated, {}, [](const CatalogPackage& package) -> const auto& {
+        return package.info.path;
+    });
+    packages = std::move(updated);
+    return stats;
+}
+
+std::vector<std::pair<size_t, size_t>> PKGCatalog::FindFiles(std::string_view needle) const {
+    std::vector<std::pair<size_t, size_t>> matches;
+    for (size_t i = 0; i < packages.size(); i++) {
+        const auto& files = packages[i].files;
+        for (size_t j = 0; j < files.size(); j++) {
+            if (files[j].path.find(needle) != std::string::npos) {
+                matches.emplace_back(i, j);
+            }
+        }
+    }
+    return matches;
+}
+
+std::map<u32, std::pair<size_t, u64>> PKGCatalog::GetSizesByContentType() const {
+    std::map<u32, std::pair<size_t, u64>> sizes;
+    for (const auto& package : packages) {
+        if (!package.info.valid) {
+            continue;
+        }
+        auto& [count, total] = sizes[package.info.content_type];
+        count++;
+        total += package.info.file_size;
+    }
+    return sizes;
+}
@@ -0,0 +1,137 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/types.h"
+#include "core/file_format/pkg_scan.h"
+
+/**
+ * On-disk index of a PKG library.
+ *
+ * The catalog file is a flat little-endian image: a header, then fixed-size package, file and
+ * param.sfo records that only reference strings by offset into a shared, deduplicated string
+ * table. Every section is 8-byte aligned so the file can be mapped and read in place.
+ */
+namespace Catalog {
+
+constexpr u32 Magic = 0x43474B50; // "PKGC"
+constexpr u32 Version = 1;
+
+struct StringRef {
+    u32 offset;
+    u32 size;
+};
+
+struct Header {
+    u32 magic;
+    u32 version;
+    u64 package_count;
+    u64 package_offset;
+    u64 file_count;
+    u64 file_offset;
+    u64 sfo_count;
+    u64 sfo_offset;
+    u64 string_offset;
+    u64 string_size;
+};
+static_assert(sizeof(Header) == 72);
+
+enum PackageFlags : u32 {
+    PackageValid = 1 << 0,
+    PackageHasFiles = 1 << 1, // the PFS file list was indexed
+};
+
+struct PackageRecord {
+    StringRef path;
+    StringRef content_id;
+    StringRef title_id;
+    StringRef flags_text;
+    StringRef error;
+    u64 file_size;
+    s64 mtime;
+    u64 file_id; // st_ino, 0 where the platform has none
+    u64 pkg_size;
+    u64 content_size;
+    u64 pfs_image_size;
+    u32 content_type;
+    u32 content_flags;
+    u32 drm_type;
+    u32 entry_count;
+    u64 first_file;
+    u64 first_sfo;
+    u32 file_count;
+    u32 sfo_count;
+    u32 flags;
+    u32 reserved;
+};
+static_assert(sizeof(PackageRecord) == 136);
+
+struct FileRecord {
+    StringRef path;
+    u64 size;
+};
+static_assert(sizeof(FileRecord) == 16);
+
+struct SfoRecord {
+    StringRef key;
+    StringRef value;
+};
+static_assert(sizeof(SfoRecord) == 16);
+
+} // namespace Catalog
+
+struct CatalogFile {
+    std::string path; // relative to the image root, '/' separated
+    u64 size = 0;
+};
+
+struct CatalogPackage {
+    PKGInfo info;
+    s64 mtime = 0;
+    u64 file_id = 0;
+    bool has_files = false;
+    std::vector<CatalogFile> files;
+};
+
+class PKGCatalog {
+public:
+    struct UpdateStats {
+        size_t unchanged = 0;
+        size_t scanned = 0;
+        size_t removed = 0;
+        size_t failed = 0;
+    };
+
+    /// Loads a catalog file. A missing file leaves the catalog empty and is not an error.
+    bool Load(const std::filesystem::path& catalog_path, std::string& failreason);
+    bool Save(const std::filesystem::path& catalog_path, std::string& failreason) const;
+
+    /**
+     * Brings the catalog in sync with the packages found below `roots`. Packages whose size,
+     * modification time and inode match the stored ones are kept as they are, the others are
+     * rescanned in parallel. Entries for packages that disappeared from the scanned roots are
+     * dropped. With `with_files` the PFS file list is indexed as well, which needs the keys
+     * to be derived and is therefore much slower than the header scan.
+     */
+    UpdateStats Update(std::span<const std::filesystem::path> roots, bool with_files);
+
+    std::span<const CatalogPackage> GetPackages() const {
+        return packages;
+    }
+
+    /// Returns (package, file) index pairs whose file path contains `needle`.
+    std::vector<std::pair<size_t, size_t>> FindFiles(std::string_view needle) const;
+
+    /// Sums the package sizes per pkg_content_type.
+    std::map<u32, std::pair<size_t, u64>> GetSizesByContentType() const;
+
+private:
+    std::vector<CatalogPackage> packages;
+};
@@ -0,0 +1,188 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <optional>
+#include <unordered_map>
+
+#include "common/io_file.h"
+#include "common/parallel_for.h"
+#include "common/path_util.h"
+#include "core/file_format/pkg.h"
+#include "core/file_format/pkg_diff.h"
+
+namespace {
+
+constexpr u64 BlockSize = 0x10000;
+constexpr size_t ReadSize = 0x11000;
+
+// Appends [begin, end) to `ranges`, merging it with the last range when they touch.
+void AddRange(std::vector<std::pair<u64, u64>>& ranges, u64 begin, u64 end) {
+    if (begin >= end) {
+        return;
+    }
+    if (!ranges.empty() && ranges.back().second >= begin) {
+        ranges.back().second = std::max(ranges.back().second, end);
+        return;
+    }
+    ranges.emplace_back(begin, end);
+}
+
+struct BlockReader {
+    explicit BlockReader(PKG& pkg_) : pkg{pkg_}, file{pkg_.GetPkgFile()} {}
+
+    std::span<const u8> ReadStored(u64 block) {
+        return pkg.ReadCompressedBlock(file, block, read_buf, decrypted);
+    }
+
+    PKG& pkg;
+    const Common::FS::IOFile& file;
+    std::vector<u8> read_buf = std::vector<u8>(ReadSize);
+    std::vector<u8> decrypted = std::vector<u8>(ReadSize);
+    std::vector<char> inflated = std::vector<char>(BlockSize);
+};
+
+} // Anonymous namespace
+
+bool DiffPKGs(const std::filesystem::path& old_pkg, const std::filesystem::path& new_pkg,
+              PKGDiffResult& result, std::string& failreason) {
+    result = {};
+    PKG pkg_a;
+    PKG pkg_b;
+    if (!pkg_a.ReadFileSystem(old_pkg, failreason)) {
+        failreason = Common::FS::PathToUTF8String(old_pkg) + ": " + failreason;
+        return false;
+    }
+    if (!pkg_b.ReadFileSystem(new_pkg, failreason)) {
+        failreason = Common::FS::PathToUTF8String(new_pkg) + ": " + failreason;
+        return false;
+    }
+
+    const auto files_a = pkg_a.GetFiles();
+    const auto files_b = pkg_b.GetFiles();
+    std::unordered_map<std::filesystem::path, size_t> index_a;
+    for (size_t i = 0; i < files_a.size(); i++) {
+        index_a.emplace(files_a[i].path, i);
+    }
+
+    std::vector<bool> matched(files_a.size(), false);
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t i = 0; i < files_b.size(); i++) {
+        const auto it = index_a.find(files_b[i].path);
+        if (it == index_a.end()) {
+            result.files.push_back({files_b[i].path, PKGFileDiff::Status::Added, 0,
+                                    files_b[i].size, {{0, files_b[i].size}}});
+            continue;
+        }
+        matched[it->second] = true;
+        pairs.emplace_back(it->second, i);
+    }
+    for (size_t i = 0; i < files_a.size(); i++) {
+        if (!matched[i]) {
+            result.files.push_back(
+                {files_a[i].path, PKGFileDiff::Status::Removed, files_a[i].size, 0, {}});
+        }
+    }
+
+    std::vector<PKGFileDiff> changed(pairs.size());
+    std::atomic<u64> blocks_compared{0};
+    std::atomic<u64> blocks_inflated{0};
+    Common::ParallelFor(pairs.size(), [&](size_t p) {
+        const PKGFileInfo& a = files_a[pairs[p].first];
+        const PKGFileInfo& b = files_b[pairs[p].second];
+        PKGFileDiff& diff = changed[p];
+        diff.path = b.path;
+        diff.status = PKGFileDiff::Status::Changed;
+        diff.old_size = a.size;
+        diff.new_size = b.size;
+
+        // Created lazily, most files of a new revision tend to be identical block by block.
+        std::optional<BlockReader> reader_a;
+        std::optional<BlockReader> reader_b;
+
+        const u64 common_size = std::min(a.size, b.size);
+        const u32 common_blocks =
+            static_cast<u32>(std::min<u64>({a.num_blocks, b.num_blocks,
+                                            (common_size + BlockSize - 1) / BlockSize}));
+        for (u32 j = 0; j < common_blocks; j++) {
+            blocks_compared++;
+            const u64 block_begin = u64(j) * BlockSize;
+            const u64 block_end = std::min(block_begin + BlockSize, common_size);
+            if (!reader_a) {
+                reader_a.emplace(pkg_a);
+                reader_b.emplace(pkg_b);
+            }
+
+            // Same stored bytes means the same contents, no need to inflate anything.
+            const u64 stored_a = pkg_a.GetBlockStoredSize(a.first_block + j);
+            const u64 stored_b = pkg_b.GetBlockStoredSize(b.first_block + j);
+            const auto data_a = reader_a->ReadStored(a.first_block + j);
+            const auto data_b = reader_b->ReadStored(b.first_block + j);
+            if (stored_a == stored_b &&
+                std::memcmp(data_a.data(), data_b.data(), data_a.size()) == 0) {
+                continue;
+            }
+
+            blocks_inflated++;
+            PKG::InflateBlock(data_a, reader_a->inflated);
+            PKG::InflateBlock(data_b, reader_b->inflated);
+            const char* plain_a = reader_a->inflated.data();
+            const char* plain_b = reader_b->inflated.data();
+            for (u64 off = 0; off < block_end - block_begin;) {
+                if (plain_a[off] == plain_b[off]) {
+                    off++;
+                    continue;
+                }
+                const u64 run_begin = off;
+                while (off < block_end - block_begin && plain_a[off] != plain_b[off]) {
+                    off++;
+                }
+                AddRange(diff.changed_ranges, block_begin + run_begin, block_begin + off);
+            }
+        }
+        // Anything past the shorter file is new (or gone, which shows as a size change).
+        AddRange(diff.changed_ranges, common_size, b.size);
+    });
+    result.blocks_compared = blocks_compared;
+    result.blocks_inflated = blocks_inflated;
+
+    for (auto& diff : changed) {
+        if (diff.changed_ranges.empty() && diff.old_size == diff.new_size) {
+            result.unchanged_files++;
+        } else {
+            result.files.push_back(std::move(diff));
+        }
+    }
+    std::ranges::sort(result.files, {}, &PKGFileDiff::path);
+    return true;
+}
+
+void WritePKGDiff(std::ostream& out, const PKGDiffResult& result) {
+    size_t added = 0, removed = 0, modified = 0;
+    for (const auto& diff : result.files) {
+        const auto path = Common::FS::PathToUTF8String(diff.path);
+        switch (diff.status) {
+        case PKGFileDiff::Status::Added:
+            added++;
+            out << "+ " << path << " (" << diff.new_size << ")\n";
+            break;
+        case PKGFileDiff::Status::Removed:
+            removed++;
+            out << "- " << path << " (" << diff.old_size << ")\n";
+            break;
+        case PKGFileDiff::Status::Changed:
+            modified++;
+            out << "M " << path << " (" << diff.old_size << " -> " << diff.new_size << ")";
+            for (const auto& [begin, end] : diff.changed_ranges) {
+                out << " [0x" << std::hex << begin << "-0x" << end << ")" << std::dec;
+            }
+            out << '\n';
+            break;
+        }
+    }
+    out << added << " added, " << removed << " removed, " << modified << " changed, "
+        << result.unchanged_files << " unchanged (" << result.blocks_compared
+        << " blocks compared, " << result.blocks_inflated << " inflated)\n";
+}
@@ -0,0 +1,42 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common/types.h"
+
+struct PKGFileDiff {
+    enum class Status {
+        Added,
+        Removed,
+        Changed,
+    };
+
+    std::filesystem::path path; // relative to the image root
+    Status status;
+    u64 old_size = 0;
+    u64 new_size = 0;
+    std::vector<std::pair<u64, u64>> changed_ranges; // [begin, end) in the new file
+};
+
+struct PKGDiffResult {
+    std::vector<PKGFileDiff> files;
+    size_t unchanged_files = 0;
+    u64 blocks_compared = 0;
+    u64 blocks_inflated = 0; // blocks whose stored bytes differed and had to be decompressed
+};
+
+/**
+ * Compares the file systems of two packages without extracting them. Files are matched by
+ * path; for every pair the PFSC blocks are decrypted and compared as stored, and only blocks
+ * whose stored bytes differ are inflated to find the changed byte ranges.
+ */
+bool DiffPKGs(const std::filesystem::path& old_pkg, const std::filesystem::path& new_pkg,
+              PKGDiffResult& result, std::string& failreason);
+
+void WritePKGDiff(std::ostream& out, const PKGDiffResult& result);
@@ -0,0 +1,123 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+
+#include "common/logging/log.h"
+#include "common/parallel_for.h"
+#include "common/path_util.h"
+#include "core/file_format/pkg_merge.h"
+
+bool PKGMergedView::Open(std::span<const PKGMergeSource> sources, std::string& failreason) {
+    packages.clear();
+    files.clear();
+    overridden = 0;
+    if (sources.empty()) {
+        failreason = "No package to merge";
+        return false;
+    }
+
+    packages.resize(sources.size());
+    std::vector<PKG*> pkgs(sources.size());
+    std::vector<std::filesystem::path> paths(sources.size());
+    for (size_t i = 0; i < sources.size(); i++) {
+        packages[i] = std::make_unique<PKG>();
+        pkgs[i] = packages[i].get();
+        paths[i] = sources[i].pkg_path;
+    }
+    std::vector<std::string> errors(sources.size());
+    PKG::ReadFileSystems(pkgs, paths, errors);
+    for (size_t i = 0; i < sources.size(); i++) {
+        if (!errors[i].empty()) {
+            failreason = Common::FS::PathToUTF8String(sources[i].pkg_path) + ": " + errors[i];
+            packages.clear();
+            return false;
+        }
+    }
+
+    // Walk the sources in precedence order, a later package simply replaces the entry.
+    std::unordered_map<std::filesystem::path, size_t> index;
+    for (u32 source = 0; source < sources.size(); source++) {
+        for (auto& file : packages[source]->GetFiles()) {
+            auto path = (sources[source].prefix / file.path).lexically_normal();
+            const auto [it, inserted] = index.emplace(path, files.size());
+            if (inserted) {
+                files.push_back({std::move(path), source, std::move(file)});
+            } else {
+                files[it->second].source = source;
+                files[it->second].file = std::move(file);
+                overridden++;
+            }
+        }
+    }
+    std::sort(files.begin(), files.end(),
+              [](const auto& a, const auto& b) { return a.path < b.path; });
+
+    LOG_DEBUG(Loader, "Merged view: {} files from {} packages, {} overridden", files.size(),
+              sources.size(), overridden);
+    return true;
+}
+
+bool PKGMergedView::Extract(const std::filesystem::path& output, std::string& failreason,
+                            const PKG::ProgressCallback& progress, size_t max_threads) {
+    // Create the folder structure up front so the workers only have to open files.
+    std::set<std::filesystem::path> dirs;
+    for (const auto& merged : files) {
+        dirs.insert((output / merged.path).parent_path());
+    }
+    std::error_code ec;
+    for (const auto& dir : dirs) {
+        std::filesystem::create_directories(dir, ec);
+        if (ec) {
+            failreason = "Failed to create " + Common::FS::PathToUTF8String(dir);
+            return false;
+        }
+    }
+
+    // Biggest files first, so a large file picked up late does not leave one thread working
+    // alone at the end.
+    std::vector<u32> order(files.size());
+    for (u32 i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](u32 a, u32 b) { return files[a].file.size > files[b].file.size; });
+
+    std::atomic<size_t> done{0};
+    std::atomic<bool> cancelled{false};
+    std::mutex error_mutex;
+    std::mutex progress_mutex;
+    Common::ParallelFor(
+        order.size(),
+        [&](size_t i) {
+            if (cancelled) {
+                return;
+            }
+            const PKGMergedFile& merged = files[order[i]];
+            if (!packages[merged.source]->ExtractFileTo(merged.file, output / merged.path)) {
+                std::scoped_lock lock{error_mutex};
+                if (failreason.empty()) {
+                    failreason = "Failed to extract " + Common::FS::PathToUTF8String(merged.path);
+                }
+                cancelled = true;
+                return;
+            }
+            const size_t now = ++done;
+            if (progress) {
+                std::scoped_lock lock{progress_mutex};
+                if (!progress(now, files.size())) {
+                    cancelled = true;
+                }
+            }
+        },
+        max_threads);
+
+    if (cancelled && failreason.empty()) {
+        failreason = "Extraction cancelled";
+    }
+    return !cancelled;
+}
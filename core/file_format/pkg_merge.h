@@ -0,0 +1,59 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+#include "core/file_format/pkg.h"
+
+struct PKGMergeSource {
+    std::filesystem::path pkg_path;
+    std::filesystem::path prefix; // where the image root goes below the output folder
+};
+
+/// A file of the merged tree and the package it is taken from.
+struct PKGMergedFile {
+    std::filesystem::path path; // relative to the output folder
+    u32 source;                 // index into the sources given to Open
+    PKGFileInfo file;
+};
+
+/**
+ * Final file set of several packages laid over each other, e.g. base game, then the latest
+ * update, then DLCs. Only the file systems are parsed; each path is resolved to the last source
+ * that contains it, so extracting the view reads and writes every winning file exactly once
+ * instead of extracting each package in turn and overwriting.
+ */
+class PKGMergedView {
+public:
+    /// Parses every source in parallel, later sources take precedence over earlier ones.
+    bool Open(std::span<const PKGMergeSource> sources, std::string& failreason);
+
+    /// Winning files, sorted by path.
+    const std::vector<PKGMergedFile>& GetFiles() const {
+        return files;
+    }
+    /// Files of earlier sources hidden by a later one.
+    size_t GetOverriddenCount() const {
+        return overridden;
+    }
+    PKG& GetPackage(u32 source) {
+        return *packages[source];
+    }
+    size_t GetSourceCount() const {
+        return packages.size();
+    }
+
+    /// Writes the merged tree below `output` on up to `max_threads` threads.
+    bool Extract(const std::filesystem::path& output, std::string& failreason,
+                 const PKG::ProgressCallback& progress = {}, size_t max_threads = 0);
+
+private:
+    std::vector<std::unique_ptr<PKG>> packages;
+    std::vector<PKGMergedFile> files;
+    size_t overridden = 0;
+};
@@ -0,0 +1,295 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include "common/mapped_file.h"
+#include "common/parallel_for.h"
+#include "common/path_util.h"
+#include "common/string_util.h"
+#include "core/file_format/pkg.h"
+#include "core/file_format/pkg_scan.h"
+#include "core/file_format/psf.h"
+
+namespace {
+
+constexpr u32 PkgMagic = 0x7F434E54;
+constexpr u32 ParamSfoId = 0x1000;
+
+bool IsPKGFile(const std::filesystem::path& path) {
+    return Common::ToLower(Common::FS::PathToUTF8String(path.extension())) == ".pkg";
+}
+
+void ParseSfo(std::span<const u8> buffer, PKGInfo& info) {
+    if (buffer.size() < sizeof(PSFHeader)) {
+        return;
+    }
+    // Read in place from the mapping, only the strings kept in the info are copied.
+    PSFView psf;
+    if (!psf.Open(buffer)) {
+        return;
+    }
+    info.sfo.reserve(psf.GetNumEntries());
+    for (u32 i = 0; i < psf.GetNumEntries(); i++) {
+        const PSFView::Entry entry = psf.GetEntry(i);
+        if (entry.param_fmt == PSFEntryFmt::Text) {
+            info.sfo.emplace_back(entry.key, entry.AsString());
+        } else if (entry.param_fmt == PSFEntryFmt::Integer) {
+            info.sfo.emplace_back(entry.key, std::to_string(entry.AsInteger()));
+        }
+    }
+}
+
+} // Anonymous namespace
+
+std::string_view PKGInfo::GetSfoValue(std::string_view key) const {
+    const auto it = std::ranges::find_if(sfo, [&](const auto& kv) { return kv.first == key; });
+    return it != sfo.end() ? std::string_view{it->second} : std::string_view{};
+}
+
+bool ReadPKGInfo(const std::filesystem::path& filepath, PKGInfo& info, std::string& failreason) {
+    info = {};
+    info.path = filepath;
+
+    // Only a few pages are touched: the header, the entry table and param.sfo. They are read
+    // in place from the mapping, with read-ahead off since the rest is never looked at.
+    const Common::FS::MappedFile file(filepath);
+    if (!file.IsMapped()) {
+        failreason = "Failed to open PKG file";
+        return false;
+    }
+    file.Advise(Common::FS::MapHint::Random);
+    const std::span<const u8> data = file.Span();
+    info.file_size = file.GetFileSize();
+    if (info.file_size < sizeof(PKGHeader)) {
+        failreason = "File is too small to be a PKG";
+        return false;
+    }
+
+    PKGHeader header;
+    std::memcpy(&header, data.data(), sizeof(header));
+    if (header.magic != PkgMagic) {
+        failreason = "Invalid PKG magic";
+        return false;
+    }
+
+    const char* content_id = reinterpret_cast<const char*>(header.pkg_content_id);
+    info.content_id.assign(content_id, strnlen(content_id, sizeof(header.pkg_content_id)));
+    if (info.content_id.size() >= 16) {
+        info.title_id = info.content_id.substr(7, 9);
+    }
+    info.content_type = header.pkg_content_type;
+    info.content_flags = header.pkg_content_flags;
+    info.drm_type = header.pkg_drm_type;
+    info.pkg_size = header.pkg_size;
+    info.content_size = header.pkg_content_size;
+    info.pfs_image_size = header.pfs_image_size;
+    info.entry_count = header.pkg_table_entry_count;
+    for (const auto& flag : PKG::flagNames) {
+        if (PKG::isFlagSet(header.pkg_content_flags, flag.first)) {
+            if (!info.flags.empty())
+                info.flags += ", ";
+            info.flags += flag.second;
+        }
+    }
+
+    // [offset, offset + size) of the file, empty when out of bounds.
+    const auto range = [&](u64 offset, u64 size) -> std::span<const u8> {
+        if (offset > data.size() || size > data.size() - offset) {
+            return {};
+        }
+        return data.subspan(offset, size);
+    };
+
+    const u64 table_size = u64(info.entry_count) * sizeof(PKGEntry);
+    const auto table = range(header.pkg_table_entry_offset, table_size);
+    if (table.size() != table_size) {
+        failreason = "Failed to read PKG entry table";
+        return false;
+    }
+
+    const auto sfo = FindPKGEntry(data, ParamSfoId);
+    if (!sfo.empty()) {
+        ParseSfo(sfo, info);
+    }
+
+    info.valid = true;
+    return true;
+}
+
+std::span<const u8> FindPKGEntry(std::span<const u8> pkg, u32 id) {
+    PKGHeader header;
+    if (pkg.size() < sizeof(header)) {
+        return {};
+    }
+    std::memcpy(&header, pkg.data(), sizeof(header));
+    if (header.magic != PkgMagic) {
+        return {};
+    }
+    const u64 table_offset = header.pkg_table_entry_offset;
+    const u64 table_size = u64(header.pkg_table_entry_count) * sizeof(PKGEntry);
+    if (table_offset > pkg.size() || table_size > pkg.size() - table_offset) {
+        return {};
+    }
+    for (u32 i = 0; i < header.pkg_table_entry_count; i++) {
+        PKGEntry entry;
+        Common::DecodeBigEndian(pkg.subspan(table_offset + i * sizeof(PKGEntry)),
+                                std::span{&entry, 1});
+        if (entry.id != id) {
+            continue;
+        }
+        if (entry.offset > pkg.size() || entry.size > pkg.size() - entry.offset) {
+            return {};
+        }
+        return pkg.subspan(entry.offset, entry.size);
+    }
+    return {};
+}
+
+std::vector<std::filesystem::path> FindPKGFiles(std::span<const std::filesystem::path> roots) {
+    namespace fs = std::filesystem;
+
+    std::vector<fs::path> files;
+    std::deque<fs::path> pending;
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (fs::is_directory(root, ec)) {
+            pending.push_back(root);
+        } else if (fs::is_regular_file(root, ec)) {
+            files.push_back(root);
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t busy = 0;
+
+    const auto worker = [&] {
+        std::vector<fs::path> found;
+        std::vector<fs::path> subdirs;
+        while (true) {
+            fs::path dir;
+            {
+                std::unique_lock lock{mutex};
+                cv.wait(lock, [&] { return !pending.empty() || busy == 0; });
+                if (pending.empty()) {
+                    return;
+                }
+                dir = std::move(pending.front());
+                pending.pop_front();
+                ++busy;
+            }
+
+            found.clear();
+            subdirs.clear();
+            std::error_code ec;
+            for (auto it = fs::directory_iterator(dir, fs::directory_options::skip_permission_denied,
+                                                  ec);
+                 !ec && it != fs::directory_iterator(); it.increment(ec)) {
+                std::error_code type_ec;
+                if (it->is_directory(type_ec) && !it->is_symlink(type_ec)) {
+                    subdirs.push_back(it->path());
+                } else if (it->is_regular_file(type_ec) && IsPKGFile(it->path())) {
+                    found.push_back(it->path());
+                }
+            }
+
+            {
+                std::scoped_lock lock{mutex};
+                files.insert(files.end(), found.begin(), found.end());
+                pending.insert(pending.end(), subdirs.begin(), subdirs.end());
+                --busy;
+            }
+            cv.notify_all();
+        }
+    };
+
+    if (!pending.empty()) {
+        const size_t num_threads = Common::GetWorkerCount(std::numeric_limits<size_t>::max());
+        std::vector<std::jthread> threads;
+        for (size_t t = 1; t < num_threads; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+    }
+
+    std::ranges::sort(files);
+    return files;
+}
+
+std::vector<PKGInfo> ScanPKGFiles(std::span<const std::filesystem::path> files) {
+    std::vector<PKGInfo> infos(files.size());
+    Common::ParallelFor(files.size(), [&](size_t i) {
+        std::string failreason;
+        if (!ReadPKGInfo(files[i], infos[i], failreason)) {
+            infos[i].error = std::move(failreason);
+        }
+    });
+    return infos;
+}
+
+void WritePKGInfoJsonObject(std::ostream& out, const PKGInfo& info) {
+    using Common::EscapeJsonString;
+    out << "{\"path\":\"" << EscapeJsonString(Common::FS::PathToUTF8String(info.path))
+        << "\",\"valid\":" << (info.valid ? "true" : "false");
+    if (!info.valid) {
+        out << ",\"error\":\"" << EscapeJsonString(info.error) << "\"}";
+        return;
+    }
+    out << ",\"file_size\":" << info.file_size << ",\"content_id\":\""
+        << EscapeJsonString(info.content_id) << "\",\"title_id\":\""
+        << EscapeJsonString(info.title_id) << "\",\"content_type\":" << info.content_type
+        << ",\"content_flags\":" << info.content_flags << ",\"flags\":\""
+        << EscapeJsonString(info.flags) << "\",\"drm_type\":" << info.drm_type
+        << ",\"pkg_size\":" << info.pkg_size << ",\"content_size\":" << info.content_size
+        << ",\"pfs_image_size\":" << info.pfs_image_size << ",\"entry_count\":" << info.entry_count
+        << ",\"sfo\":{";
+    for (size_t j = 0; j < info.sfo.size(); j++) {
+        out << (j ? "," : "") << '"' << EscapeJsonString(info.sfo[j].first) << "\":\""
+            << EscapeJsonString(info.sfo[j].second) << '"';
+    }
+    out << "}}";
+}
+
+void WritePKGInfoJson(std::ostream& out, std::span<const PKGInfo> infos) {
+    out << "[\n";
+    for (size_t i = 0; i < infos.size(); i++) {
+        out << "  ";
+        WritePKGInfoJsonObject(out, infos[i]);
+        out << (i + 1 < infos.size() ? ",\n" : "\n");
+    }
+    out << "]\n";
+}
+
+void WritePKGInfoCsv(std::ostream& out, std::span<const PKGInfo> infos) {
+    using Common::EscapeCsvField;
+    static constexpr std::array<std::string_view, 5> SfoColumns = {
+        "TITLE", "CATEGORY", "APP_VER", "VERSION", "SYSTEM_VER"};
+
+    out << "path,valid,error,file_size,content_id,title_id,content_type,content_flags,flags,"
+           "drm_type,pkg_size,content_size,pfs_image_size,entry_count";
+    for (const auto column : SfoColumns) {
+        out << ',' << column;
+    }
+    out << '\n';
+
+    for (const PKGInfo& info : infos) {
+        out << EscapeCsvField(Common::FS::PathToUTF8String(info.path)) << ','
+            << (info.valid ? "true" : "false") << ',' << EscapeCsvField(info.error) << ','
+            << info.file_size << ',' << EscapeCsvField(info.content_id) << ','
+            << EscapeCsvField(info.title_id) << ',' << info.content_type << ','
+            << info.content_flags << ',' << EscapeCsvField(info.flags) << ',' << info.drm_type
+            << ',' << info.pkg_size << ',' << info.content_size << ',' << info.pfs_image_size
+            << ',' << info.entry_count;
+        for (const auto column : SfoColumns) {
+            out << ',' << EscapeCsvField(info.GetSfoValue(column));
+        }
+        out << '\n';
+    }
+}
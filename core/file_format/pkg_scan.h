@@ -0,0 +1,61 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+#include "common/types.h"
+
+/// Metadata that can be read from a PKG without deriving any key.
+struct PKGInfo {
+    std::filesystem::path path;
+    u64 file_size = 0;
+
+    // PKG header
+    std::string content_id;
+    std::string title_id;
+    u32 content_type = 0;
+    u32 content_flags = 0;
+    std::string flags;
+    u32 drm_type = 0;
+    u64 pkg_size = 0;
+    u64 content_size = 0;
+    u64 pfs_image_size = 0;
+    u32 entry_count = 0;
+
+    // param.sfo, text and integer entries in file order
+    std::vector<std::pair<std::string, std::string>> sfo;
+
+    bool valid = false;
+    std::string error;
+
+    /// Returns the value of a param.sfo key or an empty string when it is missing.
+    std::string_view GetSfoValue(std::string_view key) const;
+};
+
+/**
+ * Reads the header, the entry table and param.sfo of a PKG. The file is mapped with read-ahead
+ * off and parsed in place, so only the pages holding those three are ever read from disk.
+ */
+bool ReadPKGInfo(const std::filesystem::path& filepath, PKGInfo& info, std::string& failreason);
+
+/// Returns the payload of the first entry with `id` (0x1000 is param.sfo) of a PKG held in
+/// memory, without decrypting anything. Empty when there is none or it lies out of bounds.
+std::span<const u8> FindPKGEntry(std::span<const u8> pkg, u32 id);
+
+/// Recursively collects every .pkg file below `roots`, walking directories in parallel.
+/// Plain files given as roots are returned as they are.
+std::vector<std::filesystem::path> FindPKGFiles(std::span<const std::filesystem::path> roots);
+
+/// Reads the info of every package in parallel, keeping the order of `files`.
+std::vector<PKGInfo> ScanPKGFiles(std::span<const std::filesystem::path> files);
+
+void WritePKGInfoJson(std::ostream& out, std::span<const PKGInfo> infos);
+/// Writes a single info as a one-line JSON object.
+void WritePKGInfoJsonObject(std::ostream& out, const PKGInfo& info);
+void WritePKGInfoCsv(std::ostream& out, std::span<const PKGInfo> infos);
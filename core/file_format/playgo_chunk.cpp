@@ -1,61 +1,123 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
+#include <cstring>
+
+#include "common/mapped_file.h"
 #include "playgo_chunk.h"
 
 bool PlaygoFile::Open(const std::filesystem::path& filepath) {
-    Common::FS::IOFile file(filepath, Common::FS::FileAccessMode::Read);
-    if (file.IsOpen()) {
-        file.Read(playgoHeader);
-        if (LoadChunks(file)) {
-            return true;
-        }
+    // The tables are parsed from the mapped file, no read per table.
+    const Common::FS::MappedFile file(filepath);
+    return file.IsMapped() && Open(file.Span());
+}
+
+bool PlaygoFile::Open(std::span<const u8> data) {
+    if (data.size() < sizeof(playgoHeader)) {
+        return false;
     }
-    return false;
+    std::memcpy(&playgoHeader, data.data(), sizeof(playgoHeader));
+    return LoadChunksFrom(data);
 }
 
 bool PlaygoFile::LoadChunks(const Common::FS::IOFile& file) {
     if (file.IsOpen()) {
-        if (playgoHeader.magic == PLAYGO_MAGIC) {
-            bool ret = true;
+        return LoadChunksFrom(file);
+    }
+    return false;
+}
 
-            std::string chunk_attrs_data, chunk_mchunks_data, chunk_labels_data, mchunk_attrs_data;
-            ret = ret && load_chunk_data(file, playgoHeader.chunk_attrs, chunk_attrs_data);
-            ret = ret && load_chunk_data(file, playgoHeader.chunk_mchunks, chunk_mchunks_data);
-            ret = ret && load_chunk_data(file, playgoHeader.chunk_labels, chunk_labels_data);
-            ret = ret && load_chunk_data(file, playgoHeader.mchunk_attrs, mchunk_attrs_data);
+template <typename Source>
+bool PlaygoFile::LoadChunksFrom(const Source& source) {
+    if (playgoHeader.magic == PLAYGO_MAGIC) {
+        bool ret = true;
 
-            if (ret) {
-                chunks.resize(playgoHeader.chunk_count);
+        std::string chunk_attrs_data, chunk_mchunks_data, chunk_labels_data, mchunk_attrs_data;
+        ret = ret && load_chunk_data(source, playgoHeader.chunk_attrs, chunk_attrs_data);
+        ret = ret && load_chunk_data(source, playgoHeader.chunk_mchunks, chunk_mchunks_data);
+        ret = ret && load_chunk_data(source, playgoHeader.chunk_labels, chunk_labels_data);
+        ret = ret && load_chunk_data(source, playgoHeader.mchunk_attrs, mchunk_attrs_data);
 
-                auto chunk_attrs =
-                    reinterpret_cast<playgo_chunk_attr_entry_t*>(&chunk_attrs_data[0]);
-                auto chunk_mchunks = reinterpret_cast<u16*>(&chunk_mchunks_data[0]);
-                auto chunk_labels = reinterpret_cast<char*>(&chunk_labels_data[0]);
-                auto mchunk_attrs =
-                    reinterpret_cast<playgo_mchunk_attr_entry_t*>(&mchunk_attrs_data[0]);
+        // Every count and offset comes from the file, check them against the loaded tables.
+        if (ret && playgoHeader.chunk_count >
+                       chunk_attrs_data.size() / sizeof(playgo_chunk_attr_entry_t)) {
+            ret = false;
+        }
+        if (ret) {
+            chunks.resize(playgoHeader.chunk_count);
+            const size_t num_mchunks =
+                mchunk_attrs_data.size() / sizeof(playgo_mchunk_attr_entry_t);
 
-                for (u16 i = 0; i < playgoHeader.chunk_count; i++) {
-                    chunks[i].req_locus = chunk_attrs[i].req_locus;
-                    chunks[i].language_mask = chunk_attrs[i].language_mask;
-                    chunks[i].label_name = std::string(chunk_labels + chunk_attrs[i].label_offset);
+            for (u16 i = 0; ret && i < playgoHeader.chunk_count; i++) {
+                playgo_chunk_attr_entry_t chunk_attr;
+                std::memcpy(&chunk_attr, chunk_attrs_data.data() + i * sizeof(chunk_attr),
+                            sizeof(chunk_attr));
+                if (chunk_attr.label_offset >= chunk_labels_data.size() ||
+                    u64(chunk_attr.mchunks_offset) + chunk_attr.mchunk_count * sizeof(u16) >
+                        chunk_mchunks_data.size()) {
+                    ret = false;
+                    break;
+                }
+                chunks[i].req_locus = chunk_attr.req_locus;
+                chunks[i].language_mask = chunk_attr.language_mask;
+                const char* label = chunk_labels_data.data() + chunk_attr.label_offset;
+                chunks[i].label_name = std::string(
+                    label, strnlen(label, chunk_labels_data.size() - chunk_attr.label_offset));
 
-                    u64 total_size = 0;
-                    u16 mchunk_count = chunk_attrs[i].mchunk_count;
-                    if (mchunk_count != 0) {
-                        auto mchunks = reinterpret_cast<u16*>(
-                            ((u8*)chunk_mchunks + chunk_attrs[i].mchunks_offset));
-                        for (u16 j = 0; j < mchunk_count; j++) {
-                            u16 mchunk_id = mchunks[j];
-                            total_size += mchunk_attrs[mchunk_id].size.size;
-                        }
+                u64 total_size = 0;
+                chunks[i].mchunks.clear();
+                for (u16 j = 0; j < chunk_attr.mchunk_count; j++) {
+                    u16 mchunk_id;
+                    std::memcpy(&mchunk_id,
+                                chunk_mchunks_data.data() + chunk_attr.mchunks_offset +
+                                    j * sizeof(u16),
+                                sizeof(u16));
+                    if (mchunk_id >= num_mchunks) {
+                        ret = false;
+                        break;
                     }
-                    chunks[i].total_size = total_size;
+                    playgo_mchunk_attr_entry_t mchunk;
+                    std::memcpy(&mchunk, mchunk_attrs_data.data() + mchunk_id * sizeof(mchunk),
+                                sizeof(mchunk));
+                    total_size += mchunk.size.size;
+                    chunks[i].mchunks.push_back({mchunk.loc.offset, mchunk.size.size,
+                                                 static_cast<u8>(mchunk.loc.image_no)});
                 }
+                chunks[i].total_size = total_size;
             }
+            if (!ret) {
+                chunks.clear();
+            }
+        }
 
-            return ret;
+        // The default scenario tells which chunks are installed first. Files without it are
+        // still usable, only the ordering is lost.
+        scenario_chunks.clear();
+        initial_chunk_count = 0;
+        std::string scenario_attrs_data, scenario_chunks_data;
+        if (ret && load_chunk_data(source, playgoHeader.scenario_attrs, scenario_attrs_data) &&
+            load_chunk_data(source, playgoHeader.scenario_chunks, scenario_chunks_data)) {
+            const u16 scenario_id = playgoHeader.default_scenario_id;
+            if ((scenario_id + 1) * sizeof(playgo_scenario_attr_entry_t) <=
+                scenario_attrs_data.size()) {
+                playgo_scenario_attr_entry_t scenario;
+                std::memcpy(&scenario,
+                            scenario_attrs_data.data() + scenario_id * sizeof(scenario),
+                            sizeof(scenario));
+                const u64 end = u64(scenario.chunks_offset) + scenario.chunk_count * sizeof(u16);
+                if (end <= scenario_chunks_data.size()) {
+                    scenario_chunks.resize(scenario.chunk_count);
+                    std::memcpy(scenario_chunks.data(),
+                                scenario_chunks_data.data() + scenario.chunks_offset,
+                                scenario.chunk_count * sizeof(u16));
+                    initial_chunk_count =
+                        std::min(scenario.initial_chunk_count, scenario.chunk_count);
+                }
+            }
         }
+
+        return ret;
     }
     return false;
 }
@@ -72,4 +134,13 @@ bool PlaygoFile::load_chunk_data(const Common::FS::IOFile& file, const chunk_t c
         }
     }
     return false;
-}
\ No newline at end of file
+}
+
+bool PlaygoFile::load_chunk_data(std::span<const u8> file, const chunk_t chunk,
+                                 std::string& data) {
+    if (u64(chunk.offset) + chunk.length > file.size()) {
+        return false;
+    }
+    data.assign(reinterpret_cast<const char*>(file.data()) + chunk.offset, chunk.length);
+    return true;
+}
@@ -4,16 +4,19 @@
 #pragma once
 #include <filesystem>
 #include <mutex>
+#include <span>
 #include <vector>
 #include "common/io_file.h"
 #include "core/libraries/playgo/playgo_types.h"
 
 constexpr u32 PLAYGO_MAGIC = 0x6F676C70;
 
+#pragma pack(push, 1)
+
 struct chunk_t {
     u32 offset;
     u32 length;
-} __attribute__((packed));
+};
 
 struct PlaygoHeader {
     u32 magic;
@@ -43,7 +46,7 @@ struct PlaygoHeader {
     chunk_t scenario_chunks;
     chunk_t scenario_labels;
     chunk_t inner_mchunk_attrs; // [0;12800]
-} __attribute__((packed));
+};
 
 struct playgo_scenario_attr_entry_t {
     u8 _type;
@@ -52,13 +55,13 @@ struct playgo_scenario_attr_entry_t {
     u16 chunk_count;
     u32 chunks_offset; //<-scenario_chunks
     u32 label_offset;  //<-scenario_labels
-} __attribute__((packed));
+};
 
 struct image_disc_layer_no_t {
     u8 layer_no : 2;
     u8 disc_no : 2;
     u8 image_no : 4;
-} __attribute__((packed));
+};
 
 struct playgo_chunk_attr_entry_t {
     u8 flag;
@@ -69,30 +72,40 @@ struct playgo_chunk_attr_entry_t {
     u64 language_mask;
     u32 mchunks_offset; //<-chunk_mchunks
     u32 label_offset;   //<-chunk_labels
-} __attribute__((packed));
+};
 
 struct playgo_chunk_loc_t {
     u64 offset : 48;
     u64 _align1 : 8;
     u64 image_no : 4;
     u64 _align2 : 4;
-} __attribute__((packed));
+};
 
 struct playgo_chunk_size_t {
     u64 size : 48;
     u64 _align : 16;
-} __attribute__((packed));
+};
 
 struct playgo_mchunk_attr_entry_t {
     playgo_chunk_loc_t loc;
     playgo_chunk_size_t size;
-} __attribute__((packed));
+};
+
+#pragma pack(pop)
+
+/// Byte range of an mchunk inside the PFS image.
+struct PlaygoMchunkRange {
+    u64 offset;
+    u64 size;
+    u8 image_no;
+};
 
 struct PlaygoChunk {
     u64 req_locus;
     u64 language_mask;
     u64 total_size;
     std::string label_name;
+    std::vector<PlaygoMchunkRange> mchunks;
 };
 
 class PlaygoFile {
@@ -105,12 +118,18 @@ public:
     OrbisPlayGoEta eta = 0;
     OrbisPlayGoLanguageMask langMask = 0;
     std::vector<PlaygoChunk> chunks;
+    // Chunks of the default scenario in install order, the first initial_chunk_count of them
+    // are needed before the title can boot.
+    std::vector<u16> scenario_chunks;
+    u16 initial_chunk_count = 0;
 
 public:
     explicit PlaygoFile() = default;
     ~PlaygoFile() = default;
 
     bool Open(const std::filesystem::path& filepath);
+    // Parses playgo-chunk.dat already in memory, e.g. the payload of PKG entry 0x1001.
+    bool Open(std::span<const u8> data);
     bool LoadChunks(const Common::FS::IOFile& file);
 
     PlaygoHeader& GetPlaygoHeader() {
@@ -122,6 +141,9 @@ public:
 
 private:
     bool load_chunk_data(const Common::FS::IOFile& file, const chunk_t chunk, std::string& data);
+    bool load_chunk_data(std::span<const u8> file, const chunk_t chunk, std::string& data);
+    template <typename Source>
+    bool LoadChunksFrom(const Source& source);
 
 private:
     PlaygoHeader playgoHeader;
@@ -6,6 +6,7 @@
 #include "common/assert.h"
 #include "common/io_file.h"
 #include "common/logging/log.h"
+#include "common/mapped_file.h"
 #include "core/file_format/psf.h"
 
 static const std::unordered_map<std::string_view, u32> psf_known_max_sizes = {
@@ -20,40 +21,111 @@ static inline u32 get_max_size(std::string_view key, u32 default_value) {
     return default_value;
 }
 
-bool PSF::Open(const std::filesystem::path& filepath) {
-    using namespace std::chrono;
-    if (std::filesystem::exists(filepath)) {
-        const auto t = std::filesystem::last_write_time(filepath);
-        const auto rel =
-            duration_cast<seconds>(t - std::filesystem::file_time_type::clock::now()).count();
-        const auto tp = system_clock::to_time_t(system_clock::now() + seconds{rel});
-        last_write = system_clock::from_time_t(tp);
+namespace {
+
+// In PSFKey order.
+constexpr std::array<std::string_view, PSFKeyCount> KnownKeyNames = {
+    "ACCOUNT_ID",
+    "APP_TYPE",
+    "APP_VER",
+    "ATTRIBUTE",
+    "ATTRIBUTE2",
+    "CATEGORY",
+    "CONTENT_ID",
+    "DETAIL",
+    "DOWNLOAD_DATA_SIZE",
+    "FORMAT",
+    "INSTALL_DIR_SAVEDATA",
+    "MAINTITLE",
+    "PARAMS",
+    "PARENTAL_LEVEL",
+    "PUBTOOLINFO",
+    "PUBTOOLMINVER",
+    "PUBTOOLVER",
+    "REMOTE_PLAY_KEY_ASSIGN",
+    "SAVEDATA_BLOCKS",
+    "SAVEDATA_DIRECTORY",
+    "SAVEDATA_LIST_PARAM",
+    "SERVICE_ID_ADDCONT_ADD_1",
+    "SUBTITLE",
+    "SYSTEM_ROOT_VER",
+    "SYSTEM_VER",
+    "TARGET_APP_VER",
+    "TITLE",
+    "TITLE_ID",
+    "USER_DEFINED_PARAM_1",
+    "USER_DEFINED_PARAM_2",
+    "USER_DEFINED_PARAM_3",
+    "USER_DEFINED_PARAM_4",
+    "VERSION",
+};
+
+// The names are hashed (FNV-1a) into a table with a seed picked at compile time so that no
+// two of them share a slot, a lookup is then one hash and one compare.
+constexpr size_t KnownKeySlots = 256;
+constexpr u8 NoKnownKey = 0xFF;
+
+constexpr u32 HashKey(std::string_view key, u32 seed) {
+    u32 hash = seed;
+    for (const char c : key) {
+        hash = (hash ^ static_cast<u8>(c)) * 0x01000193;
     }
+    return hash;
+}
 
-    Common::FS::IOFile file(filepath, Common::FS::FileAccessMode::Read);
-    if (!file.IsOpen()) {
-        return false;
+consteval u32 FindKnownKeySeed() {
+    for (u32 seed = 0x811C9DC5;; seed++) {
+        std::array<bool, KnownKeySlots> used{};
+        bool collision = false;
+        for (const auto name : KnownKeyNames) {
+            const u32 slot = HashKey(name, seed) % KnownKeySlots;
+            collision |= used[slot];
+            used[slot] = true;
+        }
+        if (!collision) {
+            return seed;
+        }
     }
+}
+
+constexpr u32 KnownKeySeed = FindKnownKeySeed();
 
-    const u64 psfSize = file.GetSize();
-    std::vector<u8> psf(psfSize);
-    file.Seek(0);
-    file.Read(psf);
-    file.Close();
-    return Open(psf);
+consteval std::array<u8, KnownKeySlots> BuildKnownKeyTable() {
+    std::array<u8, KnownKeySlots> table{};
+    table.fill(NoKnownKey);
+    for (size_t i = 0; i < KnownKeyNames.size(); i++) {
+        table[HashKey(KnownKeyNames[i], KnownKeySeed) % KnownKeySlots] = static_cast<u8>(i);
+    }
+    return table;
 }
 
-bool PSF::Open(const std::vector<u8>& psf_buffer) {
-    const u8* psf_data = psf_buffer.data();
+constexpr std::array<u8, KnownKeySlots> KnownKeyTable = BuildKnownKeyTable();
 
-    entry_list.clear();
-    map_binaries.clear();
-    map_strings.clear();
-    map_integers.clear();
+} // Anonymous namespace
+
+std::optional<PSFKey> FindPSFKey(std::string_view key) {
+    const u8 index = KnownKeyTable[HashKey(key, KnownKeySeed) % KnownKeySlots];
+    if (index == NoKnownKey || KnownKeyNames[index] != key) {
+        return std::nullopt;
+    }
+    return static_cast<PSFKey>(index);
+}
+
+std::string_view GetPSFKeyName(PSFKey key) {
+    return KnownKeyNames[static_cast<size_t>(key)];
+}
+
+bool PSFView::Open(std::span<const u8> buffer) {
+    data = {};
+    num_entries = 0;
+    known_index = {};
 
-    // Parse file contents
     PSFHeader header{};
-    std::memcpy(&header, psf_data, sizeof(header));
+    if (buffer.size() < sizeof(header)) {
+        LOG_ERROR(Core, "PSF file is too small");
+        return false;
+    }
+    std::memcpy(&header, buffer.data(), sizeof(header));
 
     if (header.magic != PSF_MAGIC) {
         LOG_ERROR(Core, "Invalid PSF magic number");
@@ -64,36 +136,122 @@ bool PSF::Open(const std::vector<u8>& psf_buffer) {
         return false;
     }
 
+    const u64 psf_size = buffer.size();
+    if (sizeof(PSFHeader) + u64(header.index_table_entries) * sizeof(PSFRawEntry) > psf_size ||
+        header.key_table_offset > psf_size || header.data_table_offset > psf_size) {
+        LOG_ERROR(Core, "PSF tables are out of the file");
+        return false;
+    }
+
+    // Everything GetEntry relies on is checked here, once.
     for (u32 i = 0; i < header.index_table_entries; i++) {
         PSFRawEntry raw_entry{};
-        std::memcpy(&raw_entry, psf_data + sizeof(PSFHeader) + i * sizeof(PSFRawEntry),
+        std::memcpy(&raw_entry, buffer.data() + sizeof(PSFHeader) + i * sizeof(PSFRawEntry),
                     sizeof(raw_entry));
 
-        Entry& entry = entry_list.emplace_back();
-        entry.key = std::string{(char*)(psf_data + header.key_table_offset + raw_entry.key_offset)};
-        entry.param_fmt = static_cast<PSFEntryFmt>(raw_entry.param_fmt.Raw());
-        entry.max_len = raw_entry.param_max_len;
+        const u64 key_pos = u64(header.key_table_offset) + raw_entry.key_offset;
+        const u64 data_pos = u64(header.data_table_offset) + raw_entry.data_offset;
+        if (key_pos >= psf_size || data_pos + raw_entry.param_len > psf_size) {
+            LOG_ERROR(Core, "PSF entry {} is out of the file", i);
+            return false;
+        }
+        const auto fmt = static_cast<PSFEntryFmt>(raw_entry.param_fmt.Raw());
+        if (fmt != PSFEntryFmt::Binary && fmt != PSFEntryFmt::Text &&
+            fmt != PSFEntryFmt::Integer) {
+            LOG_ERROR(Core, "PSF entry {} has an unknown format 0x{:04x}", i, u16(fmt));
+            return false;
+        }
+        if (fmt == PSFEntryFmt::Integer && raw_entry.param_len != sizeof(s32)) {
+            LOG_ERROR(Core, "PSF integer entry {} has size {}", i, u32(raw_entry.param_len));
+            return false;
+        }
 
-        const u8* data = psf_data + header.data_table_offset + raw_entry.data_offset;
+        // Strings are bounded by the end of the buffer, a mapped file has no terminator after it.
+        const char* key = reinterpret_cast<const char*>(buffer.data() + key_pos);
+        const auto known = FindPSFKey({key, strnlen(key, psf_size - key_pos)});
+        if (known && known_index[static_cast<size_t>(*known)] == 0) {
+            known_index[static_cast<size_t>(*known)] = i + 1;
+        }
+    }
 
-        switch (entry.param_fmt) {
-        case PSFEntryFmt::Binary: {
-            std::vector<u8> value(raw_entry.param_len);
-            std::memcpy(value.data(), data, raw_entry.param_len);
-            map_binaries.emplace(i, std::move(value));
-        } break;
-        case PSFEntryFmt::Text: {
-            std::string c_str{reinterpret_cast<const char*>(data)};
-            map_strings.emplace(i, std::move(c_str));
-        } break;
-        case PSFEntryFmt::Integer: {
-            ASSERT_MSG(raw_entry.param_len == sizeof(s32), "PSF integer entry size mismatch");
-            s32 integer = *(s32*)data;
-            map_integers.emplace(i, integer);
-        } break;
-        default:
-            UNREACHABLE_MSG("Unknown PSF entry format");
+    data = buffer;
+    key_table_offset = header.key_table_offset;
+    data_table_offset = header.data_table_offset;
+    num_entries = header.index_table_entries;
+    return true;
+}
+
+PSFView::Entry PSFView::GetEntry(u32 index) const {
+    PSFRawEntry raw_entry{};
+    std::memcpy(&raw_entry, data.data() + sizeof(PSFHeader) + index * sizeof(PSFRawEntry),
+                sizeof(raw_entry));
+    const u64 key_pos = u64(key_table_offset) + raw_entry.key_offset;
+    const char* key = reinterpret_cast<const char*>(data.data() + key_pos);
+    return {
+        .key = {key, strnlen(key, data.size() - key_pos)},
+        .param_fmt = static_cast<PSFEntryFmt>(raw_entry.param_fmt.Raw()),
+        .max_len = raw_entry.param_max_len,
+        .value = data.subspan(u64(data_table_offset) + raw_entry.data_offset,
+                              raw_entry.param_len),
+    };
+}
+
+std::optional<u32> PSFView::FindEntry(std::string_view key) const {
+    if (const auto known = FindPSFKey(key)) {
+        return FindEntry(*known);
+    }
+    for (u32 i = 0; i < num_entries; i++) {
+        if (GetEntry(i).key == key) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+bool PSF::Open(const std::filesystem::path& filepath) {
+    using namespace std::chrono;
+    if (std::filesystem::exists(filepath)) {
+        const auto t = std::filesystem::last_write_time(filepath);
+        const auto rel =
+            duration_cast<seconds>(t - std::filesystem::file_time_type::clock::now()).count();
+        const auto tp = system_clock::to_time_t(system_clock::now() + seconds{rel});
+        last_write = system_clock::from_time_t(tp);
+    }
+
+    // Parsed straight from the mapped file, the values are copied out below.
+    const Common::FS::MappedFile file(filepath);
+    if (!file.IsMapped()) {
+        return false;
+    }
+    return Open(file.Span());
+}
+
+bool PSF::Open(std::span<const u8> psf_buffer) {
+    entry_list.clear();
+    map_binaries.clear();
+    map_strings.clear();
+    map_integers.clear();
+    known_index = {};
+
+    PSFView view;
+    if (!view.Open(psf_buffer)) {
+        return false;
+    }
+    entry_list.reserve(view.GetNumEntries());
+    for (u32 i = 0; i < view.GetNumEntries(); i++) {
+        const PSFView::Entry raw_entry = view.GetEntry(i);
+        switch (raw_entry.param_fmt) {
+        case PSFEntryFmt::Binary:
+            map_binaries.emplace(i, std::vector<u8>(raw_entry.value.begin(), raw_entry.value.end()));
+            break;
+        case PSFEntryFmt::Text:
+            map_strings.emplace(i, std::string{raw_entry.AsString()});
+            break;
+        case PSFEntryFmt::Integer:
+            map_integers.emplace(i, raw_entry.AsInteger());
+            break;
         }
+        AddEntry({std::string{raw_entry.key}, raw_entry.param_fmt, raw_entry.max_len});
     }
     return true;
 }
@@ -225,10 +383,8 @@ void PSF::AddBinary(std::string key, std::vector<u8> value, bool update) {
         map_binaries.at(index) = std::move(value);
         return;
     }
-    Entry& entry = entry_list.emplace_back();
-    entry.max_len = get_max_size(key, value.size());
-    entry.key = std::move(key);
-    entry.param_fmt = PSFEntryFmt::Binary;
+    const u32 max_len = get_max_size(key, value.size());
+    AddEntry({std::move(key), PSFEntryFmt::Binary, max_len});
     map_binaries.emplace(entry_list.size() - 1, std::move(value));
 }
 
@@ -251,10 +407,8 @@ void PSF::AddString(std::string key, std::string value, bool update) {
         map_strings.at(index) = std::move(value);
         return;
     }
-    Entry& entry = entry_list.emplace_back();
-    entry.max_len = get_max_size(key, value.size() + 1);
-    entry.key = std::move(key);
-    entry.param_fmt = PSFEntryFmt::Text;
+    const u32 max_len = get_max_size(key, value.size() + 1);
+    AddEntry({std::move(key), PSFEntryFmt::Text, max_len});
     map_strings.emplace(entry_list.size() - 1, std::move(value));
 }
 
@@ -271,22 +425,37 @@ void PSF::AddInteger(std::string key, s32 value, bool update) {
         map_integers.at(index) = value;
         return;
     }
-    Entry& entry = entry_list.emplace_back();
-    entry.key = std::move(key);
-    entry.param_fmt = PSFEntryFmt::Integer;
-    entry.max_len = sizeof(s32);
+    AddEntry({std::move(key), PSFEntryFmt::Integer, sizeof(s32)});
     map_integers.emplace(entry_list.size() - 1, value);
 }
 
-std::pair<std::vector<PSF::Entry>::iterator, size_t> PSF::FindEntry(std::string_view key) {
-    auto entry =
+void PSF::AddEntry(Entry entry) {
+    if (const auto known = FindPSFKey(entry.key)) {
+        u32& index = known_index[static_cast<size_t>(*known)];
+        if (index == 0) {
+            index = static_cast<u32>(entry_list.size()) + 1;
+        }
+    }
+    entry_list.push_back(std::move(entry));
+}
+
+size_t PSF::FindIndex(std::string_view key) const {
+    if (const auto known = FindPSFKey(key)) {
+        const u32 index = known_index[static_cast<size_t>(*known)];
+        return index != 0 ? index - 1 : entry_list.size();
+    }
+    const auto entry =
         std::ranges::find_if(entry_list, [&](const auto& entry) { return entry.key == key; });
-    return {entry, std::distance(entry_list.begin(), entry)};
+    return std::distance(entry_list.begin(), entry);
+}
+
+std::pair<std::vector<PSF::Entry>::iterator, size_t> PSF::FindEntry(std::string_view key) {
+    const size_t index = FindIndex(key);
+    return {entry_list.begin() + index, index};
 }
 
 std::pair<std::vector<PSF::Entry>::const_iterator, size_t> PSF::FindEntry(
     std::string_view key) const {
-    auto entry =
-        std::ranges::find_if(entry_list, [&](const auto& entry) { return entry.key == key; });
-    return {entry, std::distance(entry_list.begin(), entry)};
+    const size_t index = FindIndex(key);
+    return {entry_list.begin() + index, index};
 }
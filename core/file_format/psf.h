@@ -3,8 +3,11 @@
 
 #pragma once
 
+#include <array>
 #include <chrono>
+#include <cstring>
 #include <filesystem>
+#include <optional>
 #include <span>
 #include <string>
 #include <string_view>
@@ -40,6 +43,126 @@ enum class PSFEntryFmt : u16 {
     Integer = 0x0404, // Signed 32-bit integer
 };
 
+/// param.sfo keys found in constant time by PSFView and PSF. Any other key works too, through
+/// a scan of the entries.
+enum class PSFKey : u8 {
+    ACCOUNT_ID,
+    APP_TYPE,
+    APP_VER,
+    ATTRIBUTE,
+    ATTRIBUTE2,
+    CATEGORY,
+    CONTENT_ID,
+    DETAIL,
+    DOWNLOAD_DATA_SIZE,
+    FORMAT,
+    INSTALL_DIR_SAVEDATA,
+    MAINTITLE,
+    PARAMS,
+    PARENTAL_LEVEL,
+    PUBTOOLINFO,
+    PUBTOOLMINVER,
+    PUBTOOLVER,
+    REMOTE_PLAY_KEY_ASSIGN,
+    SAVEDATA_BLOCKS,
+    SAVEDATA_DIRECTORY,
+    SAVEDATA_LIST_PARAM,
+    SERVICE_ID_ADDCONT_ADD_1,
+    SUBTITLE,
+    SYSTEM_ROOT_VER,
+    SYSTEM_VER,
+    TARGET_APP_VER,
+    TITLE,
+    TITLE_ID,
+    USER_DEFINED_PARAM_1,
+    USER_DEFINED_PARAM_2,
+    USER_DEFINED_PARAM_3,
+    USER_DEFINED_PARAM_4,
+    VERSION,
+    Count,
+};
+constexpr size_t PSFKeyCount = static_cast<size_t>(PSFKey::Count);
+
+/// Returns the well-known key called `key`, through a perfect hash of the names.
+std::optional<PSFKey> FindPSFKey(std::string_view key);
+std::string_view GetPSFKeyName(PSFKey key);
+
+/**
+ * Read-only param.sfo over a buffer owned by someone else, such as a mapped file or a PKG
+ * entry. Open only validates the tables, keys and values are handed out as views into the
+ * buffer, so nothing is copied or allocated. Well-known keys are indexed while opening and
+ * looked up in constant time.
+ */
+class PSFView {
+public:
+    struct Entry {
+        std::string_view key;
+        PSFEntryFmt param_fmt;
+        u32 max_len;
+        std::span<const u8> value; // param_len bytes
+
+        /// The text up to its terminator, for PSFEntryFmt::Text.
+        std::string_view AsString() const {
+            const char* text = reinterpret_cast<const char*>(value.data());
+            return {text, strnlen(text, value.size())};
+        }
+        /// For PSFEntryFmt::Integer, Open checked the size.
+        s32 AsInteger() const {
+            s32 integer;
+            std::memcpy(&integer, value.data(), sizeof(integer));
+            return integer;
+        }
+    };
+
+    /// Checks the header and that every entry lies inside `buffer`, which has to outlive the
+    /// view. False (and logged) on a malformed file.
+    bool Open(std::span<const u8> buffer);
+
+    u32 GetNumEntries() const {
+        return num_entries;
+    }
+    Entry GetEntry(u32 index) const;
+
+    /// Index of the first entry called `key`.
+    std::optional<u32> FindEntry(std::string_view key) const;
+    std::optional<u32> FindEntry(PSFKey key) const {
+        const u32 index = known_index[static_cast<size_t>(key)];
+        return index != 0 ? std::optional<u32>{index - 1} : std::nullopt;
+    }
+
+    /// Empty when the key is missing or holds another format. `key` is a PSFKey or a name.
+    template <typename Key>
+    std::optional<std::span<const u8>> GetBinary(const Key& key) const {
+        const auto entry = FindTyped(FindEntry(key), PSFEntryFmt::Binary);
+        return entry ? std::optional{entry->value} : std::nullopt;
+    }
+    template <typename Key>
+    std::optional<std::string_view> GetString(const Key& key) const {
+        const auto entry = FindTyped(FindEntry(key), PSFEntryFmt::Text);
+        return entry ? std::optional{entry->AsString()} : std::nullopt;
+    }
+    template <typename Key>
+    std::optional<s32> GetInteger(const Key& key) const {
+        const auto entry = FindTyped(FindEntry(key), PSFEntryFmt::Integer);
+        return entry ? std::optional{entry->AsInteger()} : std::nullopt;
+    }
+
+private:
+    std::optional<Entry> FindTyped(std::optional<u32> index, PSFEntryFmt fmt) const {
+        if (!index) {
+            return std::nullopt;
+        }
+        const Entry entry = GetEntry(*index);
+        return entry.param_fmt == fmt ? std::optional{entry} : std::nullopt;
+    }
+
+    std::span<const u8> data;
+    u32 key_table_offset = 0;
+    u32 data_table_offset = 0;
+    u32 num_entries = 0;
+    std::array<u32, PSFKeyCount> known_index{}; // entry index + 1, 0 when missing
+};
+
 class PSF {
     struct Entry {
         std::string key;
@@ -57,7 +180,7 @@ public:
     PSF& operator=(PSF&& other) noexcept = default;
 
     bool Open(const std::filesystem::path& filepath);
-    bool Open(const std::vector<u8>& psf_buffer);
+    bool Open(std::span<const u8> psf_buffer);
 
     [[nodiscard]] std::vector<u8> Encode() const;
     void Encode(std::vector<u8>& buf) const;
@@ -89,6 +212,10 @@ private:
     std::unordered_map<size_t, std::string> map_strings;
     std::unordered_map<size_t, s32> map_integers;
 
+    std::array<u32, PSFKeyCount> known_index{}; // entry index + 1, 0 when missing
+
+    [[nodiscard]] size_t FindIndex(std::string_view key) const;
+    void AddEntry(Entry entry);
     [[nodiscard]] std::pair<std::vector<Entry>::iterator, size_t> FindEntry(std::string_view key);
     [[nodiscard]] std::pair<std::vector<Entry>::const_iterator, size_t> FindEntry(
         std::string_view key) const;
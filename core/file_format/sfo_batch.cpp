@@ -0,0 +1,270 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <optional>
+
+#include "common/mapped_file.h"
+#include "common/parallel_for.h"
+#include "common/path_util.h"
+#include "common/string_util.h"
+#include "core/file_format/pkg_scan.h"
+#include "core/file_format/psf.h"
+#include "core/file_format/sfo_batch.h"
+
+namespace {
+
+constexpr std::array<u8, 4> PkgMagic = {0x7F, 'C', 'N', 'T'};
+constexpr u32 ParamSfoId = 0x1000;
+
+// Rows handed to a worker at once, each block fills its own columns so no lock is taken.
+constexpr size_t RowsPerBlock = 64;
+
+constexpr std::array<std::string_view, 9> DefaultKeys = {
+    "TITLE",   "TITLE_ID",   "APP_VER",  "CATEGORY",      "CONTENT_ID",
+    "VERSION", "SYSTEM_VER", "APP_TYPE", "PARENTAL_LEVEL"};
+
+std::filesystem::path GetGameSfoPath(const std::filesystem::path& dir) {
+    return dir / "sce_sys" / "param.sfo";
+}
+
+bool IsGameDirectory(const std::filesystem::path& dir) {
+    std::error_code ec;
+    return std::filesystem::is_regular_file(GetGameSfoPath(dir), ec);
+}
+
+// A requested key, resolved once to its slot in PSFView's index when it is a known one.
+struct ColumnKey {
+    std::string_view name;
+    std::optional<PSFKey> known;
+};
+
+// Appends the value of `key`, or nothing when it is missing.
+void AppendValue(const PSFView& psf, const ColumnKey& key, SfoColumn& column) {
+    const auto index = key.known ? psf.FindEntry(*key.known) : psf.FindEntry(key.name);
+    bool present = index.has_value();
+    if (present) {
+        const PSFView::Entry entry = psf.GetEntry(*index);
+        switch (entry.param_fmt) {
+        case PSFEntryFmt::Text:
+            column.data += entry.AsString();
+            break;
+        case PSFEntryFmt::Integer:
+            column.data += std::to_string(entry.AsInteger());
+            break;
+        case PSFEntryFmt::Binary:
+            for (const u8 byte : entry.value) {
+                static constexpr char Digits[] = "0123456789abcdef";
+                column.data += Digits[byte >> 4];
+                column.data += Digits[byte & 0xF];
+            }
+            break;
+        default:
+            present = false;
+            break;
+        }
+    }
+    column.offsets.push_back(column.data.size());
+    column.present.push_back(present ? 1 : 0);
+}
+
+// Maps the part of `source` holding param.sfo and returns it, empty with `error` set if
+// there is none.
+std::span<const u8> MapSfo(const std::filesystem::path& source, Common::FS::MappedFile& file,
+                           std::string& error) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(source, ec)) {
+        if (!file.Map(GetGameSfoPath(source))) {
+            error = "Failed to open sce_sys/param.sfo";
+            return {};
+        }
+        return file.Span();
+    }
+    if (!file.Map(source)) {
+        error = "Failed to open file";
+        return {};
+    }
+    const std::span<const u8> data = file.Span();
+    if (data.size() < PkgMagic.size() ||
+        std::memcmp(data.data(), PkgMagic.data(), PkgMagic.size()) != 0) {
+        // Not a PKG, take it for a param.sfo itself.
+        return data;
+    }
+    // Only the header, the entry table and param.sfo are touched.
+    file.Advise(Common::FS::MapHint::Random);
+    const auto sfo = FindPKGEntry(data, ParamSfoId);
+    if (sfo.empty()) {
+        error = "PKG has no param.sfo";
+    }
+    return sfo;
+}
+
+void ReadRow(const std::filesystem::path& source, std::span<const ColumnKey> keys,
+             SfoTable& block) {
+    Common::FS::MappedFile file;
+    std::string error;
+    PSFView psf;
+    const auto sfo = MapSfo(source, file, error);
+    if (!sfo.empty() && !psf.Open(sfo)) {
+        error = "Invalid param.sfo";
+    }
+    const bool valid = error.empty();
+    block.valid.push_back(valid ? 1 : 0);
+    block.errors.push_back(std::move(error));
+    for (size_t k = 0; k < keys.size(); k++) {
+        SfoColumn& column = block.columns[k];
+        if (valid) {
+            AppendValue(psf, keys[k], column);
+        } else {
+            column.offsets.push_back(column.data.size());
+            column.present.push_back(0);
+        }
+    }
+}
+
+} // Anonymous namespace
+
+const SfoColumn* SfoTable::FindColumn(std::string_view key) const {
+    const auto it = std::ranges::find(columns, key, &SfoColumn::key);
+    return it != columns.end() ? &*it : nullptr;
+}
+
+std::span<const std::string_view> GetDefaultSfoKeys() {
+    return DefaultKeys;
+}
+
+std::vector<std::filesystem::path> FindSfoSources(std::span<const std::filesystem::path> roots) {
+    namespace fs = std::filesystem;
+
+    std::vector<fs::path> sources;
+    std::vector<fs::path> library_roots;
+    for (const auto& root : roots) {
+        std::error_code ec;
+        if (!fs::is_directory(root, ec)) {
+            sources.push_back(root);
+            continue;
+        }
+        if (IsGameDirectory(root)) {
+            sources.push_back(root);
+            continue;
+        }
+        library_roots.push_back(root);
+        // Installed games sit directly inside the library folder, one per title.
+        const size_t first_game = sources.size();
+        for (auto it = fs::directory_iterator(root, fs::directory_options::skip_permission_denied,
+                                              ec);
+             !ec && it != fs::directory_iterator(); it.increment(ec)) {
+            std::error_code type_ec;
+            if (it->is_directory(type_ec) && IsGameDirectory(it->path())) {
+                sources.push_back(it->path());
+            }
+        }
+        std::sort(sources.begin() + first_game, sources.end());
+    }
+
+    const auto packages = FindPKGFiles(library_roots);
+    sources.insert(sources.end(), packages.begin(), packages.end());
+    return sources;
+}
+
+SfoTable ReadSfoBatch(std::span<const std::filesystem::path> sources,
+                      std::span<const std::string> keys, size_t max_threads) {
+    std::vector<ColumnKey> column_keys;
+    column_keys.reserve(keys.size());
+    for (const auto& key : keys) {
+        column_keys.push_back({key, FindPSFKey(key)});
+    }
+
+    const size_t num_blocks = (sources.size() + RowsPerBlock - 1) / RowsPerBlock;
+    std::vector<SfoTable> blocks(num_blocks);
+    Common::ParallelFor(
+        num_blocks,
+        [&](size_t b) {
+            SfoTable& block = blocks[b];
+            const size_t begin = b * RowsPerBlock;
+            const size_t end = std::min(sources.size(), begin + RowsPerBlock);
+            block.columns.resize(column_keys.size());
+            for (SfoColumn& column : block.columns) {
+                column.offsets.reserve(end - begin);
+                column.present.reserve(end - begin);
+            }
+            for (size_t i = begin; i < end; i++) {
+                ReadRow(sources[i], column_keys, block);
+            }
+        },
+        max_threads);
+
+    // Stitch the blocks together in order, offsets are rebased onto the joined data.
+    SfoTable table;
+    table.sources.assign(sources.begin(), sources.end());
+    table.valid.reserve(sources.size());
+    table.errors.reserve(sources.size());
+    table.columns.resize(keys.size());
+    for (size_t k = 0; k < keys.size(); k++) {
+        SfoColumn& column = table.columns[k];
+        column.key = keys[k];
+        size_t data_size = 0;
+        for (const SfoTable& block : blocks) {
+            data_size += block.columns[k].data.size();
+        }
+        column.data.reserve(data_size);
+        column.offsets.reserve(sources.size() + 1);
+        column.offsets.push_back(0);
+        column.present.reserve(sources.size());
+        for (const SfoTable& block : blocks) {
+            const SfoColumn& part = block.columns[k];
+            const u64 base = column.data.size();
+            column.data += part.data;
+            for (const u64 offset : part.offsets) {
+                column.offsets.push_back(base + offset);
+            }
+            column.present.insert(column.present.end(), part.present.begin(),
+                                  part.present.end());
+        }
+    }
+    for (SfoTable& block : blocks) {
+        table.valid.insert(table.valid.end(), block.valid.begin(), block.valid.end());
+        std::ranges::move(block.errors, std::back_inserter(table.errors));
+    }
+    return table;
+}
+
+void WriteSfoTableJson(std::ostream& out, const SfoTable& table) {
+    using Common::EscapeJsonString;
+    out << "[\n";
+    for (size_t i = 0; i < table.GetNumRows(); i++) {
+        out << "  {\"path\":\"" << EscapeJsonString(Common::FS::PathToUTF8String(table.sources[i]))
+            << "\",\"valid\":" << (table.valid[i] ? "true" : "false");
+        if (!table.valid[i]) {
+            out << ",\"error\":\"" << EscapeJsonString(table.errors[i]) << '"';
+        }
+        for (const SfoColumn& column : table.columns) {
+            if (column.Has(i)) {
+                out << ",\"" << EscapeJsonString(column.key) << "\":\""
+                    << EscapeJsonString(column.Get(i)) << '"';
+            }
+        }
+        out << (i + 1 < table.GetNumRows() ? "},\n" : "}\n");
+    }
+    out << "]\n";
+}
+
+void WriteSfoTableCsv(std::ostream& out, const SfoTable& table) {
+    using Common::EscapeCsvField;
+    out << "path,valid,error";
+    for (const SfoColumn& column : table.columns) {
+        out << ',' << EscapeCsvField(column.key);
+    }
+    out << '\n';
+    for (size_t i = 0; i < table.GetNumRows(); i++) {
+        out << EscapeCsvField(Common::FS::PathToUTF8String(table.sources[i])) << ','
+            << (table.valid[i] ? "true" : "false") << ',' << EscapeCsvField(table.errors[i]);
+        for (const SfoColumn& column : table.columns) {
+            out << ',' << EscapeCsvField(column.Get(i));
+        }
+        out << '\n';
+    }
+}
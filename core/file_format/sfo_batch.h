@@ -0,0 +1,64 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <filesystem>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "common/types.h"
+
+/// The values of one param.sfo key for every title of a batch, stored back to back.
+struct SfoColumn {
+    std::string key;
+    std::string data;         // every value, one after the other
+    std::vector<u64> offsets; // value of row i is data[offsets[i], offsets[i + 1])
+    std::vector<u8> present;  // 0 when the title has no such key
+
+    std::string_view Get(size_t row) const {
+        return std::string_view{data}.substr(offsets[row], offsets[row + 1] - offsets[row]);
+    }
+    bool Has(size_t row) const {
+        return present[row] != 0;
+    }
+};
+
+/// param.sfo values of many titles, one row per source and one column per requested key.
+struct SfoTable {
+    std::vector<std::filesystem::path> sources;
+    std::vector<u8> valid;           // 0 when the source had no readable param.sfo
+    std::vector<std::string> errors; // empty for valid rows
+    std::vector<SfoColumn> columns;
+
+    size_t GetNumRows() const {
+        return sources.size();
+    }
+    /// Null when `key` was not requested.
+    const SfoColumn* FindColumn(std::string_view key) const;
+};
+
+/// The keys read when none are given.
+std::span<const std::string_view> GetDefaultSfoKeys();
+
+/**
+ * Collects the titles below `roots`: every .pkg file, walked like FindPKGFiles, plus every
+ * installed game directory (one holding sce_sys/param.sfo) given as a root or found directly
+ * inside one. Plain files given as roots are returned as they are.
+ */
+std::vector<std::filesystem::path> FindSfoSources(std::span<const std::filesystem::path> roots);
+
+/**
+ * Reads `keys` from the param.sfo of every source in parallel, keeping the order of
+ * `sources`. A source is a PKG (param.sfo is located through its entry table), a game
+ * directory (sce_sys/param.sfo) or a param.sfo file. Everything is parsed in place from
+ * mappings, only the requested values are copied into the columns. Integer values are stored
+ * as decimal text, binary ones as hex.
+ */
+SfoTable ReadSfoBatch(std::span<const std::filesystem::path> sources,
+                      std::span<const std::string> keys, size_t max_threads = 0);
+
+void WriteSfoTableJson(std::ostream& out, const SfoTable& table);
+void WriteSfoTableCsv(std::ostream& out, const SfoTable& table);
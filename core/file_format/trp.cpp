@@ -1,27 +1,28 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include "common/config.h"
 #include "common/logging/log.h"
+#include "common/mapped_file.h"
+#include "common/parallel_for.h"
 #include "common/path_util.h"
 #include "trp.h"
 
 TRP::TRP() = default;
 TRP::~TRP() = default;
 
-void TRP::GetNPcommID(const std::filesystem::path& trophyPath, int index) {
-    std::filesystem::path trpPath = trophyPath / "sce_sys/npbind.dat";
-    Common::FS::IOFile npbindFile(trpPath, Common::FS::FileAccessMode::Read);
-    if (!npbindFile.IsOpen()) {
-        LOG_CRITICAL(Common_Filesystem, "Failed to open npbind.dat file");
-        return;
-    }
-    if (!npbindFile.Seek(0x84 + (index * 0x180))) {
-        LOG_CRITICAL(Common_Filesystem, "Failed to seek to NPbind offset");
-        return;
+std::array<u8, 16> TRP::GetNPcommID(std::span<const u8> npbind, size_t index) const {
+    std::array<u8, 16> np_comm_id{}; // 12 bytes of id, the rest stays 0, we need 16 bytes.
+    const size_t offset = 0x84 + index * 0x180;
+    if (offset + 12 > npbind.size()) {
+        LOG_CRITICAL(Common_Filesystem, "NPbind entry {} is out of npbind.dat", index);
+        return np_comm_id;
     }
-    npbindFile.ReadRaw<u8>(np_comm_id.data(), 12);
-    std::fill(np_comm_id.begin() + 12, np_comm_id.end(), 0); // fill with 0, we need 16 bytes.
+    std::copy_n(npbind.begin() + offset, 12, np_comm_id.begin());
+    return np_comm_id;
 }
 
 static void removePadding(std::vector<u8>& vec) {
@@ -34,105 +35,194 @@ static void removePadding(std::vector<u8>& vec) {
     }
 }
 
-static void hexToBytes(const char* hex, unsigned char* dst) {
-    for (size_t i = 0; hex[i] != 0; i++) {
-        const unsigned char value = (hex[i] < 0x3A) ? (hex[i] - 0x30) : (hex[i] - 0x37);
-        dst[i / 2] |= ((i % 2) == 0) ? (value << 4) : (value);
+static bool hexToBytes(std::string_view hex, std::span<u8> dst) {
+    if (hex.size() != dst.size() * 2) {
+        return false;
+    }
+    std::fill(dst.begin(), dst.end(), 0);
+    for (size_t i = 0; i < hex.size(); i++) {
+        const char c = hex[i];
+        u8 value;
+        if (c >= '0' && c <= '9') {
+            value = c - '0';
+        } else if (c >= 'A' && c <= 'F') {
+            value = c - 'A' + 10;
+        } else if (c >= 'a' && c <= 'f') {
+            value = c - 'a' + 10;
+        } else {
+            return false;
+        }
+        dst[i / 2] |= ((i % 2) == 0) ? (value << 4) : value;
     }
+    return true;
 }
 
 bool TRP::Extract(const std::filesystem::path& trophyPath, const std::string titleId) {
+    return ExtractTo(trophyPath, Common::FS::GetUserPath(Common::FS::PathType::MetaDataDir) /
+                                     titleId / "TrophyFiles");
+}
+
+namespace {
+
+struct TrpFile {
+    std::filesystem::path output;
+    Common::FS::MappedFile file; // The whole .trp, entries are used in place.
+    std::array<u8, 16> np_comm_id;
+};
+
+struct TrpJob {
+    size_t file;
+    TrpEntry entry;
+};
+
+} // Anonymous namespace
+
+bool TRP::ExtractTo(const std::filesystem::path& trophyPath,
+                    const std::filesystem::path& outputPath, size_t max_threads) {
     std::filesystem::path gameSysDir = trophyPath / "sce_sys/trophy/";
     if (!std::filesystem::exists(gameSysDir)) {
         LOG_CRITICAL(Common_Filesystem, "Game sce_sys directory doesn't exist");
         return false;
     }
 
-    const auto user_key_str = Config::getTrophyKey();
-    if (user_key_str.size() != 32) {
+    std::array<u8, 16> user_key{};
+    if (!hexToBytes(Config::getTrophyKey(), user_key)) {
         LOG_CRITICAL(Common_Filesystem, "Trophy decryption key is not specified");
         return false;
     }
 
-    std::array<CryptoPP::byte, 16> user_key{};
-    hexToBytes(user_key_str.c_str(), user_key.data());
-
-    for (int index = 0; const auto& it : std::filesystem::directory_iterator(gameSysDir)) {
+    // trophyNN.trp uses the NN-th npbind.dat entry, walk them in name order.
+    std::vector<std::filesystem::path> trp_paths;
+    for (const auto& it : std::filesystem::directory_iterator(gameSysDir)) {
         if (it.is_regular_file()) {
-            GetNPcommID(trophyPath, index);
+            trp_paths.push_back(it.path());
+        }
+    }
+    std::ranges::sort(trp_paths);
+
+    const Common::FS::MappedFile npbindFile(trophyPath / "sce_sys/npbind.dat");
+    if (!npbindFile.IsMapped()) {
+        LOG_CRITICAL(Common_Filesystem, "Failed to open npbind.dat file");
+    }
+    const std::span<const u8> npbind = npbindFile.Span();
+
+    // Map every .trp and collect its entries concurrently.
+    std::vector<TrpFile> files(trp_paths.size());
+    std::vector<std::vector<TrpJob>> file_jobs(trp_paths.size());
+    std::atomic<bool> failed{false};
+    Common::ParallelFor(
+        trp_paths.size(),
+        [&](size_t index) {
+            TrpFile& trp = files[index];
+            trp.np_comm_id = GetNPcommID(npbind, index);
+            trp.output = outputPath / trp_paths[index].stem();
 
-            Common::FS::IOFile file(it.path(), Common::FS::FileAccessMode::Read);
-            if (!file.IsOpen()) {
+            if (!trp.file.Map(trp_paths[index])) {
                 LOG_CRITICAL(Common_Filesystem, "Unable to open trophy file for read");
-                return false;
+                failed = true;
+                return;
+            }
+            const std::span<const u8> data = trp.file.Span();
+            if (data.size() < sizeof(TrpHeader)) {
+                LOG_CRITICAL(Common_Filesystem, "Failed to read trophy file");
+                failed = true;
+                return;
             }
+            trp.file.Advise(Common::FS::MapHint::WillNeed);
 
             TrpHeader header;
-            file.Read(header);
+            Common::DecodeBigEndian(data, std::span{&header, 1});
             if (header.magic != 0xDCA24D00) {
                 LOG_CRITICAL(Common_Filesystem, "Wrong trophy magic number");
-                return false;
+                failed = true;
+                return;
+            }
+            // Workers must not throw, a failure is reported like the others.
+            std::error_code ec;
+            std::filesystem::create_directories(trp.output / "Icons", ec);
+            if (!ec) {
+                std::filesystem::create_directories(trp.output / "Xml", ec);
+            }
+            if (ec) {
+                LOG_CRITICAL(Common_Filesystem, "Failed to create trophy output folder: {}",
+                             ec.message());
+                failed = true;
+                return;
             }
 
-            s64 seekPos = sizeof(TrpHeader);
-            std::filesystem::path trpFilesPath(
-                Common::FS::GetUserPath(Common::FS::PathType::MetaDataDir) / titleId /
-                "TrophyFiles" / it.path().stem());
-            std::filesystem::create_directories(trpFilesPath / "Icons");
-            std::filesystem::create_directories(trpFilesPath / "Xml");
-
-            for (int i = 0; i < header.entry_num; i++) {
-                if (!file.Seek(seekPos)) {
+            // Gather the raw entries, then decode the whole table with one swap.
+            std::vector<TrpEntry> entries(header.entry_num);
+            for (u64 i = 0; i < header.entry_num; i++) {
+                const u64 entryPos = sizeof(TrpHeader) + i * header.entry_size;
+                if (entryPos + sizeof(TrpEntry) > data.size()) {
                     LOG_CRITICAL(Common_Filesystem, "Failed to seek to TRP entry offset");
-                    return false;
-                }
-                seekPos += (s64)header.entry_size;
-                TrpEntry entry;
-                file.Read(entry);
-                std::string_view name(entry.entry_name);
-                if (entry.flag == 0 && name.find("TROP") != std::string::npos) { // PNG
-                    if (!file.Seek(entry.entry_pos)) {
-                        LOG_CRITICAL(Common_Filesystem, "Failed to seek to TRP entry offset");
-                        return false;
-                    }
-                    std::vector<u8> icon(entry.entry_len);
-                    file.Read(icon);
-                    Common::FS::IOFile::WriteBytes(trpFilesPath / "Icons" / name, icon);
+                    failed = true;
+                    return;
                 }
-                if (entry.flag == 3 && np_comm_id[0] == 'N' &&
-                    np_comm_id[1] == 'P') { // ESFM, encrypted.
-                    if (!file.Seek(entry.entry_pos)) {
-                        LOG_CRITICAL(Common_Filesystem, "Failed to seek to TRP entry offset");
-                        return false;
-                    }
-                    file.Read(esfmIv); // get iv key.
-                    // Skip the first 16 bytes which are the iv key on every entry as we want a
-                    // clean xml file.
-                    std::vector<u8> ESFM(entry.entry_len - iv_len);
-                    std::vector<u8> XML(entry.entry_len - iv_len);
-                    if (!file.Seek(entry.entry_pos + iv_len)) {
-                        LOG_CRITICAL(Common_Filesystem, "Failed to seek to TRP entry + iv offset");
-                        return false;
-                    }
-                    file.Read(ESFM);
-                    crypto.decryptEFSM(user_key, np_comm_id, esfmIv, ESFM, XML); // decrypt
-                    removePadding(XML);
-                    std::string xml_name = entry.entry_name;
-                    size_t pos = xml_name.find("ESFM");
-                    if (pos != std::string::npos)
-                        xml_name.replace(pos, xml_name.length(), "XML");
-                    std::filesystem::path path = trpFilesPath / "Xml" / xml_name;
-                    size_t written = Common::FS::IOFile::WriteBytes(path, XML);
-                    if (written != XML.size()) {
-                        LOG_CRITICAL(
-                            Common_Filesystem,
-                            "Trophy XML {} write failed, wanted to write {} bytes, wrote {}",
-                            fmt::UTF(path.u8string()), XML.size(), written);
-                    }
+                std::memcpy(&entries[i], data.data() + entryPos, sizeof(TrpEntry));
+            }
+            Common::SwapBigEndian(std::span{entries});
+            for (const TrpEntry& entry : entries) {
+                if (entry.entry_pos > data.size() ||
+                    entry.entry_len > data.size() - entry.entry_pos) {
+                    LOG_CRITICAL(Common_Filesystem, "TRP entry is out of the trophy file");
+                    failed = true;
+                    return;
                 }
+                file_jobs[index].push_back({index, entry});
             }
-        }
-        index++;
+        },
+        max_threads);
+
+    std::vector<TrpJob> jobs;
+    for (const auto& list : file_jobs) {
+        jobs.insert(jobs.end(), list.begin(), list.end());
     }
-    return true;
+
+    // Entries are independent, icons are copied and ESFM decrypted across all files at once.
+    Common::ParallelFor(
+        jobs.size(),
+        [&](size_t i) {
+            const TrpJob& job = jobs[i];
+            const TrpFile& trp = files[job.file];
+            const TrpEntry& entry = job.entry;
+            const std::span<const u8> data =
+                trp.file.Span().subspan(entry.entry_pos, entry.entry_len);
+            std::string_view name(entry.entry_name,
+                                  strnlen(entry.entry_name, sizeof(entry.entry_name)));
+
+            if (entry.flag == 0 && name.find("TROP") != std::string::npos) { // PNG
+                Common::FS::IOFile::WriteBytes(trp.output / "Icons" / name, data);
+            }
+            if (entry.flag == 3 && trp.np_comm_id[0] == 'N' &&
+                trp.np_comm_id[1] == 'P') { // ESFM, encrypted.
+                if (data.size() < iv_len) {
+                    return;
+                }
+                // The first 16 bytes are the iv key of every entry, skip them as we want a
+                // clean xml file.
+                std::array<u8, 16> esfmIv;
+                std::copy_n(data.begin(), iv_len, esfmIv.begin());
+                std::vector<u8> ESFM(data.begin() + iv_len, data.end());
+                std::vector<u8> XML(ESFM.size());
+                std::array<u8, 16> key = user_key;
+                std::array<u8, 16> np_comm_id = trp.np_comm_id;
+                crypto.decryptEFSM(key, np_comm_id, esfmIv, ESFM, XML); // decrypt
+                removePadding(XML);
+                std::string xml_name(name);
+                size_t pos = xml_name.find("ESFM");
+                if (pos != std::string::npos)
+                    xml_name.replace(pos, xml_name.length(), "XML");
+                std::filesystem::path path = trp.output / "Xml" / xml_name;
+                size_t written = Common::FS::IOFile::WriteBytes(path, XML);
+                if (written != XML.size()) {
+                    LOG_CRITICAL(Common_Filesystem,
+                                 "Trophy XML {} write failed, wanted to write {} bytes, wrote {}",
+                                 fmt::UTF(path.u8string()), XML.size(), written);
+                    failed = true;
+                }
+            }
+        },
+        max_threads);
+    return !failed;
 }
@@ -3,44 +3,62 @@
 
 #pragma once
 
+#include <array>
+#include <filesystem>
+#include <span>
+#include <string>
 #include <vector>
 #include "common/endian.h"
 #include "common/io_file.h"
 #include "common/types.h"
 #include "core/crypto/crypto.h"
 
+// Both are stored big-endian and decoded with Common::DecodeBigEndian.
 struct TrpHeader {
-    u32_be magic; // (0xDCA24D00)
-    u32_be version;
-    u64_be file_size;         // size of full trp file
-    u32_be entry_num;         // num entries
-    u32_be entry_size;        // size of entry
-    u32_be dev_flag;          // 1: dev
+    u32 magic; // (0xDCA24D00)
+    u32 version;
+    u64 file_size;            // size of full trp file
+    u32 entry_num;            // num entries
+    u32 entry_size;           // size of entry
+    u32 dev_flag;             // 1: dev
     unsigned char digest[20]; // sha1 hash
-    u32_be key_index;         // 3031300?
+    u32 key_index;            // 3031300?
     unsigned char padding[44];
 };
 
 struct TrpEntry {
     char entry_name[32];
-    u64_be entry_pos;
-    u64_be entry_len;
-    u32_be flag; // 3 = CONFIG/ESFM , 0 = PNG
+    u64 entry_pos;
+    u64 entry_len;
+    u32 flag; // 3 = CONFIG/ESFM , 0 = PNG
     unsigned char padding[12];
 };
 
+template <>
+struct Common::BigEndianLayoutOf<TrpHeader>
+    : Common::BigEndianLayout<u32, u32, u64, u32, u32, u32, Common::RawBytes<20>, u32,
+                              Common::RawBytes<44>> {};
+
+template <>
+struct Common::BigEndianLayoutOf<TrpEntry>
+    : Common::BigEndianLayout<Common::RawBytes<32>, u64, u64, u32, Common::RawBytes<12>> {};
+
 class TRP {
 public:
     TRP();
     ~TRP();
+    /// Extracts into the emulator metadata folder of `titleId`.
     bool Extract(const std::filesystem::path& trophyPath, const std::string titleId);
-    void GetNPcommID(const std::filesystem::path& trophyPath, int index);
+    /// Decrypts every sce_sys/trophy/*.trp under `trophyPath` into `outputPath`/<trp name>/
+    /// (Icons and Xml). Files and ESFM entries are processed concurrently.
+    bool ExtractTo(const std::filesystem::path& trophyPath, const std::filesystem::path& outputPath,
+                   size_t max_threads = 0);
 
 private:
+    // The NP communication id of the trophy set at `index`, zero padded to 16 bytes. Read from
+    // the npbind.dat contents loaded once by ExtractTo.
+    std::array<u8, 16> GetNPcommID(std::span<const u8> npbind, size_t index) const;
+
     Crypto crypto;
-    std::vector<u8> NPcommID = std::vector<u8>(12);
-    std::array<u8, 16> np_comm_id{};
-    std::array<u8, 16> esfmIv{};
-    std::filesystem::path trpFilesPath;
     static constexpr int iv_len = 16;
-};
\ No newline at end of file
+};
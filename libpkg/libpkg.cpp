@@ -0,0 +1,237 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <exception>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "common/io_file.h"
+#include "common/path_util.h"
+#include "core/file_format/pkg.h"
+#include "core/file_format/pkg_scan.h"
+#include "libpkg/libpkg.h"
+
+struct libpkg_handle {
+    std::shared_mutex mutex; // exclusive while extracting
+    std::filesystem::path pkg_path;
+    PKG pkg;
+    PKGInfo info;
+    std::vector<PKGFileInfo> files;
+    std::vector<std::string> file_paths; // UTF-8 copies handed out through libpkg_file_info
+    std::unordered_map<std::string, u32> by_path;
+
+    std::mutex error_mutex;
+    std::string last_error;
+
+    libpkg_result Fail(libpkg_result result, std::string message) {
+        std::scoped_lock lock{error_mutex};
+        last_error = std::move(message);
+        return result;
+    }
+
+    void Fill(u32 index, libpkg_file_info* out) const {
+        out->path = file_paths[index].c_str();
+        out->size = files[index].size;
+        out->inode = files[index].inode;
+        out->num_blocks = files[index].num_blocks;
+    }
+};
+
+namespace {
+
+thread_local std::string last_open_error;
+
+std::filesystem::path PathFromUTF8(const char* path) {
+    const std::string_view view{path};
+    return std::filesystem::path(std::u8string(view.begin(), view.end()));
+}
+
+// Exceptions must not cross the C boundary.
+template <typename Func>
+libpkg_result Guard(libpkg_handle* handle, Func&& func) {
+    try {
+        return func();
+    } catch (const std::exception& e) {
+        return handle ? handle->Fail(LIBPKG_ERROR_IO, e.what()) : LIBPKG_ERROR_IO;
+    } catch (...) {
+        return handle ? handle->Fail(LIBPKG_ERROR_IO, "Unknown error") : LIBPKG_ERROR_IO;
+    }
+}
+
+} // Anonymous namespace
+
+extern "C" {
+
+uint32_t libpkg_version(void) {
+    return LIBPKG_VERSION;
+}
+
+libpkg_result libpkg_open(const char* pkg_path, libpkg_handle** out) {
+    if (!pkg_path || !out) {
+        return LIBPKG_ERROR_INVALID_ARGUMENT;
+    }
+    *out = nullptr;
+    try {
+        auto handle = std::make_unique<libpkg_handle>();
+        handle->pkg_path = PathFromUTF8(pkg_path);
+
+        std::string failreason;
+        if (!ReadPKGInfo(handle->pkg_path, handle->info, failreason) ||
+            !handle->pkg.ReadFileSystem(handle->pkg_path, failreason)) {
+            last_open_error = failreason;
+            return LIBPKG_ERROR_OPEN;
+        }
+
+        handle->files = handle->pkg.GetFiles();
+        handle->file_paths.reserve(handle->files.size());
+        for (u32 i = 0; i < handle->files.size(); i++) {
+            const auto generic = handle->files[i].path.generic_u8string();
+            handle->file_paths.emplace_back(generic.begin(), generic.end());
+            handle->by_path.emplace(handle->file_paths.back(), i);
+        }
+        *out = handle.release();
+        return LIBPKG_OK;
+    } catch (const std::exception& e) {
+        last_open_error = e.what();
+        return LIBPKG_ERROR_OPEN;
+    }
+}
+
+const char* libpkg_last_open_error(void) {
+    return last_open_error.c_str();
+}
+
+void libpkg_close(libpkg_handle* handle) {
+    delete handle;
+}
+
+const char* libpkg_last_error(libpkg_handle* handle) {
+    if (!handle) {
+        return "";
+    }
+    // Another thread may replace the message at any time, hand out a copy of our own.
+    thread_local std::string error;
+    std::scoped_lock lock{handle->error_mutex};
+    error = handle->last_error;
+    return error.c_str();
+}
+
+const char* libpkg_content_id(libpkg_handle* handle) {
+    return handle ? handle->info.content_id.c_str() : "";
+}
+
+const char* libpkg_title_id(libpkg_handle* handle) {
+    return handle ? handle->info.title_id.c_str() : "";
+}
+
+uint32_t libpkg_content_flags(libpkg_handle* handle) {
+    return handle ? handle->info.content_flags : 0;
+}
+
+uint32_t libpkg_file_count(libpkg_handle* handle) {
+    return handle ? static_cast<uint32_t>(handle->files.size()) : 0;
+}
+
+libpkg_result libpkg_file_at(libpkg_handle* handle, uint32_t index, libpkg_file_info* out) {
+    if (!handle || !out) {
+        return LIBPKG_ERROR_INVALID_ARGUMENT;
+    }
+    if (index >= handle->files.size()) {
+        return handle->Fail(LIBPKG_ERROR_NOT_FOUND, "File index out of range");
+    }
+    handle->Fill(index, out);
+    return LIBPKG_OK;
+}
+
+libpkg_result libpkg_stat(libpkg_handle* handle, const char* path, libpkg_file_info* out) {
+    if (!handle || !path || !out) {
+        return LIBPKG_ERROR_INVALID_ARGUMENT;
+    }
+    const auto it = handle->by_path.find(path);
+    if (it == handle->by_path.end()) {
+        return handle->Fail(LIBPKG_ERROR_NOT_FOUND, std::string("No such file: ") + path);
+    }
+    handle->Fill(it->second, out);
+    return LIBPKG_OK;
+}
+
+libpkg_result libpkg_read(libpkg_handle* handle, const char* path, uint64_t offset, void* buffer,
+                          uint64_t size, uint64_t* bytes_read) {
+    if (!handle || !path || (!buffer && size != 0)) {
+        return LIBPKG_ERROR_INVALID_ARGUMENT;
+    }
+    return Guard(handle, [&] {
+        std::shared_lock lock{handle->mutex};
+        const auto it = handle->by_path.find(path);
+        if (it == handle->by_path.end()) {
+            return handle->Fail(LIBPKG_ERROR_NOT_FOUND, std::string("No such file: ") + path);
+        }
+        const Common::FS::IOFile& file = handle->pkg.GetPkgFile();
+        if (!file.IsOpen()) {
+            return handle->Fail(LIBPKG_ERROR_IO, "Failed to open PKG file");
+        }
+        const u64 read = handle->pkg.ReadFile(handle->files[it->second], offset,
+                                              {static_cast<u8*>(buffer), size}, file);
+        if (bytes_read) {
+            *bytes_read = read;
+        }
+        return LIBPKG_OK;
+    });
+}
+
+libpkg_result libpkg_extract(libpkg_handle* handle, const char* output_dir,
+                             libpkg_progress_cb progress, void* user_data) {
+    if (!handle || !output_dir) {
+        return LIBPKG_ERROR_INVALID_ARGUMENT;
+    }
+    return Guard(handle, [&] {
+        std::unique_lock lock{handle->mutex};
+        std::string failreason;
+        if (!handle->pkg.Extract(handle->pkg_path, PathFromUTF8(output_dir), failreason)) {
+            return handle->Fail(LIBPKG_ERROR_IO, failreason);
+        }
+        handle->pkg.SetProgressCallback([&](u64 done, u64 total) {
+            return !progress || progress(user_data, done, total) == 0;
+        });
+        const bool completed = handle->pkg.ExtractAllFilesWithProgress(failreason);
+        handle->pkg.SetProgressCallback(nullptr);
+        if (!completed) {
+            if (!failreason.empty()) {
+                return handle->Fail(LIBPKG_ERROR_IO, failreason);
+            }
+            return handle->Fail(LIBPKG_ERROR_CANCELLED, "Extraction cancelled");
+        }
+        return LIBPKG_OK;
+    });
+}
+
+libpkg_result libpkg_verify(libpkg_handle* handle, libpkg_progress_cb progress, void* user_data,
+                            uint64_t* bad_blocks) {
+    if (!handle) {
+        return LIBPKG_ERROR_INVALID_ARGUMENT;
+    }
+    return Guard(handle, [&] {
+        std::shared_lock lock{handle->mutex};
+        u64 failures = 0;
+        const bool completed = handle->pkg.VerifyFiles(failures, [&](u64 done, u64 total) {
+            return !progress || progress(user_data, done, total) == 0;
+        });
+
+        if (bad_blocks) {
+            *bad_blocks = failures;
+        }
+        if (!completed) {
+            return handle->Fail(LIBPKG_ERROR_CANCELLED, "Verification cancelled");
+        }
+        if (failures != 0) {
+            return handle->Fail(LIBPKG_ERROR_VERIFY,
+                                std::to_string(failures) + " blocks failed to inflate");
+        }
+        return LIBPKG_OK;
+    });
+}
+
+} // extern "C"
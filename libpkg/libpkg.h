@@ -0,0 +1,97 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+/*
+ * libpkg: C interface to the PKG engine.
+ *
+ * Strings are UTF-8. A handle may be used from several threads at once; libpkg_extract takes
+ * the handle exclusively while it runs. Strings returned by the library stay valid until the
+ * handle is closed, except for the error messages described below.
+ */
+
+#ifndef LIBPKG_H
+#define LIBPKG_H
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(LIBPKG_BUILD)
+#define LIBPKG_API __declspec(dllexport)
+#else
+#define LIBPKG_API __declspec(dllimport)
+#endif
+#else
+#define LIBPKG_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBPKG_VERSION 1
+
+typedef enum libpkg_result {
+    LIBPKG_OK = 0,
+    LIBPKG_ERROR_INVALID_ARGUMENT = -1,
+    LIBPKG_ERROR_OPEN = -2,      /* not a PKG, or keys/file system could not be read */
+    LIBPKG_ERROR_NOT_FOUND = -3, /* no file with that path or index */
+    LIBPKG_ERROR_IO = -4,
+    LIBPKG_ERROR_VERIFY = -5, /* at least one block failed to decrypt/inflate */
+    LIBPKG_ERROR_CANCELLED = -6,
+} libpkg_result;
+
+typedef struct libpkg_handle libpkg_handle;
+
+typedef struct libpkg_file_info {
+    const char* path; /* relative to the image root, '/' separated */
+    uint64_t size;
+    uint32_t inode;
+    uint32_t num_blocks;
+} libpkg_file_info;
+
+/* Called with the number of processed items and the total. Returning non-zero cancels the
+ * operation, which then fails with LIBPKG_ERROR_CANCELLED. */
+typedef int (*libpkg_progress_cb)(void* user_data, uint64_t done, uint64_t total);
+
+/* Returns LIBPKG_VERSION of the library that is actually loaded. */
+LIBPKG_API uint32_t libpkg_version(void);
+
+/* Opens a package, derives its keys and reads the PFS file system. On failure *out is NULL
+ * and libpkg_last_open_error() describes the problem. */
+LIBPKG_API libpkg_result libpkg_open(const char* pkg_path, libpkg_handle** out);
+LIBPKG_API const char* libpkg_last_open_error(void);
+LIBPKG_API void libpkg_close(libpkg_handle* handle);
+
+/* Error message of the last failed call on this handle. The string is a copy owned by the
+ * calling thread, valid until its next libpkg_last_error call. */
+LIBPKG_API const char* libpkg_last_error(libpkg_handle* handle);
+
+LIBPKG_API const char* libpkg_content_id(libpkg_handle* handle);
+LIBPKG_API const char* libpkg_title_id(libpkg_handle* handle);
+LIBPKG_API uint32_t libpkg_content_flags(libpkg_handle* handle);
+
+/* Regular files of the image, in directory walk order. */
+LIBPKG_API uint32_t libpkg_file_count(libpkg_handle* handle);
+LIBPKG_API libpkg_result libpkg_file_at(libpkg_handle* handle, uint32_t index,
+                                        libpkg_file_info* out);
+LIBPKG_API libpkg_result libpkg_stat(libpkg_handle* handle, const char* path,
+                                     libpkg_file_info* out);
+
+/* Reads up to `size` bytes of `path` starting at `offset` without extracting anything. */
+LIBPKG_API libpkg_result libpkg_read(libpkg_handle* handle, const char* path, uint64_t offset,
+                                     void* buffer, uint64_t size, uint64_t* bytes_read);
+
+/* Extracts sce_sys and the whole file system below output_dir. Returns LIBPKG_ERROR_IO when
+ * any file could not be written, LIBPKG_ERROR_CANCELLED when the progress callback stopped it. */
+LIBPKG_API libpkg_result libpkg_extract(libpkg_handle* handle, const char* output_dir,
+                                        libpkg_progress_cb progress, void* user_data);
+
+/* Decrypts and inflates every block of every file, *bad_blocks receives the failures. */
+LIBPKG_API libpkg_result libpkg_verify(libpkg_handle* handle, libpkg_progress_cb progress,
+                                       void* user_data, uint64_t* bad_blocks);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBPKG_H */
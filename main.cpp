@@ -1,18 +1,446 @@
 // SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
 // SPDX-License-Identifier: GPL-2.0-or-later
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <vector>
+#include "bench/bench.h"
+#include "common/config.h"
+#include "common/memory_usage.h"
+#include "core/crypto/crypto_backend.h"
 #include "core/file_format/pkg.h"
+#include "core/file_format/pkg_catalog.h"
+#include "core/file_format/pkg_diff.h"
+#include "core/file_format/pkg_merge.h"
+#include "core/file_format/pkg_scan.h"
+#include "core/file_format/sfo_batch.h"
+#include "core/file_format/trp.h"
+#include "server/pkg_server.h"
 #include "common/logging/backend.h"
+#include "common/logging/binary_log.h"
 #include "common/logging/log.h"
+#include "common/logging/log_entry.h"
+#include "common/logging/text_formatter.h"
 #include "simple_log.h"
 
+// Converte "512M", "2G", "65536" in byte, 0 se il valore non e' valido.
+static u64 ParseSize(std::string_view text) {
+    u64 value = 0;
+    size_t i = 0;
+    for (; i < text.size() && text[i] >= '0' && text[i] <= '9'; i++) {
+        value = value * 10 + (text[i] - '0');
+    }
+    const std::string_view suffix = text.substr(i);
+    if (suffix.empty() || suffix == "B") {
+        return value;
+    } else if (suffix == "K" || suffix == "KB") {
+        return value * 1_KB;
+    } else if (suffix == "M" || suffix == "MB") {
+        return value * 1_MB;
+    } else if (suffix == "G" || suffix == "GB") {
+        return value * 1_GB;
+    }
+    return 0;
+}
+
+// pkgtool info [--format=json|csv] [--output=<file>] <file.pkg|cartella>...
+// Legge solo header, entry table e param.sfo, senza derivare chiavi ne' estrarre nulla.
+static int RunInfo(int argc, char* argv[]) {
+    std::string format = "json";
+    std::filesystem::path output;
+    std::vector<std::filesystem::path> roots;
+    for (int i = 0; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--format=")) {
+            format = arg.substr(9);
+        } else if (arg.starts_with("--output=")) {
+            output = arg.substr(9);
+        } else {
+            roots.emplace_back(arg);
+        }
+    }
+    if (roots.empty() || (format != "json" && format != "csv")) {
+        std::cerr << "Uso: pkgtool info [--format=json|csv] [--output=<file>] <file.pkg|cartella>..."
+                  << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto files = FindPKGFiles(roots);
+    const auto infos = ScanPKGFiles(files);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::ofstream out_file;
+    if (!output.empty()) {
+        out_file.open(output, std::ios::binary);
+        if (!out_file) {
+            std::cerr << "Impossibile scrivere " << output.string() << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output.empty() ? std::cout : out_file;
+    if (format == "csv") {
+        WritePKGInfoCsv(out, infos);
+    } else {
+        WritePKGInfoJson(out, infos);
+    }
+
+    std::cerr << infos.size() << " pacchetti analizzati in " << elapsed.count() << " ms"
+              << std::endl;
+    return 0;
+}
+
+// pkgtool sfo [--keys=<CHIAVE,...>] [--format=csv|json] [--output=<file>] <file.pkg|cartella>...
+// Estrae alcune chiavi di param.sfo da pacchetti e giochi installati, una colonna per chiave.
+static int RunSfo(int argc, char* argv[]) {
+    std::string format = "csv";
+    std::filesystem::path output;
+    std::vector<std::string> keys;
+    std::vector<std::filesystem::path> roots;
+    for (int i = 0; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--keys=")) {
+            std::string_view list = arg.substr(7);
+            while (!list.empty()) {
+                const size_t comma = std::min(list.find(','), list.size());
+                if (comma != 0) {
+                    keys.emplace_back(list.substr(0, comma));
+                }
+                list.remove_prefix(std::min(comma + 1, list.size()));
+            }
+        } else if (arg.starts_with("--format=")) {
+            format = arg.substr(9);
+        } else if (arg.starts_with("--output=")) {
+            output = arg.substr(9);
+        } else {
+            roots.emplace_back(arg);
+        }
+    }
+    if (roots.empty() || (format != "json" && format != "csv")) {
+        std::cerr << "Uso: pkgtool sfo [--keys=<CHIAVE,...>] [--format=csv|json] "
+                     "[--output=<file>] <file.pkg|cartella>..."
+                  << std::endl;
+        return 1;
+    }
+    if (keys.empty()) {
+        for (const auto key : GetDefaultSfoKeys()) {
+            keys.emplace_back(key);
+        }
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto sources = FindSfoSources(roots);
+    const SfoTable table = ReadSfoBatch(sources, keys);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    std::ofstream out_file;
+    if (!output.empty()) {
+        out_file.open(output, std::ios::binary);
+        if (!out_file) {
+            std::cerr << "Impossibile scrivere " << output.string() << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& out = output.empty() ? std::cout : out_file;
+    if (format == "csv") {
+        WriteSfoTableCsv(out, table);
+    } else {
+        WriteSfoTableJson(out, table);
+    }
+
+    std::cerr << table.GetNumRows() << " titoli letti in " << elapsed.count() << " ms"
+              << std::endl;
+    return 0;
+}
+
+// pkgtool catalog <catalog> update [--files] <file.pkg|cartella>...
+// pkgtool catalog <catalog> list | find-file <testo> | sizes
+// Le query lavorano solo sull'indice, senza riaprire i pacchetti.
+static int RunCatalog(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Uso: pkgtool catalog <catalogo> update [--files] <file.pkg|cartella>...\n"
+                     "     pkgtool catalog <catalogo> list|sizes\n"
+                     "     pkgtool catalog <catalogo> find-file <testo>"
+                  << std::endl;
+        return 1;
+    }
+    const std::filesystem::path catalog_path = argv[0];
+    const std::string_view command = argv[1];
+
+    PKGCatalog catalog;
+    std::string failreason;
+    if (!catalog.Load(catalog_path, failreason)) {
+        std::cerr << "Errore nel caricamento del catalogo: " << failreason << std::endl;
+        return 1;
+    }
+
+    if (command == "update") {
+        bool with_files = false;
+        std::vector<std::filesystem::path> roots;
+        for (int i = 2; i < argc; i++) {
+            if (std::string_view(argv[i]) == "--files") {
+                with_files = true;
+            } else {
+                roots.emplace_back(argv[i]);
+            }
+        }
+        if (roots.empty()) {
+            std::cerr << "Nessuna cartella o file PKG indicato" << std::endl;
+            return 1;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const auto stats = catalog.Update(roots, with_files);
+        if (!catalog.Save(catalog_path, failreason)) {
+            std::cerr << "Errore nel salvataggio del catalogo: " << failreason << std::endl;
+            return 1;
+        }
+        const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start);
+        std::cerr << stats.unchanged << " invariati, " << stats.scanned << " analizzati ("
+                  << stats.failed << " con errori), " << stats.removed << " rimossi in "
+                  << elapsed.count() << " ms" << std::endl;
+        return 0;
+    }
+
+    const auto packages = catalog.GetPackages();
+    if (command == "list") {
+        for (const auto& package : packages) {
+            std::cout << package.info.title_id << '\t' << package.info.content_id << '\t'
+                      << package.info.GetSfoValue("APP_VER") << '\t' << package.info.file_size
+                      << '\t' << package.info.path.string() << '\n';
+        }
+    } else if (command == "find-file" && argc >= 3) {
+        for (const auto& [pkg_index, file_index] : catalog.FindFiles(argv[2])) {
+            const auto& package = packages[pkg_index];
+            std::cout << package.info.title_id << '\t' << package.files[file_index].path << '\t'
+                      << package.files[file_index].size << '\t' << package.info.path.string()
+                      << '\n';
+        }
+    } else if (command == "sizes") {
+        for (const auto& [content_type, totals] : catalog.GetSizesByContentType()) {
+            std::cout << "0x" << std::hex << content_type << std::dec << '\t' << totals.first
+                      << '\t' << totals.second << '\n';
+        }
+    } else {
+        std::cerr << "Comando catalogo sconosciuto: " << command << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// pkgtool diff <vecchio.pkg> <nuovo.pkg>
+// Confronta i due file system blocco per blocco senza estrarre nulla.
+static int RunDiff(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Uso: pkgtool diff <vecchio.pkg> <nuovo.pkg>" << std::endl;
+        return 1;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    PKGDiffResult result;
+    std::string failreason;
+    if (!DiffPKGs(argv[0], argv[1], result, failreason)) {
+        std::cerr << "Errore nel confronto: " << failreason << std::endl;
+        return 1;
+    }
+    WritePKGDiff(std::cout, result);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cerr << "Confronto completato in " << elapsed.count() << " ms" << std::endl;
+    // Come diff(1): 0 se identici, 1 se ci sono differenze.
+    return result.files.empty() ? 0 : 1;
+}
+
+// pkgtool merge <cartella_output> <base.pkg> [<update.pkg>...] [--dlc=<dlc.pkg>]...
+// Estrae in un solo passaggio l'insieme finale dei file: per ogni percorso vince l'ultimo
+// pacchetto che lo contiene. I DLC finiscono in addcont/<etichetta>.
+static int RunMerge(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "Uso: pkgtool merge <cartella_output> <base.pkg> [<update.pkg>...] "
+                     "[--dlc=<dlc.pkg>]..."
+                  << std::endl;
+        return 1;
+    }
+    const std::filesystem::path output = argv[0];
+    std::vector<PKGMergeSource> sources;
+    std::string failreason;
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (!arg.starts_with("--dlc=")) {
+            sources.push_back({arg, {}});
+            continue;
+        }
+        const std::filesystem::path dlc_path = arg.substr(6);
+        PKGInfo info;
+        if (!ReadPKGInfo(dlc_path, info, failreason) || info.content_id.size() < 36) {
+            std::cerr << "DLC non valido " << dlc_path.string() << ": " << failreason << std::endl;
+            return 1;
+        }
+        // L'etichetta dell'entitlement sono gli ultimi 16 caratteri del content id.
+        const auto label = info.content_id.substr(20);
+        sources.push_back({dlc_path, std::filesystem::path("addcont") / label});
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    PKGMergedView view;
+    if (!view.Open(sources, failreason)) {
+        std::cerr << "Errore nell'apertura dei pacchetti: " << failreason << std::endl;
+        return 1;
+    }
+    u64 total_bytes = 0;
+    std::vector<size_t> per_source(view.GetSourceCount());
+    for (const auto& file : view.GetFiles()) {
+        total_bytes += file.file.size;
+        per_source[file.source]++;
+    }
+    for (size_t i = 0; i < sources.size(); i++) {
+        std::cout << sources[i].pkg_path.string() << ": " << per_source[i] << " file" << std::endl;
+    }
+    std::cout << view.GetFiles().size() << " file (" << total_bytes / 1_MB << " MiB), "
+              << view.GetOverriddenCount() << " sostituiti da pacchetti successivi" << std::endl;
+
+    const bool ok = view.Extract(output, failreason, [](u64 done, u64 total) {
+        std::cout << "\r" << done << "/" << total << " estratti" << std::flush;
+        return true;
+    });
+    std::cout << std::endl;
+    if (!ok) {
+        std::cerr << "Errore nell'estrazione: " << failreason << std::endl;
+        return 1;
+    }
+    const auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cout << "Estrazione unita completata in " << elapsed.count() << " ms" << std::endl;
+    return 0;
+}
+
+// pkgtool serve <socket> [--workers=<n>] [--cache=<n>]
+// Resta in ascolto su un socket locale ed esegue job JSON (uno per riga), vedi server/pkg_server.h.
+static int RunServe(int argc, char* argv[]) {
+    if (argc < 1) {
+        std::cerr << "Uso: pkgtool serve <socket> [--workers=<n>] [--cache=<n>]" << std::endl;
+        return 1;
+    }
+    PKGServerOptions options;
+    options.socket_path = argv[0];
+    for (int i = 1; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--workers=")) {
+            options.workers = std::max(1, std::atoi(argv[i] + 10));
+        } else if (arg.starts_with("--cache=")) {
+            options.cache_size = std::max(1, std::atoi(argv[i] + 8));
+        }
+    }
+
+    PKGServer server(options);
+    std::string failreason;
+    std::cerr << "In ascolto su " << options.socket_path.string() << std::endl;
+    if (!server.Run(failreason)) {
+        std::cerr << "Errore del server: " << failreason << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// pkgtool bench crypto [--size=<MiB>] [--backend=<nome>]
+// pkgtool bench log [--messages=<n>] [--max-threads=<n>]
+// pkgtool bench write [--files=<n>] [--size=<byte>] [--max-threads=<n>] [--dir=<cartella>]
+// pkgtool bench io [--size=<MiB>] [--dir=<cartella>]
+static int RunBench(int argc, char* argv[]) {
+    if (argc >= 1 && std::string_view(argv[0]) == "crypto") {
+        return RunCryptoBench(argc - 1, argv + 1);
+    }
+    if (argc >= 1 && std::string_view(argv[0]) == "log") {
+        return RunLogBench(argc - 1, argv + 1);
+    }
+    if (argc >= 1 && std::string_view(argv[0]) == "write") {
+        return RunWriteBench(argc - 1, argv + 1);
+    }
+    if (argc >= 1 && std::string_view(argv[0]) == "io") {
+        return RunIoBench(argc - 1, argv + 1);
+    }
+    std::cerr << "Uso: pkgtool bench crypto [--size=<MiB>] [--backend=<nome>]" << std::endl;
+    std::cerr << "     pkgtool bench log [--messages=<n>] [--max-threads=<n>]" << std::endl;
+    std::cerr << "     pkgtool bench write [--files=<n>] [--size=<byte>] [--max-threads=<n>] "
+                 "[--dir=<cartella>]"
+              << std::endl;
+    std::cerr << "     pkgtool bench io [--size=<MiB>] [--dir=<cartella>]" << std::endl;
+    return 1;
+}
+
+// pkgtool log decode <file.bin>
+// Converte in testo un log scritto con --log-type=binary.
+static int RunLog(int argc, char* argv[]) {
+    if (argc < 2 || std::string_view(argv[0]) != "decode") {
+        std::cerr << "Uso: pkgtool log decode <file.bin>" << std::endl;
+        return 1;
+    }
+    std::string failreason;
+    const bool ok = Common::Log::DecodeBinaryLog(
+        argv[1],
+        [](const Common::Log::Entry& entry) {
+            std::cout << Common::Log::FormatLogMessage(entry) << '\n';
+        },
+        failreason);
+    std::cout.flush();
+    if (!ok) {
+        std::cerr << "Errore nella lettura del log: " << failreason << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
+    if (argc >= 2 && std::string_view(argv[1]) == "info") {
+        return RunInfo(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string_view(argv[1]) == "sfo") {
+        return RunSfo(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string_view(argv[1]) == "catalog") {
+        return RunCatalog(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string_view(argv[1]) == "diff") {
+        return RunDiff(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string_view(argv[1]) == "merge") {
+        return RunMerge(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string_view(argv[1]) == "serve") {
+        return RunServe(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string_view(argv[1]) == "bench") {
+        return RunBench(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && std::string_view(argv[1]) == "log") {
+        return RunLog(argc - 2, argv + 2);
+    }
+
+    // --log-type=sync|async|binary, --log-overflow=block|drop e --log-filter=<regole> vanno
+    // letti prima di inizializzare il logger.
+    for (int i = 3; i < argc; i++) {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--log-type=")) {
+            Config::setLogType(std::string(arg.substr(11)));
+        } else if (arg.starts_with("--log-overflow=")) {
+            Config::setLogOverflow(std::string(arg.substr(15)));
+        } else if (arg.starts_with("--log-filter=")) {
+            Config::setLogFilter(std::string(arg.substr(13)));
+        }
+    }
+
     // Inizializza il logger globale (stampa su console e file)
     Common::Log::Initialize("estrazione_pkg.log");
     Common::Log::SetColorConsoleBackendEnabled(true);
+    Common::Log::Start();
     simple_log("[START] Avvio estrattore PKG");
 
     LOG_INFO(Common, "Test log: il logger funziona!");
@@ -26,7 +454,40 @@ https://github.com/seregonwar
 )";
 
         if (argc < 3) {
-            LOG_ERROR(Lib_Kernel, "Uso: {} <file.pkg> <cartella_output>", argv[0]);
+            LOG_ERROR(Lib_Kernel,
+                      "Uso: {} <file.pkg> <cartella_output> [--playgo] [--languages=<id,...>] "
+                      "[--max-memory=<n>[K|M|G]] [--io=buffered|direct] "
+                      "[--manifest=<file> [--hash=sha256|xxh3] "
+                      "[--hash-tree]] [--crypto=cryptopp|openssl] [--trophy-key=<hex>] "
+                      "[--log-type=sync|async|binary] [--log-overflow=block|drop] "
+                      "[--log-filter=<regole>]",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} info [--format=json|csv] <file.pkg|cartella>...",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel,
+                      "     {} sfo [--keys=<CHIAVE,...>] [--format=csv|json] "
+                      "[--output=<file>] <file.pkg|cartella>...",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} catalog <catalogo> update|list|find-file|sizes ...",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} diff <vecchio.pkg> <nuovo.pkg>", argv[0]);
+            LOG_ERROR(Lib_Kernel,
+                      "     {} merge <cartella_output> <base.pkg> [<update.pkg>...] "
+                      "[--dlc=<dlc.pkg>]...",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} serve <socket> [--workers=<n>] [--cache=<n>]",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} bench crypto [--size=<MiB>] [--backend=<nome>]",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} bench log [--messages=<n>] [--max-threads=<n>]",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel,
+                      "     {} bench write [--files=<n>] [--size=<byte>] [--max-threads=<n>] "
+                      "[--dir=<cartella>]",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} bench io [--size=<MiB>] [--dir=<cartella>]",
+                      argv[0]);
+            LOG_ERROR(Lib_Kernel, "     {} log decode <file.bin>", argv[0]);
             return 1;
         }
 
@@ -34,7 +495,80 @@ https://github.com/seregonwar
         std::filesystem::path out_dir = argv[2];
         std::string failreason;
 
+        // --playgo: estrae prima i chunk iniziali dello scenario di default.
+        // --languages=<id,id,...>: salta i chunk di lingue non elencate (id lingua di sistema).
+        // --max-memory=<n>[K|M|G]: limite per buffer dei blocchi e cache PFS.
+        // --io=direct: legge il PKG senza page cache e la libera dai file estratti.
+        bool use_playgo = false;
+        u64 language_mask = 0;
+        // --manifest=<file> [--hash=sha256|xxh3] [--hash-tree]: hash dei file durante l'estrazione.
+        // --crypto=<backend>: implementazione di AES/SHA/RSA (default openssl se compilato).
+        // --trophy-key=<32 cifre hex>: decifra anche i trofei in <cartella_output>/TrophyFiles.
+        u64 max_memory = 0;
+        std::filesystem::path manifest_path;
+        HashAlgorithm hash_algorithm = HashAlgorithm::SHA256;
+        bool hash_tree = false;
+        bool extract_trophies = false;
+        bool direct_io = false;
+        for (int i = 3; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            if (arg.starts_with("--manifest=")) {
+                manifest_path = arg.substr(11);
+            } else if (arg.starts_with("--hash=")) {
+                const auto algorithm = ParseHashAlgorithm(arg.substr(7));
+                if (!algorithm || !IsHashAlgorithmAvailable(*algorithm)) {
+                    std::cerr << "Algoritmo di hash non disponibile: " << arg.substr(7)
+                              << std::endl;
+                    return 1;
+                }
+                hash_algorithm = *algorithm;
+            } else if (arg == "--hash-tree") {
+                hash_tree = true;
+            } else if (arg.starts_with("--trophy-key=")) {
+                Config::setTrophyKey(std::string(arg.substr(13)));
+                extract_trophies = true;
+            } else if (arg.starts_with("--crypto=")) {
+                if (!SetCryptoBackend(arg.substr(9))) {
+                    std::cerr << "Backend crittografico non disponibile: " << arg.substr(9)
+                              << std::endl;
+                    return 1;
+                }
+            } else if (arg.starts_with("--max-memory=")) {
+                max_memory = ParseSize(arg.substr(13));
+                if (max_memory == 0) {
+                    std::cerr << "Valore non valido per --max-memory: " << arg.substr(13)
+                              << std::endl;
+                    return 1;
+                }
+            } else if (arg.starts_with("--io=")) {
+                if (arg.substr(5) != "direct" && arg.substr(5) != "buffered") {
+                    std::cerr << "Valore non valido per --io: " << arg.substr(5) << std::endl;
+                    return 1;
+                }
+                direct_io = arg.substr(5) == "direct";
+            } else if (arg == "--playgo") {
+                use_playgo = true;
+            } else if (arg.starts_with("--languages=")) {
+                use_playgo = true;
+                std::string_view list = arg.substr(12);
+                while (!list.empty()) {
+                    const auto comma = list.find(',');
+                    const int lang = std::atoi(std::string(list.substr(0, comma)).c_str());
+                    if (lang >= 0 && lang < 64) {
+                        language_mask |= 1ULL << (63 - lang);
+                    }
+                    list = comma == std::string_view::npos ? std::string_view{}
+                                                           : list.substr(comma + 1);
+                }
+            }
+        }
+
         PKG pkg;
+        pkg.SetMemoryBudget(max_memory);
+        pkg.SetDirectIO(direct_io);
+        if (!manifest_path.empty()) {
+            pkg.EnableHashManifest(hash_algorithm, hash_tree);
+        }
         if (!pkg.Open(pkg_path, failreason)) {
             std::cerr << "Errore nell'apertura del file PKG: " << failreason << std::endl;
             return 1;
@@ -83,36 +617,59 @@ https://github.com/seregonwar
             std::cout << "  " << std::get<0>(entries[i]) << " | tipo: " << std::get<2>(entries[i]) << " | inode: " << std::get<1>(entries[i]) << std::endl;
         }
 
+        // I trofei stanno in sce_sys, gia' scritto da Extract: vengono decifrati in parallelo
+        // all'estrazione dei file.
+        std::future<bool> trophies;
+        if (extract_trophies) {
+            trophies = std::async(std::launch::async, [&out_dir] {
+                return TRP{}.ExtractTo(out_dir, out_dir / "TrophyFiles");
+            });
+        }
+
         // Estrai tutti i file reali dal PKG
-        pkg.ExtractAllFilesWithProgress();
+        bool extracted = false;
+        PlayGoExtractPlan plan;
+        if (use_playgo && pkg.PlanPlayGoExtraction(language_mask, plan, failreason)) {
+            std::cout << "PlayGo: " << plan.initial_files << " file iniziali, "
+                      << plan.skipped_files << " file saltati (" << plan.skipped_bytes
+                      << " byte)" << std::endl;
+            extracted = pkg.ExtractFilesWithProgress(plan.order, failreason);
+        } else {
+            if (use_playgo) {
+                std::cerr << "PlayGo non disponibile (" << failreason
+                          << "), estrazione completa" << std::endl;
+            }
+            extracted = pkg.ExtractAllFilesWithProgress(failreason);
+        }
+        if (trophies.valid()) {
+            if (trophies.get()) {
+                std::cout << "Trofei estratti in " << (out_dir / "TrophyFiles").string()
+                          << std::endl;
+            } else {
+                std::cerr << "Estrazione dei trofei non riuscita (chiave o file non validi)"
+                          << std::endl;
+            }
+        }
+        if (!extracted) {
+            // Un failreason vuoto indica un annullamento, altrimenti alcuni file non sono
+            // stati scritti.
+            if (failreason.empty()) {
+                std::cerr << "Estrazione annullata" << std::endl;
+            } else {
+                std::cerr << "Estrazione incompleta: " << failreason << std::endl;
+            }
+            return 1;
+        }
+        if (!manifest_path.empty()) {
+            if (!pkg.WriteHashManifest(manifest_path, failreason)) {
+                std::cerr << "Errore nella scrittura del manifest: " << failreason << std::endl;
+                return 1;
+            }
+            std::cout << "Manifest scritto in " << manifest_path.string() << std::endl;
+        }
         std::cout << "Estrazione e decifratura completate con successo!\n";
-
-        // Fix: dichiarazione di esempio per decompressedData (sostituisci con i dati reali se disponibili)
-        std::vector<uint8_t> decompressedData(32, 0); // oppure i dati reali
-        // Dopo la decompressione di ogni blocco
-        char hexbuf[65];
-        for (int k = 0; k < 32; ++k) sprintf(hexbuf + k*2, "%02x", (unsigned char)decompressedData[k]);
-        simple_log(std::string("[PKG] Primo blocco decompress: ") + hexbuf);
-
-        // Fix: dichiarazione di esempio per ent_size (sostituisci con il valore reale se disponibile)
-        size_t ent_size = 0;
-        // All'inizio del ciclo Dirent
-        simple_log("[PKG] ent_size iniziale: " + std::to_string(ent_size));
-
-        // Fix: dichiarazione di esempio per dirent (sostituisci con la tua struttura reale se disponibile)
-        struct Dirent {
-            uint32_t ino;
-            size_t entsize;
-            uint8_t type;
-            char name[256];
-            size_t namelen;
-        };
-        Dirent dirent = {0, 0, 0, "nomefile", 8}; // esempio
-        // Dentro il ciclo Dirent, per ogni entry, anche se dirent.ino == 0
-        simple_log("[PKG] Dirent: ino=" + std::to_string(dirent.ino) +
-                   " entsize=" + std::to_string(dirent.entsize) +
-                   " type=" + std::to_string(dirent.type) +
-                   " name=" + std::string(dirent.name, dirent.namelen));
+        std::cout << "Picco memoria: pool " << pkg.GetPoolPeakUsage() / 1_MB << " MiB, RSS "
+                  << Common::GetPeakResidentSetSize() / 1_MB << " MiB" << std::endl;
 
         return 0;
     } catch (const std::exception& e) {
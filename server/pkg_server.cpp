@@ -0,0 +1,843 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <list>
+#include <shared_mutex>
+#include <sstream>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <afunix.h>
+#else
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include "common/io_file.h"
+#include "common/logging/log.h"
+#include "common/path_util.h"
+#include "common/string_util.h"
+#include "core/file_format/pkg.h"
+#include "core/file_format/pkg_scan.h"
+#include "server/pkg_server.h"
+
+namespace {
+
+#ifdef _WIN32
+using SocketHandle = SOCKET;
+constexpr SocketHandle InvalidSocket = INVALID_SOCKET;
+constexpr int ShutdownBoth = SD_BOTH;
+void CloseSocket(SocketHandle socket) {
+    closesocket(socket);
+}
+#else
+using SocketHandle = int;
+constexpr SocketHandle InvalidSocket = -1;
+constexpr int ShutdownBoth = SHUT_RDWR;
+void CloseSocket(SocketHandle socket) {
+    close(socket);
+}
+#endif
+
+#ifdef MSG_NOSIGNAL
+constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+constexpr int SendFlags = 0;
+#endif
+
+constexpr size_t MaxRequestSize = 1_MB;
+constexpr u64 MaxInlineReadSize = 16_MB; // larger reads have to go to an output file
+constexpr auto ProgressInterval = std::chrono::milliseconds(100);
+
+struct JsonValue {
+    std::string text; // unescaped for strings, the literal token otherwise
+    bool is_string = false;
+};
+using JsonObject = std::unordered_map<std::string, JsonValue>;
+
+void AppendUTF8(std::string& out, u32 cp) {
+    if (cp < 0x80) {
+        out += static_cast<char>(cp);
+    } else if (cp < 0x800) {
+        out += static_cast<char>(0xC0 | (cp >> 6));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out += static_cast<char>(0xE0 | (cp >> 12));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    } else {
+        out += static_cast<char>(0xF0 | (cp >> 18));
+        out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (cp & 0x3F));
+    }
+}
+
+bool ParseHex4(std::string_view text, size_t pos, u32& value) {
+    if (pos + 4 > text.size()) {
+        return false;
+    }
+    const auto result = std::from_chars(text.data() + pos, text.data() + pos + 4, value, 16);
+    return result.ec == std::errc{} && result.ptr == text.data() + pos + 4;
+}
+
+bool ParseJsonString(std::string_view text, size_t& pos, std::string& out) {
+    if (pos >= text.size() || text[pos] != '"') {
+        return false;
+    }
+    pos++;
+    out.clear();
+    while (pos < text.size()) {
+        const char c = text[pos++];
+        if (c == '"') {
+            return true;
+        }
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (pos >= text.size()) {
+            return false;
+        }
+        switch (const char e = text[pos++]) {
+        case '"':
+        case '\\':
+        case '/':
+            out += e;
+            break;
+        case 'b':
+            out += '\b';
+            break;
+        case 'f':
+            out += '\f';
+            break;
+        case 'n':
+            out += '\n';
+            break;
+        case 'r':
+            out += '\r';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'u': {
+            u32 cp;
+            if (!ParseHex4(text, pos, cp)) {
+                return false;
+            }
+            pos += 4;
+            // Characters outside the BMP come as a surrogate pair.
+            if (cp >= 0xD800 && cp < 0xDC00 && text.substr(pos, 2) == "\\u") {
+                u32 low;
+                if (ParseHex4(text, pos + 2, low) && low >= 0xDC00 && low < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    pos += 6;
+                }
+            }
+            AppendUTF8(out, cp);
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+// Requests are flat objects, nested values are rejected.
+bool ParseJsonObject(std::string_view text, JsonObject& out) {
+    size_t pos = 0;
+    const auto skip_spaces = [&] {
+        while (pos < text.size() &&
+               (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) {
+            pos++;
+        }
+    };
+
+    skip_spaces();
+    if (pos >= text.size() || text[pos++] != '{') {
+        return false;
+    }
+    skip_spaces();
+    if (pos < text.size() && text[pos] == '}') {
+        pos++;
+        skip_spaces();
+        return pos == text.size();
+    }
+    while (true) {
+        std::string key;
+        skip_spaces();
+        if (!ParseJsonString(text, pos, key)) {
+            return false;
+        }
+        skip_spaces();
+        if (pos >= text.size() || text[pos++] != ':') {
+            return false;
+        }
+        skip_spaces();
+        JsonValue value;
+        if (pos < text.size() && text[pos] == '"') {
+            value.is_string = true;
+            if (!ParseJsonString(text, pos, value.text)) {
+                return false;
+            }
+        } else {
+            const size_t start = pos;
+            while (pos < text.size() && text[pos] != ',' && text[pos] != '}' && text[pos] != ' ' &&
+                   text[pos] != '\t') {
+                pos++;
+            }
+            value.text = text.substr(start, pos - start);
+            if (value.text.empty() || value.text[0] == '{' || value.text[0] == '[') {
+                return false;
+            }
+        }
+        out[std::move(key)] = std::move(value);
+        skip_spaces();
+        if (pos >= text.size()) {
+            return false;
+        }
+        const char c = text[pos++];
+        if (c == '}') {
+            break;
+        }
+        if (c != ',') {
+            return false;
+        }
+    }
+    skip_spaces();
+    return pos == text.size();
+}
+
+std::string ToBase64(std::span<const u8> data) {
+    static constexpr char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    out.reserve((data.size() + 2) / 3 * 4);
+    size_t i = 0;
+    for (; i + 2 < data.size(); i += 3) {
+        const u32 v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        out += alphabet[(v >> 18) & 0x3F];
+        out += alphabet[(v >> 12) & 0x3F];
+        out += alphabet[(v >> 6) & 0x3F];
+        out += alphabet[v & 0x3F];
+    }
+    if (i < data.size()) {
+        const bool two = i + 1 < data.size();
+        const u32 v = (data[i] << 16) | (two ? data[i + 1] << 8 : 0);
+        out += alphabet[(v >> 18) & 0x3F];
+        out += alphabet[(v >> 12) & 0x3F];
+        out += two ? alphabet[(v >> 6) & 0x3F] : '=';
+        out += '=';
+    }
+    return out;
+}
+
+// Paths inside the image are always reported with '/' separators.
+std::string GenericUTF8(const std::filesystem::path& path) {
+    const auto generic = path.generic_u8string();
+    return std::string(generic.begin(), generic.end());
+}
+
+std::string JsonString(std::string_view text) {
+    return "\"" + Common::EscapeJsonString(text) + "\"";
+}
+
+} // Anonymous namespace
+
+struct PKGServer::Client {
+    SocketHandle socket;
+    std::mutex send_mutex;
+    bool closed = false;
+
+    explicit Client(SocketHandle socket_) : socket{socket_} {}
+
+    void Send(std::string line) {
+        line += '\n';
+        std::scoped_lock lock{send_mutex};
+        size_t sent = 0;
+        while (!closed && sent < line.size()) {
+            const auto n = send(socket, line.data() + sent, static_cast<int>(line.size() - sent),
+                                SendFlags);
+            if (n <= 0) {
+                // The reader thread notices the broken connection and cleans up.
+                return;
+            }
+            sent += static_cast<size_t>(n);
+        }
+    }
+
+    // Unblocks the reader thread, used when the server stops.
+    void Shutdown() {
+        std::scoped_lock lock{send_mutex};
+        if (!closed) {
+            shutdown(socket, ShutdownBoth);
+        }
+    }
+
+    void Close() {
+        std::scoped_lock lock{send_mutex};
+        if (!closed) {
+            closed = true;
+            CloseSocket(socket);
+        }
+    }
+};
+
+struct PKGServer::Job {
+    std::shared_ptr<Client> client;
+    std::string id; // JSON text of the client's id, echoed in every event
+    std::string op;
+    JsonObject request;
+    int priority = 0;
+    u64 sequence = 0;
+    std::atomic<bool> cancelled{false};
+    std::chrono::steady_clock::time_point last_progress{};
+
+    void Send(std::string_view event, std::string_view fields = {}) {
+        std::string line = "{\"id\":" + id + ",\"event\":\"" + std::string(event) + "\"";
+        if (!fields.empty()) {
+            line += ',';
+            line += fields;
+        }
+        line += '}';
+        client->Send(std::move(line));
+    }
+
+    // Rate limited so a job over many small files does not flood the client.
+    bool Progress(u64 done, u64 total) {
+        const auto now = std::chrono::steady_clock::now();
+        if (done == total || now - last_progress >= ProgressInterval) {
+            last_progress = now;
+            Send("progress",
+                 "\"done\":" + std::to_string(done) + ",\"total\":" + std::to_string(total));
+        }
+        return !cancelled;
+    }
+
+    std::string GetString(const std::string& key) const {
+        const auto it = request.find(key);
+        return it != request.end() && it->second.is_string ? it->second.text : std::string{};
+    }
+
+    u64 GetNumber(const std::string& key, u64 fallback) const {
+        const auto it = request.find(key);
+        if (it == request.end() || it->second.is_string) {
+            return fallback;
+        }
+        u64 value = fallback;
+        const auto& text = it->second.text;
+        std::from_chars(text.data(), text.data() + text.size(), value);
+        return value;
+    }
+};
+
+struct PKGServer::OpenPackage {
+    std::shared_mutex mutex; // exclusive while extracting
+    std::filesystem::path path;
+    u64 file_size = 0;
+    std::filesystem::file_time_type mtime;
+
+    PKG pkg;
+    PKGInfo info;
+    std::vector<PKGFileInfo> files;
+    std::unordered_map<std::string, u32> by_path; // UTF-8 path relative to the image root
+};
+
+class PKGServer::PackageCache {
+public:
+    explicit PackageCache(size_t capacity_) : capacity{std::max<size_t>(1, capacity_)} {}
+
+    /// Returns the cached package if it is still the same file on disk.
+    std::shared_ptr<OpenPackage> Find(const std::filesystem::path& path) {
+        u64 size;
+        std::filesystem::file_time_type mtime;
+        if (!Stat(path, size, mtime)) {
+            return nullptr;
+        }
+        std::scoped_lock lock{mutex};
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            if ((*it)->path != path) {
+                continue;
+            }
+            if ((*it)->file_size != size || (*it)->mtime != mtime) {
+                entries.erase(it);
+                return nullptr;
+            }
+            entries.splice(entries.begin(), entries, it);
+            return entries.front();
+        }
+        return nullptr;
+    }
+
+    /// Returns the cached package or opens it, deriving its keys and parsing its file system.
+    std::shared_ptr<OpenPackage> Get(const std::filesystem::path& path, std::string& failreason) {
+        if (auto package = Find(path)) {
+            return package;
+        }
+
+        // Opened without holding the lock, jobs on other packages keep going meanwhile.
+        auto package = std::make_shared<OpenPackage>();
+        package->path = path;
+        if (!Stat(path, package->file_size, package->mtime)) {
+            failreason = "Failed to open PKG file";
+            return nullptr;
+        }
+        if (!ReadPKGInfo(path, package->info, failreason) ||
+            !package->pkg.ReadFileSystem(path, failreason)) {
+            return nullptr;
+        }
+        package->files = package->pkg.GetFiles();
+        for (u32 i = 0; i < package->files.size(); i++) {
+            package->by_path.emplace(GenericUTF8(package->files[i].path), i);
+        }
+        LOG_DEBUG(Loader, "serve: opened {}, {} files", Common::FS::PathToUTF8String(path),
+                  package->files.size());
+
+        std::scoped_lock lock{mutex};
+        for (const auto& entry : entries) {
+            if (entry->path == path && entry->file_size == package->file_size &&
+                entry->mtime == package->mtime) {
+                return entry; // opened concurrently by another job
+            }
+        }
+        entries.push_front(package);
+        // Evicted packages stay alive until the jobs still using them are done.
+        while (entries.size() > capacity) {
+            entries.pop_back();
+        }
+        return package;
+    }
+
+private:
+    static bool Stat(const std::filesystem::path& path, u64& size,
+                     std::filesystem::file_time_type& mtime) {
+        std::error_code ec;
+        size = std::filesystem::file_size(path, ec);
+        if (ec) {
+            return false;
+        }
+        mtime = std::filesystem::last_write_time(path, ec);
+        return !ec;
+    }
+
+    const size_t capacity;
+    std::mutex mutex;
+    std::list<std::shared_ptr<OpenPackage>> entries; // most recently used first
+};
+
+bool PKGServer::JobOrder::operator()(const std::shared_ptr<Job>& a,
+                                     const std::shared_ptr<Job>& b) const {
+    // priority_queue pops the largest element: highest priority, then oldest.
+    if (a->priority != b->priority) {
+        return a->priority < b->priority;
+    }
+    return a->sequence > b->sequence;
+}
+
+PKGServer::PKGServer(PKGServerOptions options_)
+    : options{std::move(options_)}, cache{std::make_unique<PackageCache>(options.cache_size)},
+      listen_socket{static_cast<intptr_t>(InvalidSocket)} {}
+
+PKGServer::~PKGServer() {
+    Stop();
+}
+
+bool PKGServer::Run(std::string& failreason) {
+#ifdef _WIN32
+    WSADATA wsa_data;
+    if (WSAStartup(MAKEWORD(2, 2), &wsa_data) != 0) {
+        failreason = "WSAStartup failed";
+        return false;
+    }
+#else
+    // A client going away mid-write must not kill the server.
+    std::signal(SIGPIPE, SIG_IGN);
+#endif
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    const std::string socket_path = Common::FS::PathToUTF8String(options.socket_path);
+    if (socket_path.empty() || socket_path.size() >= sizeof(addr.sun_path)) {
+        failreason = "Invalid socket path";
+        return false;
+    }
+    std::memcpy(addr.sun_path, socket_path.data(), socket_path.size());
+
+    const SocketHandle server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server == InvalidSocket) {
+        failreason = "Failed to create socket";
+        return false;
+    }
+    // A socket file left behind by a previous run would make bind fail.
+    std::error_code ec;
+    std::filesystem::remove(options.socket_path, ec);
+    if (bind(server, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+        listen(server, 16) != 0) {
+        CloseSocket(server);
+        failreason = "Failed to listen on " + socket_path;
+        return false;
+    }
+    listen_socket = static_cast<intptr_t>(server);
+    stopping = false;
+
+    for (size_t i = 0; i < std::max<size_t>(1, options.workers); i++) {
+        workers.emplace_back([this] { WorkerLoop(); });
+    }
+    LOG_INFO(Core, "serve: listening on {}", socket_path);
+
+    while (!stopping) {
+        const SocketHandle connection = accept(server, nullptr, nullptr);
+        if (connection == InvalidSocket) {
+            if (stopping) {
+                break;
+            }
+            continue;
+        }
+        auto client = std::make_shared<Client>(connection);
+        {
+            std::scoped_lock lock{clients_mutex};
+            clients.push_back(client);
+        }
+        std::thread(&PKGServer::ServeClient, this, std::move(client)).detach();
+    }
+
+    Stop();
+    workers.clear(); // joins, running jobs were cancelled by Stop
+    {
+        std::unique_lock lock{clients_mutex};
+        for (const auto& client : clients) {
+            client->Shutdown();
+        }
+        clients_cv.wait(lock, [&] { return clients.empty(); });
+    }
+    std::filesystem::remove(options.socket_path, ec);
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return true;
+}
+
+void PKGServer::Stop() {
+    if (stopping.exchange(true)) {
+        return;
+    }
+    const auto server =
+        static_cast<SocketHandle>(listen_socket.exchange(static_cast<intptr_t>(InvalidSocket)));
+    if (server != InvalidSocket) {
+        shutdown(server, ShutdownBoth);
+        CloseSocket(server);
+    }
+    {
+        std::scoped_lock lock{queue_mutex};
+        for (const auto& weak : active_jobs) {
+            if (const auto job = weak.lock()) {
+                job->cancelled = true;
+            }
+        }
+    }
+    queue_cv.notify_all();
+}
+
+void PKGServer::ServeClient(std::shared_ptr<Client> client) {
+    std::string pending;
+    char buffer[4096];
+    while (true) {
+        const auto n = recv(client->socket, buffer, sizeof(buffer), 0);
+        if (n <= 0) {
+            break;
+        }
+        pending.append(buffer, static_cast<size_t>(n));
+        size_t start = 0;
+        for (size_t end; (end = pending.find('\n', start)) != std::string::npos; start = end + 1) {
+            std::string_view line(pending.data() + start, end - start);
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+            if (!line.empty()) {
+                HandleRequest(client, line);
+            }
+        }
+        pending.erase(0, start);
+        if (pending.size() > MaxRequestSize) {
+            client->Send(R"({"id":null,"event":"error","message":"Request too large"})");
+            break;
+        }
+    }
+
+    // Nobody is left to receive the results of this client's jobs.
+    {
+        std::scoped_lock lock{queue_mutex};
+        for (const auto& weak : active_jobs) {
+            if (const auto job = weak.lock(); job && job->client == client) {
+                job->cancelled = true;
+            }
+        }
+    }
+    client->Close();
+    {
+        std::scoped_lock lock{clients_mutex};
+        std::erase(clients, client);
+    }
+    clients_cv.notify_all();
+}
+
+void PKGServer::HandleRequest(const std::shared_ptr<Client>& client, std::string_view line) {
+    auto job = std::make_shared<Job>();
+    job->client = client;
+    job->id = "null";
+    if (!ParseJsonObject(line, job->request)) {
+        job->Send("error", R"("message":"Malformed request")");
+        return;
+    }
+    if (const auto it = job->request.find("id"); it != job->request.end()) {
+        job->id = it->second.is_string ? JsonString(it->second.text) : it->second.text;
+    }
+    job->op = job->GetString("op");
+
+    if (job->op == "shutdown") {
+        job->Send("done");
+        Stop();
+        return;
+    }
+    if (job->op == "cancel") {
+        bool found = false;
+        {
+            std::scoped_lock lock{queue_mutex};
+            for (const auto& weak : active_jobs) {
+                if (const auto other = weak.lock();
+                    other && other->client == client && other->id == job->id) {
+                    other->cancelled = true;
+                    found = true;
+                }
+            }
+        }
+        if (!found) {
+            job->Send("error", R"("message":"No such job")");
+        }
+        return;
+    }
+    if (job->op != "info" && job->op != "list" && job->op != "extract" && job->op != "verify" &&
+        job->op != "read") {
+        job->Send("error", "\"message\":" + JsonString("Unknown op: " + job->op));
+        return;
+    }
+    if (job->GetString("path").empty()) {
+        job->Send("error", R"("message":"Missing path")");
+        return;
+    }
+    if (const auto it = job->request.find("priority"); it != job->request.end()) {
+        std::from_chars(it->second.text.data(), it->second.text.data() + it->second.text.size(),
+                        job->priority);
+    }
+
+    {
+        std::scoped_lock lock{queue_mutex};
+        std::erase_if(active_jobs, [](const auto& weak) { return weak.expired(); });
+        active_jobs.push_back(job);
+    }
+    // Acknowledged before a worker can pick it up, so "queued" always comes first.
+    job->Send("queued");
+    {
+        std::scoped_lock lock{queue_mutex};
+        job->sequence = next_sequence++;
+        queue.push(job);
+    }
+    queue_cv.notify_one();
+}
+
+void PKGServer::WorkerLoop() {
+    while (true) {
+        std::shared_ptr<Job> job;
+        {
+            std::unique_lock lock{queue_mutex};
+            queue_cv.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (stopping) {
+                return;
+            }
+            job = queue.top();
+            queue.pop();
+        }
+        RunJob(*job);
+    }
+}
+
+void PKGServer::RunJob(Job& job) {
+    if (job.cancelled) {
+        job.Send("cancelled");
+        return;
+    }
+    job.Send("started");
+    try {
+        if (job.op == "info") {
+            RunInfo(job);
+        } else if (job.op == "list") {
+            RunList(job);
+        } else if (job.op == "extract") {
+            RunExtract(job);
+        } else if (job.op == "verify") {
+            RunVerify(job);
+        } else if (job.op == "read") {
+            RunRead(job);
+        }
+    } catch (const std::exception& e) {
+        job.Send("error", "\"message\":" + JsonString(e.what()));
+    }
+}
+
+void PKGServer::RunInfo(Job& job) {
+    const std::filesystem::path path = job.GetString("path");
+    // Cheap enough to read again when the package is not open yet, no keys are needed.
+    PKGInfo info;
+    if (const auto package = cache->Find(path)) {
+        info = package->info;
+    } else {
+        std::string failreason;
+        ReadPKGInfo(path, info, failreason);
+    }
+    std::ostringstream out;
+    out << "\"info\":";
+    WritePKGInfoJsonObject(out, info);
+    job.Send("done", out.str());
+}
+
+void PKGServer::RunList(Job& job) {
+    std::string failreason;
+    const auto package = cache->Get(job.GetString("path"), failreason);
+    if (!package) {
+        job.Send("error", "\"message\":" + JsonString(failreason));
+        return;
+    }
+    std::string fields = "\"files\":[";
+    for (size_t i = 0; i < package->files.size(); i++) {
+        const PKGFileInfo& file = package->files[i];
+        fields += (i ? ",{\"path\":" : "{\"path\":") +
+                  JsonString(GenericUTF8(file.path)) +
+                  ",\"size\":" + std::to_string(file.size) + "}";
+    }
+    fields += ']';
+    job.Send("done", fields);
+}
+
+void PKGServer::RunExtract(Job& job) {
+    const std::filesystem::path output = job.GetString("output");
+    if (output.empty()) {
+        job.Send("error", R"("message":"Missing output")");
+        return;
+    }
+    std::string failreason;
+    const auto package = cache->Get(job.GetString("path"), failreason);
+    if (!package) {
+        job.Send("error", "\"message\":" + JsonString(failreason));
+        return;
+    }
+
+    // Extract retargets the parsed image at the output folder, nothing else may use it meanwhile.
+    std::unique_lock lock{package->mutex};
+    if (!package->pkg.Extract(package->path, output, failreason)) {
+        job.Send("error", "\"message\":" + JsonString(failreason));
+        return;
+    }
+    package->pkg.SetProgressCallback(
+        [&](u64 done, u64 total) { return job.Progress(done, total); });
+    const bool completed = package->pkg.ExtractAllFilesWithProgress(failreason);
+    package->pkg.SetProgressCallback(nullptr);
+    if (!completed) {
+        if (failreason.empty()) {
+            job.Send("cancelled");
+        } else {
+            job.Send("error", "\"message\":" + JsonString(failreason));
+        }
+        return;
+    }
+    job.Send("done", "\"output\":" + JsonString(Common::FS::PathToUTF8String(output)));
+}
+
+void PKGServer::RunVerify(Job& job) {
+    std::string failreason;
+    const auto package = cache->Get(job.GetString("path"), failreason);
+    if (!package) {
+        job.Send("error", "\"message\":" + JsonString(failreason));
+        return;
+    }
+    std::shared_lock lock{package->mutex};
+    u64 bad_blocks = 0;
+    const bool completed = package->pkg.VerifyFiles(
+        bad_blocks, [&](u64 done, u64 total) { return job.Progress(done, total); });
+    if (!completed) {
+        job.Send("cancelled");
+        return;
+    }
+    job.Send("done", "\"ok\":" + std::string(bad_blocks == 0 ? "true" : "false") +
+                         ",\"bad_blocks\":" + std::to_string(bad_blocks));
+}
+
+void PKGServer::RunRead(Job& job) {
+    std::string failreason;
+    const auto package = cache->Get(job.GetString("path"), failreason);
+    if (!package) {
+        job.Send("error", "\"message\":" + JsonString(failreason));
+        return;
+    }
+    const std::string name = job.GetString("file");
+    const auto it = package->by_path.find(name);
+    if (it == package->by_path.end()) {
+        job.Send("error", "\"message\":" + JsonString("No such file: " + name));
+        return;
+    }
+    const PKGFileInfo& file = package->files[it->second];
+    const u64 offset = std::min(job.GetNumber("offset", 0), file.size);
+    const u64 size = std::min(job.GetNumber("size", file.size), file.size - offset);
+    const std::filesystem::path output = job.GetString("output");
+    if (output.empty() && size > MaxInlineReadSize) {
+        job.Send("error", R"("message":"Read too large, use output")");
+        return;
+    }
+
+    std::shared_lock lock{package->mutex};
+    const Common::FS::IOFile& pkg_file = package->pkg.GetPkgFile();
+    if (!pkg_file.IsOpen()) {
+        job.Send("error", R"("message":"Failed to open PKG file")");
+        return;
+    }
+    if (output.empty()) {
+        std::vector<u8> data(size);
+        const u64 read = package->pkg.ReadFile(file, offset, data, pkg_file);
+        job.Send("done", "\"size\":" + std::to_string(read) + ",\"data\":\"" +
+                             ToBase64({data.data(), read}) + "\"");
+        return;
+    }
+
+    // Streamed in chunks so large files never sit in memory as a whole.
+    Common::FS::IOFile out(output, Common::FS::FileAccessMode::Write);
+    if (!out.IsOpen()) {
+        job.Send("error", "\"message\":" +
+                              JsonString("Failed to open " + Common::FS::PathToUTF8String(output)));
+        return;
+    }
+    std::vector<u8> chunk(std::min<u64>(size, 4_MB));
+    u64 done = 0;
+    while (done < size) {
+        if (!job.Progress(done, size)) {
+            job.Send("cancelled");
+            return;
+        }
+        const u64 count = std::min<u64>(chunk.size(), size - done);
+        const u64 read =
+            package->pkg.ReadFile(file, offset + done, {chunk.data(), count}, pkg_file);
+        if (read == 0 || out.WriteRaw<u8>(chunk.data(), read) != read) {
+            job.Send("error", R"("message":"Read failed")");
+            return;
+        }
+        done += read;
+    }
+    job.Progress(done, size);
+    job.Send("done", "\"size\":" + std::to_string(done) + ",\"output\":" +
+                         JsonString(Common::FS::PathToUTF8String(output)));
+}
@@ -0,0 +1,89 @@
+// SPDX-FileCopyrightText: Copyright 2024 shadPS4 Emulator Project
+// SPDX-License-Identifier: GPL-2.0-or-later
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "common/types.h"
+
+struct PKGServerOptions {
+    std::filesystem::path socket_path;
+    size_t workers = 2;    // jobs running at the same time
+    size_t cache_size = 8; // packages kept open between jobs
+};
+
+/**
+ * Long-running job server listening on a local (UNIX domain) socket.
+ *
+ * Clients send one JSON object per line and get JSON-lines events back:
+ *
+ *   {"id":1,"op":"info","path":"game.pkg"}
+ *   {"id":2,"op":"extract","path":"game.pkg","output":"out","priority":10}
+ *   {"id":3,"op":"verify","path":"game.pkg"}
+ *   {"id":4,"op":"read","path":"game.pkg","file":"sce_sys/param.sfo","offset":0,"size":4096}
+ *   {"id":2,"op":"cancel"}
+ *
+ * Every job answers with "queued", zero or more "progress" events and then "done", "error" or
+ * "cancelled", all tagged with the id given by the client. Opened packages, with their derived
+ * keys and parsed file system, are kept in an LRU cache so later jobs on the same file skip
+ * straight to the work. Jobs are run by a fixed set of workers, highest priority first.
+ */
+class PKGServer {
+public:
+    explicit PKGServer(PKGServerOptions options);
+    ~PKGServer();
+
+    PKGServer(const PKGServer&) = delete;
+    PKGServer& operator=(const PKGServer&) = delete;
+
+    /// Accepts clients until Stop is called or a client sends {"op":"shutdown"}.
+    bool Run(std::string& failreason);
+    void Stop();
+
+private:
+    struct Client;
+    struct Job;
+    struct OpenPackage;
+    class PackageCache;
+
+    struct JobOrder {
+        bool operator()(const std::shared_ptr<Job>& a, const std::shared_ptr<Job>& b) const;
+    };
+
+    void ServeClient(std::shared_ptr<Client> client);
+    void HandleRequest(const std::shared_ptr<Client>& client, std::string_view line);
+    void WorkerLoop();
+    void RunJob(Job& job);
+
+    void RunInfo(Job& job);
+    void RunList(Job& job);
+    void RunExtract(Job& job);
+    void RunVerify(Job& job);
+    void RunRead(Job& job);
+
+    const PKGServerOptions options;
+    std::unique_ptr<PackageCache> cache;
+
+    std::atomic<bool> stopping{false};
+    std::atomic<intptr_t> listen_socket;
+
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::priority_queue<std::shared_ptr<Job>, std::vector<std::shared_ptr<Job>>, JobOrder> queue;
+    std::vector<std::weak_ptr<Job>> active_jobs; // queued or running, used by cancel
+    u64 next_sequence = 0;
+
+    std::mutex clients_mutex;
+    std::condition_variable clients_cv; // signalled when a client thread exits
+    std::vector<std::shared_ptr<Client>> clients;
+    std::vector<std::jthread> workers;
+};